@@ -29,6 +29,8 @@ SOFTWARE. */
 #define AXI_DMA
 
 #include <stdint.h>
+#include "uio_irq.h"
+#include "dma_buf.h"
 
 // AXI DMA register map offsets (Direct Register Mode)
 #define AXI_DMA_MM2S_CR             0x00
@@ -43,6 +45,9 @@ SOFTWARE. */
 #define AXI_DMA_S2MM_DST_ADDR_MSB   0x4C
 #define AXI_DMA_S2MM_LENGTH         0x58
 
+// Largest word aligned transfer of the 14 bit length register
+#define AXI_DMA_MAX_LENGTH          0x3ffc
+
 // CR register bits
 #define AXI_DMA_CR_RS               0x00 // Run Stop. Default = 0
 #define AXI_DMA_CR_RESET            0x02 // Reset. Default = 0
@@ -72,15 +77,22 @@ typedef struct {
     uint32_t p_baseaddr;    // Physical base address
     uint32_t size;          // Size of device
 
-    // src and dst buffers
+    // src and dst buffers (v_/p_ mirror src_buf and dst_buf)
+    dma_buf_t src_buf;
+    dma_buf_t dst_buf;
     void *v_src_addr;
     void *v_dst_addr;
     uint32_t p_src_addr;
     uint32_t p_dst_addr;
+
+    // completion interrupts (polling unless set up with axi_dma_irq_init)
+    uio_irq_t mm2s_irq;
+    uio_irq_t s2mm_irq;
 } axi_dma_t;
 
-int32_t axi_dma_init(axi_dma_t *device, uint32_t baseaddr, uint32_t src_addr, uint32_t dst_addr, uint32_t size);
+int32_t axi_dma_init(axi_dma_t *device, uint32_t baseaddr, uint32_t src_addr, uint32_t dst_addr, uint32_t size, uint32_t src_size, uint8_t buf_backend);
 void axi_dma_release(axi_dma_t *device);
+int32_t axi_dma_irq_init(axi_dma_t *device, const char *mm2s_uio, const char *s2mm_uio, uint8_t mode);
 
 void dma_mm2s_reset(axi_dma_t *device);
 void dma_s2mm_reset(axi_dma_t *device);
@@ -130,6 +142,7 @@ void dma_s2mm_set_dst_addr_msb(axi_dma_t *device, uint32_t addr);
 void dma_s2mm_set_length(axi_dma_t *device, uint32_t length);
 
 void axi_dma_mm2s_transfer(axi_dma_t *device, uint32_t size);
+void axi_dma_mm2s_stream(axi_dma_t *device, uint32_t size);
 void axi_dma_s2mm_transfer(axi_dma_t *device, uint32_t size);
 void axi_dma_haru_query_transfer(axi_dma_t *device, uint32_t src_len, uint32_t dst_len);
 
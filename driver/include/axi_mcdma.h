@@ -10,6 +10,8 @@ This header file defines the register addresses and values to control the MCDMA.
 #include <stdint.h>
 #include <stdlib.h>
 #include "misc.h"
+#include "uio_irq.h"
+#include "dma_buf.h"
 
 /*
     AXI MCDMA Configuration
@@ -18,13 +20,26 @@ This header file defines the register addresses and values to control the MCDMA.
 typedef struct axi_mcdma axi_mcdma_t;
 typedef struct axi_mcdma_channel axi_mcdma_channel_t;
 typedef struct axi_mcdma_bd axi_mcdma_bd_t;
+typedef struct axi_mcdma_bd_ring axi_mcdma_bd_ring_t;
 
-int32_t axi_mcdma_init(axi_mcdma_t *device, uint32_t baseaddr, uint32_t src_addr, uint32_t dst_addr, uint32_t mm2s_bd_addr, uint32_t s2mm_bd_addr, uint32_t size);
+int32_t axi_mcdma_init(axi_mcdma_t *device, uint32_t baseaddr, uint32_t src_addr, uint32_t dst_addr, uint32_t mm2s_bd_addr, uint32_t s2mm_bd_addr, uint32_t size, uint32_t bd_size, uint32_t src_size, uint8_t buf_backend);
 int axi_mcdma_haru_query_transfer(axi_mcdma_t *device, int channel_idx, uint32_t src_len, uint32_t dst_len);
-
-void axi_mcdma_channel_init(axi_mcdma_t *device, int channel_idx, uint32_t src_addr_offset, uint32_t dst_addr_offset, int buf_size);
-void axi_mcdma_mm2s_bd_init(axi_mcdma_t *device, int channel_idx, uint32_t transfer_size, uint32_t bd_addr_offset);
-void axi_mcdma_s2mm_bd_init(axi_mcdma_t *device, int channel_idx, uint32_t transfer_size, uint32_t bd_addr_offset);
+int axi_mcdma_haru_chain_transfer(axi_mcdma_t *device, int channel_idx);
+int axi_mcdma_haru_chain_transfer_channels(axi_mcdma_t *device, uint32_t channel_mask);
+
+void axi_mcdma_channel_init(axi_mcdma_t *device, int channel_idx, uint32_t src_addr_offset, uint32_t dst_addr_offset, uint32_t src_buf_size, uint32_t dst_buf_size);
+void axi_mcdma_bd_rings_init(axi_mcdma_t *device, int channel_idx);
+int axi_mcdma_bd_ring_space(axi_mcdma_bd_ring_t *ring);
+int axi_mcdma_mm2s_bd_enqueue(axi_mcdma_t *device, int channel_idx, uint32_t buf_offset, uint32_t transfer_size, int sof, int eof);
+int axi_mcdma_mm2s_packet_enqueue(axi_mcdma_t *device, int channel_idx, uint32_t buf_offset, uint32_t transfer_size);
+int axi_mcdma_s2mm_bd_enqueue(axi_mcdma_t *device, int channel_idx, uint32_t buf_offset, uint32_t transfer_size);
+void axi_mcdma_s2mm_bd_cancel(axi_mcdma_t *device, int channel_idx);
+int axi_mcdma_mm2s_bd_reclaim(axi_mcdma_t *device, int channel_idx);
+int axi_mcdma_s2mm_bd_reclaim(axi_mcdma_t *device, int channel_idx);
+int axi_mcdma_s2mm_bd_reclaim_max(axi_mcdma_t *device, int channel_idx, int max);
+void axi_mcdma_start(axi_mcdma_t *device);
+void axi_mcdma_recover(axi_mcdma_t *device);
+int32_t axi_mcdma_channel_irq_init(axi_mcdma_t *device, int channel_idx, const char *mm2s_uio, const char *s2mm_uio, uint8_t mode);
 int axi_mcdma_mm2s_transfer(axi_mcdma_t *device);
 int axi_mcdma_s2mm_transfer(axi_mcdma_t *device);
 void axi_mcdma_release(axi_mcdma_t *device);
@@ -52,7 +67,8 @@ void s2mm_bd_status(axi_mcdma_channel_t *channel);
 /*
     AXI MCDMA Device Config
 */
-#define NUM_CHANNELS 1
+#define NUM_CHANNELS 16 // channels supported by the engine; only those set up with axi_mcdma_channel_init are enabled
+#define AXI_MCDMA_BD_RING_SIZE 128 // buffer descriptors per channel and direction
 
 /* mcdma device */
 struct axi_mcdma {
@@ -60,8 +76,11 @@ struct axi_mcdma {
     uint32_t p_baseaddr;
     uint32_t *v_baseaddr;
     int size; // size of device space in bytes
+    int bd_size; // size of each of the mm2s and s2mm bd spaces in bytes
 
-    // buffer addresses
+    // buffer addresses (p_/v_ mirror src_buf and dst_buf)
+    dma_buf_t src_buf;
+    dma_buf_t dst_buf;
     uint32_t p_buffer_src_addr;
     uint32_t *v_buffer_src_addr;
     uint32_t p_buffer_dst_addr;
@@ -79,6 +98,27 @@ struct axi_mcdma {
 
 };
 
+/* mcdma buffer descriptor */
+struct axi_mcdma_bd {
+    uint32_t p_bd_addr;
+    uint32_t *v_bd_addr;
+
+    uint32_t next_bd_addr; // only counts bits 31:6
+    uint32_t buffer_addr;
+    uint32_t buffer_length; // only counts bits 0:25
+    int sof;
+    int eof;
+    uint8_t tid;
+    uint8_t tdest;
+};
+
+/* mcdma buffer descriptor ring, laid out once per channel */
+struct axi_mcdma_bd_ring {
+    axi_mcdma_bd_t bds[AXI_MCDMA_BD_RING_SIZE];
+    uint32_t prod; // free running count of queued descriptors
+    uint32_t cons; // free running count of reclaimed descriptors
+};
+
 /* mcdma channel */
 struct axi_mcdma_channel {
     int channel_id;
@@ -86,37 +126,30 @@ struct axi_mcdma_channel {
     uint32_t *v_buf_src_addr;
     uint32_t p_buf_dst_addr;
     uint32_t *v_buf_dst_addr;
-    uint32_t buf_size;
+    uint32_t src_buf_size;
+    uint32_t dst_buf_size;
     uint32_t mm2s_curr_bd_addr; // only counts bits 31:6
     uint32_t mm2s_tail_bd_addr; // only counts bits 31:6
     uint32_t s2mm_curr_bd_addr; // only counts bits 31:6
     uint32_t s2mm_tail_bd_addr; // only counts bits 31:6
 
-    // buffer descriptor chain 
-    axi_mcdma_bd_t *mm2s_bd_chain;
-    axi_mcdma_bd_t *s2mm_bd_chain;
-};
-
-/* mcdma buffer descriptor */
-struct axi_mcdma_bd {
-    uint32_t p_bd_addr;
-    uint32_t *v_bd_addr;
-    axi_mcdma_bd_t *next_mcdma_bd;
+    // buffer descriptor rings
+    axi_mcdma_bd_ring_t mm2s_ring;
+    axi_mcdma_bd_ring_t s2mm_ring;
 
-    uint32_t next_bd_addr; // only counts bits 31:6
-    uint32_t buffer_addr;
-    uint32_t buffer_length; // only counts bits 0:25
-    int sof;
-    int eof;
-    uint8_t tid;
-    uint8_t tdest;
+    // completion interrupts (polling unless set up with axi_mcdma_channel_irq_init)
+    uio_irq_t mm2s_irq;
+    uio_irq_t s2mm_irq;
 };
 
 /*
     AXI MCDMA Buffer Address Space
 */
 #define AXI_MCDMA_BD_OFFSET                         0x1000
+#define AXI_MCDMA_BD_SIZE                           0x040   // Descriptors are 64 byte aligned
+#define AXI_MCDMA_BD_RING_BYTES                     (AXI_MCDMA_BD_RING_SIZE * AXI_MCDMA_BD_SIZE)
 #define AXI_MCDMA_CH_OFFSET                         0x040
+#define AXI_MCDMA_BD_MAX_LENGTH                     0x3ffc  // Largest word aligned length of the 14 bit buffer length field
 
 #define AXI_MCDMA_BUF_INIT_ERROR     0x01
 
@@ -213,6 +246,11 @@ struct axi_mcdma_bd {
 #define AXI_MCDMA_S2MM_SG_SLV_ERR                   0x20    // Scatter gather Slave Error
 #define AXI_MCDMA_S2MM_SG_DEC_ERR                   0x40    // Scatter gather Decode Error
 
+// Channel control register interrupt enables
+#define AXI_MCDMA_CH_IOC_IRQ_EN                     0x20
+#define AXI_MCDMA_CH_DLY_IRQ_EN                     0x40
+#define AXI_MCDMA_CH_ERR_IRQ_EN                     0x80
+
 // Channel status register values
 #define AXI_MCDMA_CH_IDLE                           0x01 // Channel idle (queue empty)
 #define AXI_MCDMA_CH_ERR_OTH_CH                     0x08 // Channel error on other channel
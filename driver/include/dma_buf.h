@@ -0,0 +1,67 @@
+/* MIT License
+
+Copyright (c) 2022 Po Jui Shih
+Copyright (c) 2022 Hassaan Saadat
+Copyright (c) 2022 Sri Parameswaran
+Copyright (c) 2022 Hasindu Gamaarachchi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#ifndef DMA_BUF_H
+#define DMA_BUF_H
+
+#include <stdint.h>
+
+/*
+ * Data buffers shared with the DMA engines. The /dev/mem backend maps them
+ * O_SYNC, i.e. uncached, so every CPU access goes to DDR one word at a time.
+ * The u-dma-buf backend maps a contiguous kernel buffer cacheable and the
+ * driver keeps it coherent by cleaning the caches before the device reads
+ * (dma_buf_sync_for_device) and invalidating them before the CPU reads what
+ * the device wrote (dma_buf_sync_for_cpu). Control registers and buffer
+ * descriptors always stay uncached.
+ */
+
+// Backends
+#define DMA_BUF_DEVMEM          0   // /dev/mem O_SYNC at a fixed physical address, uncached
+#define DMA_BUF_UDMABUF         1   // /dev/udmabufN (u-dma-buf module), cacheable
+#define DMA_BUF_ANON            2   // anonymous memory, cacheable; no device can reach it (testing)
+#define DMA_BUF_AUTO            3   // u-dma-buf when the device exists, /dev/mem otherwise
+
+#define DMA_BUF_UDMABUF_SYSFS   "/sys/class/u-dma-buf"
+
+// u-dma-buf devices backing the source (mm2s) and destination (s2mm) buffers
+#define DMA_BUF_UDMABUF_SRC     "udmabuf0"
+#define DMA_BUF_UDMABUF_DST     "udmabuf1"
+
+typedef struct {
+    void *v_addr;           // mapped virtual address
+    uint32_t p_addr;        // physical (bus) address given to the DMA engine
+    uint32_t size;          // size of the mapping in bytes
+    uint8_t backend;        // DMA_BUF_* (never DMA_BUF_AUTO once initialised)
+    uint8_t cached;         // cache maintenance is needed around transfers
+} dma_buf_t;
+
+int32_t dma_buf_init(dma_buf_t *buf, uint8_t backend, const char *udmabuf_name, uint32_t p_addr, uint32_t size);
+void dma_buf_release(dma_buf_t *buf);
+
+void dma_buf_sync_for_device(dma_buf_t *buf, uint32_t offset, uint32_t len);
+void dma_buf_sync_for_cpu(dma_buf_t *buf, uint32_t offset, uint32_t len);
+
+#endif // DMA_BUF_H
@@ -41,6 +41,14 @@ SOFTWARE. */
 #define DTW_ACCEL_DBG_CORE_ADDR             9 << 2
 #define DTW_ACCEL_DBG_NQUERY                10 << 2
 #define DTW_ACCEL_DBG_CURR_QID              11 << 2
+#define DTW_ACCEL_NUM_ACCEL_ADDR            12 << 2
+#define DTW_ACCEL_BAND_ADDR                 13 << 2
+#define DTW_ACCEL_HITS_ADDR                 14 << 2
+#define DTW_ACCEL_STRAND_ADDR               15 << 2
+#define DTW_ACCEL_QLEN_ADDR                 16 << 2
+#define DTW_ACCEL_THRESH_ADDR               17 << 2
+#define DTW_ACCEL_REF_SIZE_ADDR             18 << 2
+#define DTW_ACCEL_COHORT_ADDR               19 << 2
 
 // Control register bit offsets
 #define DTW_ACCEL_CR_OFFSET_RESET           0x00
@@ -64,6 +72,40 @@ SOFTWARE. */
 // Key value
 #define DTW_ACCEL_KEY                       0x0ca7cafe
 
+// Band register: Sakoe-Chiba half width in warp steps, 0 for unconstrained
+#define DTW_ACCEL_BAND_MAX                  0xff
+
+// Hits register: hits per result packet, 1 to HITS_MAX (8 in dtw_accel.v)
+#define DTW_ACCEL_HITS_MAX                  8
+
+// Query length register: samples per query, 1 to SQG_SIZE (250 in dtw_accel.v)
+#define DTW_ACCEL_QLEN_MAX                  250
+
+// Early accept register: a core stops at the first score below it, 0 for off
+#define DTW_ACCEL_THRESH_MAX                0xffff
+
+// Reference size register: words of the reference memory, 2^REFMEM_PTR_WIDTH. Designs
+// with more than two cores replicate the memory per pair of cores, and may trade depth
+// for the replicas; cohort designs share one. Earlier designs have 2^18 words.
+#define DTW_ACCEL_REF_SIZE_DEFAULT          (1 << 18)
+
+// Cohort register: cycles the first full query of a cohort waits for the other
+// cores' queries, at least 1. Reads 0 on designs whose cores run independently.
+// The reset value gives every core the time to receive a full length query.
+#define DTW_ACCEL_COHORT_CYCLES(num_accel)  ((num_accel) * (DTW_ACCEL_QLEN_MAX + 2))
+
+// Result positions with a second strand loaded (REG_STRAND): bit 31 marks a hit on
+// the second strand, whose position then counts from the strand's first word
+#define DTW_ACCEL_POSITION_STRAND(pos)      (((pos) >> 31) & 1)
+#define DTW_ACCEL_POSITION(pos)             ((pos) & 0x7fffffff)
+
+// Score of a query without a hit, the saturated 16 bit PE value
+#define DTW_ACCEL_MAX_SCORE                 0xffff
+
+// Version register fields
+#define DTW_ACCEL_VERSION_MAJOR(version)    (((version) >> 28) & 0xf)
+#define DTW_ACCEL_VERSION_MINOR(version)    (((version) >> 20) & 0xff)
+
 // DEBUG
 #define DTW_ACCEL_DBG_REF_ADDR_WREN         31
 #define DTW_ACCEL_DBG_REF_ADDR_W_MSB        29
@@ -86,6 +128,29 @@ typedef struct {
     uint32_t size;          // Size of device
 } dtw_accel_t;
 
+// Result packet of a DTW core, one word each
+typedef struct {
+    uint32_t qid;
+    uint32_t position;
+    uint32_t score;
+} search_result_t;
+
+// Hit of a top-K result packet
+typedef struct {
+    uint32_t position;
+    uint32_t score;
+} search_hit_t;
+
+// Top-K result packet: qid, then the n best non-overlapping hits by score, one
+// word each. The core only sends the first DTW_ACCEL_HITS_WORDS(n) words, and
+// for n = 1 the packet is a search_result_t.
+typedef struct {
+    uint32_t qid;
+    search_hit_t hits[DTW_ACCEL_HITS_MAX];
+} search_hits_t;
+
+#define DTW_ACCEL_HITS_WORDS(n)             (1 + 2 * (n))
+
 int32_t dtw_accel_init(dtw_accel_t *device, uint32_t baseaddr, uint32_t size);
 void dtw_accel_release(dtw_accel_t *device);
 
@@ -94,12 +159,26 @@ void dtw_accel_run(dtw_accel_t *device);
 void dtw_accel_stop(dtw_accel_t *device);
 void dtw_accel_set_mode(dtw_accel_t *device, uint8_t mode);
 void dtw_accel_set_ref_len(dtw_accel_t *device, uint32_t len);
+int32_t dtw_accel_set_band(dtw_accel_t *device, uint32_t band);
+int32_t dtw_accel_set_hits(dtw_accel_t *device, uint32_t hits);
+int32_t dtw_accel_set_strand(dtw_accel_t *device, uint32_t strand);
+int32_t dtw_accel_set_qlen(dtw_accel_t *device, uint32_t qlen);
+int32_t dtw_accel_set_thresh(dtw_accel_t *device, uint32_t thresh);
+int32_t dtw_accel_set_cohort(dtw_accel_t *device, uint32_t cycles);
 
 uint32_t dtw_accel_get_cr(dtw_accel_t *device);
 uint32_t dtw_accel_get_sr(dtw_accel_t *device);
 uint32_t dtw_accel_get_ref_len(dtw_accel_t *device);
 uint32_t dtw_accel_get_version(dtw_accel_t *device);
 uint32_t dtw_accel_get_key(dtw_accel_t *device);
+uint32_t dtw_accel_get_num_accel(dtw_accel_t *device);
+uint32_t dtw_accel_get_band(dtw_accel_t *device);
+uint32_t dtw_accel_get_hits(dtw_accel_t *device);
+uint32_t dtw_accel_get_strand(dtw_accel_t *device);
+uint32_t dtw_accel_get_qlen(dtw_accel_t *device);
+uint32_t dtw_accel_get_thresh(dtw_accel_t *device);
+uint32_t dtw_accel_get_ref_size(dtw_accel_t *device);
+uint32_t dtw_accel_get_cohort(dtw_accel_t *device);
 
 uint32_t dtw_accel_busy(dtw_accel_t *device);
 uint32_t dtw_accel_ref_load_done(dtw_accel_t *device);
@@ -0,0 +1,236 @@
+/* MIT License
+
+Copyright (c) 2022 Po Jui Shih
+Copyright (c) 2022 Hassaan Saadat
+Copyright (c) 2022 Sri Parameswaran
+Copyright (c) 2022 Hasindu Gamaarachchi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#ifndef DTW_SW_H
+#define DTW_SW_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dtw_accel.h"
+
+/*
+ * Bit-exact software model of a DTW core (dtw_core.sv, dtw_core_datapath.sv,
+ * dtw_core_pe.sv). It is used as a CPU fallback and as the golden reference for
+ * the accelerator: for the same reference memory contents and query it returns
+ * the same search_result_t as the core.
+ *
+ * What the model reproduces:
+ *  - 16 bit PEs. The cost is |x - y| of the 16 bit wrapped difference and the
+ *    accumulation saturates at DTW_SW_MAX_VALUE.
+ *  - Subsequence start. The first row sees N = NW = 0, every other cell starts
+ *    from all ones.
+ *  - The last row minimum is updated on strict '<', so the earliest column wins.
+ *    The position is the column index + 1.
+ *  - The reference memory as the loader leaves it. Word 0 of a reference is
+ *    never written, so the memory keeps its previous value (0 after
+ *    configuration). Memory past REF_LEN keeps whatever earlier, longer
+ *    references left there.
+ *  - Read latency. Even cores read the memory through port a, which has an
+ *    extra address register, so they see memory word 0 twice and report
+ *    positions one higher than odd cores (port b).
+ *  - The tail. The core runs two columns past REF_LEN. The first extra column
+ *    can move both the position and the score. The second only moves the
+ *    score, because the position word has already been sent by then.
+ *  - The band (REG_BAND). Every cell carries the warp offset of its path,
+ *    column - start column - row, from the dependency the PE picked: N takes
+ *    one off, W adds one, NW keeps it, ties going the PE's way. The offset
+ *    saturates at +-DTW_SW_OFF_MAX. With a band, cells more than band off
+ *    their path's start diagonal are MAX.
+ *  - The hit list (REG_HITS). A candidate follows the last row minimum until
+ *    a query length of columns pass without a strictly better value. It then goes
+ *    into the list, which is sorted by score, earlier positions first, and a new
+ *    candidate starts at the current column. Only columns up to REF_LEN count.
+ *  - The second strand (REG_STRAND). The column that reads its first word
+ *    starts over like column 0, with W = NW = MAX and offset 0, so no path
+ *    crosses from one strand into the other. Positions past it have bit 31
+ *    set and count from the first word of the second strand.
+ *  - The query length (REG_QLEN). A query of qlen samples sits in the last
+ *    qlen PEs and the first of them sees N = NW = 0 like PE 1, so the core
+ *    computes the DP matrix of the qlen rows alone.
+ *  - The early accept (REG_THRESH). The core stops at the first column up to
+ *    REF_LEN whose last row value is below the threshold and reports it. Its
+ *    minimum and hit list keep what they held at that column.
+ *
+ * The model assumes the query streams into the core without FIFO underruns
+ * and that the result FIFO is not full.
+ *
+ * dtw_sw_process_query runs a vectorized kernel when the CPU has one
+ * (DTW_SW_ISA_NEON on aarch64, DTW_SW_ISA_AVX2 on x86, picked at runtime by
+ * dtw_sw_init). The kernels sweep the DP matrix by anti-diagonals, so one
+ * instruction computes 8 (NEON) or 16 (AVX2) PEs of the same diagonal. Their
+ * u16 saturating add is the PE's saturating accumulation, so the results are
+ * identical to the scalar model.
+ *
+ * dtw_sw_process_queries puts one query in each lane instead, like the core
+ * runs a query over its PEs, and streams the reference once per 16 or 32
+ * queries. The state is a single column of 250 rows per query, which stays
+ * in L1 however long the reference is.
+ */
+
+#define DTW_SW_SQG_SIZE         250                     // PEs per core (SQG_SIZE), longest query
+#define DTW_SW_QUERY_WORDS      (DTW_SW_SQG_SIZE + 2)   // qid, pad word, samples of a full length query
+#define DTW_SW_MAX_VALUE        0xffff                  // MAX_BUF_VALUE of the 16 bit PEs
+#define DTW_SW_REF_MEM_SIZE     (1 << 18)               // largest reference memory words (REFMEM_PTR_WIDTH = 18)
+#define DTW_SW_OFF_MAX          511                     // warp offset saturation (OFF_WIDTH = 10)
+#define DTW_SW_BAND_MAX         255                     // widest band (BAND_WIDTH = 8)
+
+// Kernels
+#define DTW_SW_ISA_SCALAR       0
+#define DTW_SW_ISA_NEON         1
+#define DTW_SW_ISA_AVX2         2
+
+#define DTW_SW_LANES_MAX        16                      // u16 lanes of the widest kernel
+#define DTW_SW_COLS_PAD         (2 * DTW_SW_LANES_MAX)
+#define DTW_SW_BATCH_LANES_MAX  (2 * DTW_SW_LANES_MAX)  // queries per pass of dtw_sw_process_queries
+
+typedef struct {
+    uint16_t *mem;          // reference memory image, DTW_SW_REF_MEM_SIZE words
+    uint32_t ref_size;      // REG_REF_SIZE, words the addresses wrap at, DTW_SW_REF_MEM_SIZE after init
+    uint32_t ref_len;       // REF_LEN register
+
+    // Reference sample of every column as seen through port b (odd cores) and port a
+    // (even cores), stored back to front with DTW_SW_COLS_PAD words of padding on either
+    // side, so the kernels load the samples of a diagonal with ascending addresses
+    uint16_t *cols[2];
+    uint8_t isa;            // DTW_SW_ISA_*
+    uint16_t band;          // REG_BAND, 0 for unconstrained
+    uint32_t strand;        // REG_STRAND, first word of the second strand, 0 for one strand
+    uint16_t qlen;          // REG_QLEN, samples per query, DTW_SW_SQG_SIZE after init
+    uint16_t thresh;        // REG_THRESH, early accept below this score, 0 for off
+} dtw_sw_t;
+
+// Hit list of a query (Cand_* and Hit_* of dtw_core_datapath.sv)
+typedef struct {
+    uint32_t span;          // columns a candidate stays open, the query length
+    uint16_t cand_score;
+    uint32_t cand_pos;
+    search_hit_t hits[DTW_ACCEL_HITS_MAX];
+} dtw_sw_hits_t;
+
+/*
+ * Anti-diagonal sweep over a range of columns with the kernel of sw->isa, the
+ * building block of dtw_sw_process_query and of the sharded engine in
+ * dtw_sw_shard.h. Columns are counted like the core's (0 to REF_LEN + 1).
+ */
+typedef struct {
+    uint32_t first;             // first column
+    uint32_t n_cols;            // number of columns
+    const uint16_t *boundary;   // column first - 1, NULL for MAX (left of column 0), needs band 0
+    uint32_t own;               // the minima are only tracked from column first + own on
+
+    // columns[k] = column first + own - 1 + k * checkpoint, for k < n_checkpoints;
+    // checkpoint is 0 for none or at least DTW_SW_SQG_SIZE
+    uint32_t checkpoint;
+    uint32_t n_checkpoints;
+    uint16_t *columns;          // n_checkpoints * DTW_SW_SQG_SIZE words, sw->qlen used of each
+    uint16_t *last;             // column first + n_cols - 1, or NULL, sw->qlen words
+
+    // Early abandoning, 0 for off: cells at or above the cutoff or the score so far are
+    // not computed and read as MAX, which leaves every cell below them exact. The
+    // results, checkpoints and last column are only exact below the cutoff then.
+    uint16_t cutoff;
+
+    // Hit list of the columns from first + own on, NULL for none. Needs cutoff 0.
+    dtw_sw_hits_t *hits;
+
+    // Early accept, 0 for off: the sweep stops at the first column from first + own on,
+    // up to REF_LEN, whose last row value is below accept. The checkpoints and the last
+    // column are incomplete then. Exact with no cutoff or a cutoff of at least accept.
+    uint16_t accept;
+
+    // Results
+    uint16_t score;             // minimum of the last row
+    uint16_t pos_score;         // minimum of the last row up to column REF_LEN
+    uint32_t pos_col;           // first column holding pos_score
+    uint8_t accepted;           // stopped at pos_col by the early accept
+} dtw_sw_sweep_t;
+
+// dtw_core_pe.sv: cost of the wrapped 16 bit difference, saturating accumulation
+static inline uint16_t dtw_sw_pe(uint16_t x, uint16_t y, uint16_t n, uint16_t w, uint16_t nw) {
+    uint16_t diff = (uint16_t) (x - y);
+    uint16_t cost = (diff & 0x8000) ? (uint16_t) -diff : diff;
+
+    uint16_t min2 = (n > w) ? w : n;
+    uint16_t min3 = (min2 > nw) ? nw : min2;
+
+    uint16_t cost_buf_space = (uint16_t) (DTW_SW_MAX_VALUE - min3);
+    return (cost < cost_buf_space) ? (uint16_t) (cost + min3) : (uint16_t) DTW_SW_MAX_VALUE;
+}
+
+// dtw_core_pe.sv with a band: off receives the warp offset of the cell
+static inline uint16_t dtw_sw_pe_band(uint16_t x, uint16_t y, uint16_t n, uint16_t w, uint16_t nw,
+                                      int16_t n_off, int16_t w_off, int16_t nw_off, uint16_t band, int16_t *off) {
+    uint16_t min2 = (n > w) ? w : n;
+    int32_t o = (n > w) ? w_off + 1 : n_off - 1;
+    o = (min2 > nw) ? nw_off : o;
+    o = (o > DTW_SW_OFF_MAX) ? DTW_SW_OFF_MAX : (o < -DTW_SW_OFF_MAX) ? -DTW_SW_OFF_MAX : o;
+    *off = (int16_t) o;
+
+    uint16_t d = dtw_sw_pe(x, y, n, w, nw);
+    return (band != 0 && (o > band || -o > band)) ? (uint16_t) DTW_SW_MAX_VALUE : d;
+}
+
+// Reference sample of column j as read by core "core", port a (even cores) lags one cycle
+static inline uint16_t dtw_sw_column(const dtw_sw_t *sw, uint32_t core, uint32_t j) {
+    uint32_t lag = (core & 1) ? 0 : 1;
+    uint32_t addr = (j >= lag) ? j - lag : 0;
+    return sw->mem[addr & (sw->ref_size - 1)];
+}
+
+// Column where core "core" starts over on the second strand (strand_col), 0 for none
+static inline uint32_t dtw_sw_strand_col(const dtw_sw_t *sw, uint32_t core) {
+    return (sw->strand != 0) ? sw->strand + ((core & 1) ? 0 : 1) : 0;
+}
+
+// Words of a query as sent to the core: qid, pad word, sw->qlen samples
+static inline uint32_t dtw_sw_query_words(const dtw_sw_t *sw) {
+    return (uint32_t) sw->qlen + 2;
+}
+
+// Position word the core sends for position pos (strand_pos of dtw_core_datapath.sv)
+static inline uint32_t dtw_sw_position(const dtw_sw_t *sw, uint32_t core, uint32_t pos) {
+    uint32_t strand_col = dtw_sw_strand_col(sw, core);
+    return (strand_col != 0 && pos > strand_col) ? (UINT32_C(1) << 31) | ((pos - sw->strand) & 0x7fffffff) : pos;
+}
+
+int32_t dtw_sw_init(dtw_sw_t *sw);
+void dtw_sw_release(dtw_sw_t *sw);
+uint8_t dtw_sw_detect_isa(void);
+int32_t dtw_sw_set_isa(dtw_sw_t *sw, uint8_t isa);
+int32_t dtw_sw_set_band(dtw_sw_t *sw, uint32_t band);
+int32_t dtw_sw_set_query_len(dtw_sw_t *sw, uint32_t qlen);
+int32_t dtw_sw_set_thresh(dtw_sw_t *sw, uint32_t thresh);
+int32_t dtw_sw_set_ref_size(dtw_sw_t *sw, uint32_t size);
+int32_t dtw_sw_load_reference(dtw_sw_t *sw, const int32_t *ref, uint32_t size);
+int32_t dtw_sw_load_reference_strands(dtw_sw_t *sw, const int32_t *fwd, uint32_t fwd_size, const int32_t *rev, uint32_t rev_size);
+int32_t dtw_sw_process_query(const dtw_sw_t *sw, uint32_t core, const int32_t *query, uint32_t size, search_result_t *result);
+int32_t dtw_sw_process_query_hits(const dtw_sw_t *sw, uint32_t core, const int32_t *query, uint32_t size, uint32_t n_hits,
+                                  search_hits_t *hits);
+int32_t dtw_sw_process_query_pruned(const dtw_sw_t *sw, uint32_t core, const int32_t *query, uint32_t size, uint16_t max_score,
+                                    search_result_t *result);
+void dtw_sw_sweep(const dtw_sw_t *sw, uint32_t core, const uint16_t *squiggle, dtw_sw_sweep_t *sweep);
+int32_t dtw_sw_process_queries(const dtw_sw_t *sw, uint32_t core, const int32_t **queries, const uint32_t *lens, size_t n, search_result_t *out);
+
+#endif // DTW_SW_H
@@ -0,0 +1,83 @@
+/* MIT License
+
+Copyright (c) 2022 Po Jui Shih
+Copyright (c) 2022 Hassaan Saadat
+Copyright (c) 2022 Sri Parameswaran
+Copyright (c) 2022 Hasindu Gamaarachchi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#ifndef DTW_SW_SHARD_H
+#define DTW_SW_SHARD_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "dtw_sw.h"
+
+/*
+ * Multi-threaded software DTW. The columns of the reference are split into one
+ * shard per thread and the shards are swept in parallel (dtw_sw_sweep).
+ *
+ * A shard does not know the DP column it starts from until the shard before it
+ * is done. It starts DTW_SW_SHARD_WARMUP columns early from a MAX column
+ * instead, which can only give scores at least as high as the true ones, and
+ * saves its columns every DTW_SW_SHARD_CHECKPOINT columns. Paths of a 250
+ * sample query rarely span the warm-up, so the column at the shard boundary
+ * usually already matches the true one. When it does not, the caller
+ * re-sweeps the shard from the true column until it matches a saved column,
+ * because from there on both sweeps compute the same columns. The stitched
+ * {position, score} is therefore exactly what dtw_sw_process_query (and the
+ * core) would report.
+ */
+
+#define DTW_SW_SHARD_WARMUP         (4 * DTW_SW_SQG_SIZE)       // columns swept ahead of each shard
+#define DTW_SW_SHARD_CHECKPOINT     1024                        // columns between saved columns
+#define DTW_SW_SHARD_MIN_COLS       (4 * DTW_SW_SHARD_WARMUP)   // shortest shard worth a thread
+#define DTW_SW_SHARD_MAX_CHECKPOINTS ((DTW_SW_REF_MEM_SIZE + 2) / DTW_SW_SHARD_CHECKPOINT + 2)
+
+typedef struct {
+    const dtw_sw_t *sw;
+    uint32_t n_threads;         // including the calling thread
+    uint32_t warmup;            // DTW_SW_SHARD_WARMUP, 0 forces the re-sweep (tests)
+    pthread_t *threads;
+
+    // Thread pool
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint32_t generation;        // bumped for every query
+    uint32_t next_shard;        // next shard to be taken
+    uint32_t shards_done;
+    int stop;
+
+    // Current query
+    uint32_t core;
+    uint16_t squiggle[DTW_SW_SQG_SIZE];
+    uint32_t n_shards;
+    uint32_t *starts;           // first column of shard k, starts[n_shards] = REF_LEN + 2
+    dtw_sw_sweep_t *sweeps;
+    uint16_t *columns;          // DTW_SW_SHARD_MAX_CHECKPOINTS saved columns per shard
+    uint16_t *lasts;            // last column per shard
+} dtw_sw_shard_t;
+
+int32_t dtw_sw_shard_init(dtw_sw_shard_t *shard, const dtw_sw_t *sw, uint32_t n_threads);
+void dtw_sw_shard_release(dtw_sw_shard_t *shard);
+int32_t dtw_sw_shard_process_query(dtw_sw_shard_t *shard, uint32_t core, const int32_t *query, uint32_t size, search_result_t *result);
+
+#endif // DTW_SW_SHARD_H
@@ -0,0 +1,62 @@
+/* MIT License
+
+Copyright (c) 2022 Po Jui Shih
+Copyright (c) 2022 Hassaan Saadat
+Copyright (c) 2022 Sri Parameswaran
+Copyright (c) 2022 Hasindu Gamaarachchi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#ifndef DTW_SW_STREAM_H
+#define DTW_SW_STREAM_H
+
+#include <stdint.h>
+#include "dtw_sw.h"
+
+/*
+ * Streaming software DTW for read-until. The signal of a read arrives in
+ * chunks; every chunk adds its samples as rows below the ones already seen
+ * and only the last row of the DP matrix is kept, one word per reference
+ * column. After every chunk the best {position, score} of the read so far is
+ * known, and after n samples it is exactly what dtw_sw_process_query (and
+ * core "core") reports for those samples with a query length of n. Past
+ * DTW_SW_SQG_SIZE the read keeps extending with the same PE arithmetic, each
+ * strip starting from the last row of the one before, which is how reads
+ * longer than the cores are aligned. The band of sw applies too, keep it
+ * fixed for the length of a read. So does its early accept score: the result
+ * is the first column of the last row below it, if there is one.
+ */
+
+#define DTW_SW_STREAM_STRIP     64      // rows computed per pass over the reference
+
+typedef struct {
+    const dtw_sw_t *sw;
+    uint32_t core;          // core whose reference port is modelled
+    uint32_t qid;
+    uint32_t n_samples;     // samples of the read seen so far
+    uint16_t *row;          // last row, REF_LEN + 2 columns
+    int16_t *row_off;       // warp offsets of the last row, used with a band
+} dtw_sw_stream_t;
+
+int32_t dtw_sw_stream_init(dtw_sw_stream_t *stream, const dtw_sw_t *sw, uint32_t core);
+void dtw_sw_stream_release(dtw_sw_stream_t *stream);
+void dtw_sw_stream_reset(dtw_sw_stream_t *stream, uint32_t qid);
+int32_t dtw_sw_stream_push(dtw_sw_stream_t *stream, const int32_t *samples, uint32_t n, search_result_t *result);
+
+#endif // DTW_SW_STREAM_H
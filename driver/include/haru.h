@@ -31,6 +31,7 @@ SOFTWARE. */
 #include "dtw_accel.h"
 
 #include <stdint.h>
+#include <stddef.h>
 
 #define HARU_AXI_DMA_ADDR_BASE                              0xa0010000
 #define HARU_AXI_DMA_SIZE                                   0xffff
@@ -44,36 +45,118 @@ SOFTWARE. */
 #define HARU_AXI_DST_ADDR                                   0x20000000
 #define HARU_AXI_MM2S_BD_CHAIN_ADDR                         0x01000000
 #define HARU_AXI_S2MM_BD_CHAIN_ADDR                         0x02000000
+#define HARU_AXI_BD_CHAIN_SIZE                              0x10000
+
+// Backend of the DMA data buffers (see dma_buf.h). With DMA_BUF_AUTO the buffers are
+// u-dma-buf backed and cached when DMA_BUF_UDMABUF_SRC/DST exist, and at
+// HARU_AXI_SRC_ADDR/HARU_AXI_DST_ADDR through /dev/mem otherwise.
+#ifndef HARU_DMA_BUF_BACKEND
+#define HARU_DMA_BUF_BACKEND                                DMA_BUF_AUTO
+#endif
+
+// Records which reference is resident in the reference memory, so a load of the same reference
+// (same bitstream version, length and FNV-1a hash) can be skipped. Lives on a tmpfs so it does not
+// outlive a reboot; define it as NULL to always reload.
+#ifndef HARU_REF_STATE_FILE
+#define HARU_REF_STATE_FILE                                 "/run/haru_ref_state"
+#endif
+
+// UIO devices of the DMA interrupt lines (uio_pdrv_genirq, see uio_irq.h)
+#define HARU_AXI_DMA_MM2S_UIO                               "/dev/uio0"
+#define HARU_AXI_DMA_S2MM_UIO                               "/dev/uio1"
+// MCDMA channel i raises its mm2s interrupt on /dev/uio(2i) and its s2mm interrupt on /dev/uio(2i+1)
+#define HARU_AXI_MCDMA_UIO_FMT                              "/dev/uio%d"
+
+// One MCDMA channel (tdest) per DTW core, bounded by the bd rings that fit in the bd spaces
+#define HARU_MAX_ACCEL              (HARU_AXI_BD_CHAIN_SIZE / AXI_MCDMA_BD_RING_BYTES)
+static_assert(HARU_MAX_ACCEL >= 8, "The bd spaces must hold the rings of an 8 core design");
 
 #define HARU_AXI_BUFFER_SIZE        0xffff
 
+// Reference memory of a DTW core (REFMEM_PTR_WIDTH = 18 in dtw_accel.v), one sample per word.
+// A design with a smaller memory reports it in REG_REF_SIZE and loads are held to that.
+// The source buffer holds a whole reference so it is uploaded with a single transfer. Queries
+// are staged in its first HARU_AXI_BUFFER_SIZE bytes.
+#define HARU_REF_MAX_SIZE           (1 << 18)
+#define HARU_AXI_SRC_BUFFER_SIZE    (HARU_REF_MAX_SIZE * 4)
+
 #define HARU_AXIS_BATCH_MAX_SIZE    0x0fff
 
+// Maximum number of queries (one buffer descriptor each) moved by a single descriptor chain,
+// per channel. Queries of a batch are dealt round robin over the channels.
+#define HARU_BATCH_MAX_QUERIES      AXI_MCDMA_BD_RING_SIZE
+
+// Asynchronous queries: the source buffer is split into fixed slots, one per in-flight query.
+// The driver's qid carries the slot index in its low bits and a sequence number above them.
+#define HARU_QUERY_SLOT_SIZE        0x400   // bytes, qid word, pad word + up to 254 samples
+#define HARU_ASYNC_SLOTS            (HARU_AXI_BUFFER_SIZE / HARU_QUERY_SLOT_SIZE)
+#define HARU_ASYNC_QID_SLOT_BITS    8
+
+// Query slot states
+#define HARU_SLOT_FREE              0
+#define HARU_SLOT_ACQUIRED          1   // lent to the caller by haru_acquire_query_slot
+#define HARU_SLOT_IN_FLIGHT         2
+
+typedef struct {
+    uint64_t tag;
+    uint32_t qid;
+    uint8_t state;
+    uint8_t channel;        // MCDMA channel (core) the query was sent to
+} haru_async_slot_t;
+
+typedef struct {
+    haru_async_slot_t slots[HARU_ASYNC_SLOTS];
+    uint32_t seq;           // sequence number for the upper qid bits
+    uint32_t in_flight;     // submitted queries without a completion yet
+    uint32_t acquired;      // slots lent to the caller and not submitted yet
+    uint32_t next_slot;     // where to start looking for a free slot
+    uint32_t channel_in_flight[HARU_MAX_ACCEL];
+    uint32_t next_poll;     // channel haru_poll_completions looks at first
+} haru_async_t;
+
 typedef struct {
     dtw_accel_t dtw_accel;
     axi_dma_t axi_dma;
     axi_mcdma_t axi_mcdma;
+    haru_async_t async;
+    uint32_t num_accel;     // DTW cores in use, one MCDMA channel each
+    uint32_t n_hits;        // hits per result packet (REG_HITS)
 } haru_t;
 
 typedef struct {
-    uint32_t qid;
-    uint32_t position;
-    uint32_t score;
-} search_result_t;
+    uint64_t tag;
+    search_result_t result;
+    uint32_t core;          // DTW core (MCDMA channel) that ran the query
+} haru_completion_t;
 
 int32_t haru_init(haru_t *haru);
+int32_t haru_irq_init(haru_t *haru, uint8_t mode);
 void haru_release(haru_t *haru);
 void haru_multi_accel_release(haru_t *haru);
 void haru_multi_accel_free(haru_t *haru);
 void haru_check_key(haru_t *haru);
 uint32_t haru_get_version(haru_t *haru);
+int32_t haru_set_band(haru_t *haru, uint32_t band);
+int32_t haru_set_hits(haru_t *haru, uint32_t n_hits);
+int32_t haru_set_query_len(haru_t *haru, uint32_t qlen);
+int32_t haru_set_thresh(haru_t *haru, uint32_t thresh);
+int32_t haru_set_cohort(haru_t *haru, uint32_t cycles);
 void haru_get_load_done(haru_t *haru);
 
 int32_t haru_load_reference(haru_t *haru, int32_t *ref, uint32_t size);
 void haru_process_query(haru_t *haru, int32_t *query, uint32_t size, search_result_t *results);
 
 int haru_multi_accel_init(haru_t *haru);
+int haru_multi_accel_irq_init(haru_t *haru, uint8_t mode);
 int haru_multi_accel_load_reference(haru_t *haru, int32_t *ref, uint32_t size);
-void haru_multi_accel_process_query(haru_t *haru, int32_t *query, uint32_t size, search_result_t *results);
+int32_t haru_load_reference_strands(haru_t *haru, const int32_t *fwd, uint32_t fwd_size, const int32_t *rev, uint32_t rev_size);
+int haru_multi_accel_process_query(haru_t *haru, int32_t *query, uint32_t size, search_result_t *results);
+int haru_process_query_hits(haru_t *haru, const int32_t *query, uint32_t size, search_hits_t *hits);
+int haru_process_queries(haru_t *haru, const int32_t **queries, const uint32_t *lens, size_t n, search_result_t *out);
+int32_t *haru_acquire_query_slot(haru_t *haru, uint32_t *slot_id);
+void haru_release_query_slot(haru_t *haru, uint32_t slot_id);
+int haru_submit_slot(haru_t *haru, uint32_t slot_id, uint32_t size, uint64_t tag);
+int haru_submit(haru_t *haru, const int32_t *query, uint32_t size, uint64_t tag);
+int haru_poll_completions(haru_t *haru, haru_completion_t *out, int max);
 
 #endif // HARU_H
\ No newline at end of file
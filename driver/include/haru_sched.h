@@ -0,0 +1,101 @@
+/* MIT License
+
+Copyright (c) 2022 Po Jui Shih
+Copyright (c) 2022 Hassaan Saadat
+Copyright (c) 2022 Sri Parameswaran
+Copyright (c) 2022 Hasindu Gamaarachchi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#ifndef HARU_SCHED_H
+#define HARU_SCHED_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "haru.h"
+#include "dtw_sw.h"
+
+/*
+ * Scheduler that serves one queue of reads with the DTW cores and with CPU
+ * threads running the software model at the same time.
+ *
+ * The FPGA side is driven by the caller from haru_sched_submit and
+ * haru_sched_poll with the asynchronous query calls of haru_t, so haru_t is
+ * only ever touched by one thread. It takes reads from the head of the queue.
+ * The CPU workers steal from the tail. Each side takes a read only when its
+ * expected finish time, from an EWMA of its measured service time per read
+ * and its backlog, is not later than the other side's, and an idle side always
+ * takes work.
+ */
+
+#define HARU_SCHED_QUEUE_SIZE       256     // reads between haru_sched_submit and haru_sched_poll
+#define HARU_SCHED_FPGA_DEPTH       4       // reads in flight per DTW core
+#define HARU_SCHED_EWMA_SHIFT       3       // service time EWMA weight 1/8
+
+// The CPU workers return the results of an odd core (see dtw_sw.h), completions carry HARU_SCHED_CPU_CORE
+#define HARU_SCHED_SW_CORE          1
+#define HARU_SCHED_CPU_CORE         HARU_MAX_ACCEL
+
+typedef struct {
+    uint64_t tag;
+    uint64_t start_ns;      // when a DTW core was given the read
+    int32_t query[DTW_SW_QUERY_WORDS];     // dtw_sw_query_words(sw) used
+} haru_sched_job_t;
+
+typedef struct {
+    haru_t *haru;           // multi-accelerator driver, NULL for CPU only
+    const dtw_sw_t *sw;     // software model holding the same reference and query length
+    uint32_t n_workers;
+    pthread_t *workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;    // the queue or the FPGA backlog changed
+    int stop;
+
+    // Pending reads, the FPGA takes from the head and the CPU from the tail
+    haru_sched_job_t *queue;
+    uint32_t head;
+    uint32_t count;
+
+    // Reads finished by the CPU, handed out by haru_sched_poll
+    haru_completion_t *done;
+    uint32_t done_head;
+    uint32_t done_count;
+    uint32_t cpu_busy;
+
+    // Reads on the FPGA, haru_submit tag i is fpga_jobs[i]. They are kept so that reads
+    // dropped after a DMA error go back to the queue.
+    haru_sched_job_t fpga_jobs[HARU_ASYNC_SLOTS];
+    uint8_t fpga_used[HARU_ASYNC_SLOTS];
+    uint32_t fpga_in_flight;
+    uint64_t fpga_last_done_ns[HARU_MAX_ACCEL];
+
+    // Service time of one read on one DTW core / one CPU thread (ns, 0 until measured)
+    uint64_t fpga_ns;
+    uint64_t cpu_ns;
+    uint64_t fpga_reads;
+    uint64_t cpu_reads;
+} haru_sched_t;
+
+int haru_sched_init(haru_sched_t *sched, haru_t *haru, const dtw_sw_t *sw, uint32_t n_workers);
+void haru_sched_release(haru_sched_t *sched);
+int haru_sched_submit(haru_sched_t *sched, const int32_t *query, uint32_t size, uint64_t tag);
+int haru_sched_poll(haru_sched_t *sched, haru_completion_t *out, int max);
+
+#endif // HARU_SCHED_H
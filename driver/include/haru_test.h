@@ -28,4 +28,19 @@ SOFTWARE. */
 
 void test_dtw_accel_key();
 void test_dtw_accel_reset();
+void test_uio_irq_eventfd();
+void test_dma_buf_anon();
+void test_dtw_sw_small_query();
+void test_dtw_sw_simd();
+void test_dtw_sw_batch();
+void test_dtw_sw_shard();
+void test_dtw_sw_stream();
+void test_dtw_sw_pruned();
+void test_dtw_sw_band();
+void test_dtw_sw_hits();
+void test_dtw_sw_strands();
+void test_dtw_sw_query_len();
+void test_dtw_sw_thresh();
+void test_dtw_sw_ref_size();
+void test_haru_sched_cpu();
 #endif // HARU_TESTS_H
\ No newline at end of file
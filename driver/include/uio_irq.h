@@ -0,0 +1,69 @@
+/* MIT License
+
+Copyright (c) 2022 Po Jui Shih
+Copyright (c) 2022 Hassaan Saadat
+Copyright (c) 2022 Sri Parameswaran
+Copyright (c) 2022 Hasindu Gamaarachchi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#ifndef UIO_IRQ_H
+#define UIO_IRQ_H
+
+#include <stdint.h>
+
+/*
+ * Completion backend for the DMA engines. Instead of spinning on uncached
+ * status registers, the driver can block on a UIO device file (one per
+ * interrupt line, see drivers/uio/uio_pdrv_genirq). An eventfd can stand in
+ * for the UIO device so the backend can be exercised without the board.
+ */
+
+// Completion modes
+#define UIO_IRQ_MODE_POLL       0   // Spin on the status registers (default)
+#define UIO_IRQ_MODE_IRQ        1   // Block on the interrupt straight away
+#define UIO_IRQ_MODE_HYBRID     2   // Spin for a while, then block on the interrupt
+
+// Number of status checks in hybrid mode before going to sleep
+#define UIO_IRQ_HYBRID_SPIN     2000
+
+// Timeout of a single blocking wait. Status is rechecked after every timeout.
+#define UIO_IRQ_TIMEOUT_MS      100
+
+typedef struct {
+    int fd;             // UIO device or eventfd, -1 when polling
+    int is_eventfd;     // fd is a local eventfd stand-in
+    uint8_t mode;       // UIO_IRQ_MODE_*
+    uint32_t spin;      // status checks before sleeping in hybrid mode
+} uio_irq_t;
+
+// Returns 1 when the waited-for work is complete, 0 if not yet, -1 on error
+typedef int (*uio_irq_done_fn)(void *arg);
+
+void uio_irq_init_poll(uio_irq_t *irq);
+int32_t uio_irq_init(uio_irq_t *irq, const char *dev_path, uint8_t mode);
+int32_t uio_irq_init_eventfd(uio_irq_t *irq, uint8_t mode);
+void uio_irq_release(uio_irq_t *irq);
+
+int32_t uio_irq_enable(uio_irq_t *irq);
+int32_t uio_irq_wait(uio_irq_t *irq, int timeout_ms);
+int32_t uio_irq_signal(uio_irq_t *irq);
+int32_t uio_irq_wait_done(uio_irq_t *irq, uio_irq_done_fn done, void *arg);
+
+#endif // UIO_IRQ_H
@@ -34,7 +34,7 @@ SOFTWARE. */
 /*
  * AXI DMA general function
  */
-int32_t axi_dma_init(axi_dma_t *device, uint32_t baseaddr, uint32_t src_addr, uint32_t dst_addr, uint32_t size) {
+int32_t axi_dma_init(axi_dma_t *device, uint32_t baseaddr, uint32_t src_addr, uint32_t dst_addr, uint32_t size, uint32_t src_size, uint8_t buf_backend) {
     // Open /dev/mem for memory mapping
     int32_t dev_fd = open("/dev/mem", O_RDWR | O_SYNC);
     if (dev_fd < 0) {
@@ -56,33 +56,59 @@ int32_t axi_dma_init(axi_dma_t *device, uint32_t baseaddr, uint32_t src_addr, ui
     }
     dma_mm2s_reset(device);
     dma_s2mm_reset(device);
+    uio_irq_init_poll(&device->mm2s_irq);
+    uio_irq_init_poll(&device->s2mm_irq);
 
-    // Init buffers
-    device->p_src_addr = src_addr;
-    device->v_src_addr = (void *) mmap(NULL, 0xffff, PROT_READ | PROT_WRITE, MAP_SHARED, dev_fd, src_addr);
-    if (device->v_src_addr == MAP_FAILED) {
+    // Init buffers, see dma_buf.h for the backends. The source buffer is "src_size" bytes
+    // so a whole reference fits in it.
+    if (dma_buf_init(&device->src_buf, buf_backend, DMA_BUF_UDMABUF_SRC, src_addr, src_size)) {
         munmap(device->v_baseaddr, device->size);
         close(dev_fd);
         return -1;
     }
-    
-    device->p_dst_addr = dst_addr;
-    device->v_dst_addr = (void *) mmap(NULL, 0xffff, PROT_READ | PROT_WRITE, MAP_SHARED, dev_fd, dst_addr);
-    if (device->v_dst_addr == MAP_FAILED) {
+    device->p_src_addr = device->src_buf.p_addr;
+    device->v_src_addr = device->src_buf.v_addr;
+
+    if (dma_buf_init(&device->dst_buf, buf_backend, DMA_BUF_UDMABUF_DST, dst_addr, size)) {
         munmap(device->v_baseaddr, device->size);
-        munmap(device->v_src_addr, device->size);
+        dma_buf_release(&device->src_buf);
         close(dev_fd);
         return -1;
     }
+    device->p_dst_addr = device->dst_buf.p_addr;
+    device->v_dst_addr = device->dst_buf.v_addr;
 
     close(dev_fd);
     return 0;
 }
 
 void axi_dma_release(axi_dma_t *device) {
+    uio_irq_release(&device->mm2s_irq);
+    uio_irq_release(&device->s2mm_irq);
     munmap(device->v_baseaddr, device->size);
-    munmap(device->v_src_addr, device->size);
-    munmap(device->v_dst_addr, device->size);
+    dma_buf_release(&device->src_buf);
+    dma_buf_release(&device->dst_buf);
+}
+
+// Selects how transfer completions are waited for (UIO_IRQ_MODE_*). In the
+// interrupt modes the driver sleeps on the given UIO devices instead of
+// spinning on the status registers.
+int32_t axi_dma_irq_init(axi_dma_t *device, const char *mm2s_uio, const char *s2mm_uio, uint8_t mode) {
+    uio_irq_release(&device->mm2s_irq);
+    uio_irq_release(&device->s2mm_irq);
+    if (uio_irq_init(&device->mm2s_irq, mm2s_uio, mode) || uio_irq_init(&device->s2mm_irq, s2mm_uio, mode)) {
+        uio_irq_release(&device->mm2s_irq);
+        uio_irq_release(&device->s2mm_irq);
+        return -1;
+    }
+
+    if (mode != UIO_IRQ_MODE_POLL) {
+        dma_mm2s_IOC_IRQ_EN(device);
+        dma_mm2s_ERR_IRQ_EN(device);
+        dma_s2mm_IOC_IRQ_EN(device);
+        dma_s2mm_ERR_IRQ_EN(device);
+    }
+    return 0;
 }
 
 /*
@@ -94,6 +120,7 @@ void axi_dma_mm2s_transfer(axi_dma_t *device, uint32_t size) {
     dma_mm2s_stop(device);
 
     // Config and start
+    dma_buf_sync_for_device(&device->src_buf, 0, size);
     dma_mm2s_set_src_addr(device, device->p_src_addr);
     _reg_set(device->v_baseaddr, AXI_DMA_MM2S_CR, 0xf001);
     _reg_set(device->v_baseaddr, AXI_DMA_MM2S_LENGTH, size);
@@ -104,17 +131,37 @@ void axi_dma_mm2s_transfer(axi_dma_t *device, uint32_t size) {
     // HARU_INFO("mm2s transfer done\n");
 }
 
+// Streams the first "size" bytes of the source buffer as back to back transfers of at most
+// AXI_DMA_MAX_LENGTH bytes. The engine is reset and the buffer written back once, and each
+// transfer is programmed as soon as the previous one is done.
+void axi_dma_mm2s_stream(axi_dma_t *device, uint32_t size) {
+    // Clearup
+    dma_mm2s_reset(device);
+    dma_mm2s_stop(device);
+
+    dma_buf_sync_for_device(&device->src_buf, 0, size);
+    _reg_set(device->v_baseaddr, AXI_DMA_MM2S_CR, 0xf001);
+    for (uint32_t offset = 0; offset < size; offset += AXI_DMA_MAX_LENGTH) {
+        uint32_t length = (size - offset) < AXI_DMA_MAX_LENGTH ? (size - offset) : AXI_DMA_MAX_LENGTH;
+        dma_mm2s_set_src_addr(device, device->p_src_addr + offset);
+        _reg_set(device->v_baseaddr, AXI_DMA_MM2S_LENGTH, length);
+        dma_mm2s_busy_wait(device);
+    }
+}
+
 void axi_dma_s2mm_transfer(axi_dma_t *device, uint32_t size) {
     // Clearup
     dma_s2mm_reset(device);
     dma_s2mm_stop(device);
 
     // Config and start
+    dma_buf_sync_for_cpu(&device->dst_buf, 0, size);
     dma_s2mm_set_dst_addr(device, device->p_dst_addr);
     _reg_set(device->v_baseaddr, AXI_DMA_S2MM_CR, 0xf001);
     _reg_set(device->v_baseaddr, AXI_DMA_S2MM_LENGTH, size);
     
     dma_s2mm_busy_wait(device);
+    dma_buf_sync_for_cpu(&device->dst_buf, 0, size);
 }
 
 void axi_dma_haru_query_transfer(axi_dma_t *device, uint32_t src_len, uint32_t dst_len) {
@@ -123,6 +170,9 @@ void axi_dma_haru_query_transfer(axi_dma_t *device, uint32_t src_len, uint32_t d
     dma_mm2s_stop(device);
     dma_s2mm_stop(device);
 
+    // Write back the query, and drop stale lines so none is evicted over the result
+    dma_buf_sync_for_device(&device->src_buf, 0, src_len);
+    dma_buf_sync_for_cpu(&device->dst_buf, 0, dst_len);
     dma_mm2s_set_src_addr(device, device->p_src_addr);
     dma_s2mm_set_dst_addr(device, device->p_dst_addr);
 
@@ -133,21 +183,46 @@ void axi_dma_haru_query_transfer(axi_dma_t *device, uint32_t src_len, uint32_t d
     
     dma_mm2s_busy_wait(device);
     dma_s2mm_busy_wait(device);
+    dma_buf_sync_for_cpu(&device->dst_buf, 0, dst_len);
+}
+
+// Completion checks for uio_irq_wait_done. The IOC/error interrupts are
+// acknowledged (write 1 to clear) so the line drops before it is unmasked again.
+static int dma_mm2s_done(void *arg) {
+    axi_dma_t *device = (axi_dma_t *) arg;
+    uint32_t mm2s_sr = _reg_get(device->v_baseaddr, AXI_DMA_MM2S_SR);
+    if (mm2s_sr & ((1 << AXI_DMA_SR_IOC_IRQ) | (1 << AXI_DMA_SR_ERR_IRQ))) {
+        _reg_set(device->v_baseaddr, AXI_DMA_MM2S_SR, mm2s_sr & ((1 << AXI_DMA_SR_IOC_IRQ) | (1 << AXI_DMA_SR_ERR_IRQ)));
+    }
+    if (mm2s_sr & (1 << AXI_DMA_SR_ERR_IRQ)) {
+        return -1;
+    }
+    return (mm2s_sr & (1 << AXI_DMA_SR_IDLE)) ? 1 : 0;
+}
+
+static int dma_s2mm_done(void *arg) {
+    axi_dma_t *device = (axi_dma_t *) arg;
+    uint32_t s2mm_sr = _reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR);
+    if (s2mm_sr & ((1 << AXI_DMA_SR_IOC_IRQ) | (1 << AXI_DMA_SR_ERR_IRQ))) {
+        _reg_set(device->v_baseaddr, AXI_DMA_S2MM_SR, s2mm_sr & ((1 << AXI_DMA_SR_IOC_IRQ) | (1 << AXI_DMA_SR_ERR_IRQ)));
+    }
+    if (s2mm_sr & (1 << AXI_DMA_SR_ERR_IRQ)) {
+        return -1;
+    }
+    return (s2mm_sr & (1 << AXI_DMA_SR_IDLE)) ? 1 : 0;
 }
 
-// TODO: find a more efficient way to do this
+// Spins on the status register, or sleeps on the mm2s interrupt when set up
+// with axi_dma_irq_init.
 void dma_mm2s_busy_wait(axi_dma_t *device) {
-    volatile uint32_t mm2s_sr = _reg_get(device->v_baseaddr, AXI_DMA_MM2S_SR);
-    while (!(mm2s_sr & (1 << AXI_DMA_SR_IDLE))) {
-        mm2s_sr = _reg_get(device->v_baseaddr, AXI_DMA_MM2S_SR);
+    if (uio_irq_wait_done(&device->mm2s_irq, dma_mm2s_done, device)) {
+        HARU_ERROR("%s", "mm2s transfer failed.");
     }
 }
 
-// TODO: find a more efficient way to do this
 void dma_s2mm_busy_wait(axi_dma_t *device) {
-    volatile uint32_t s2mm_sr = _reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR);
-    while (!(s2mm_sr & (1 << AXI_DMA_SR_IDLE))) {
-        s2mm_sr = _reg_get(device->v_baseaddr, AXI_DMA_S2MM_SR);
+    if (uio_irq_wait_done(&device->s2mm_irq, dma_s2mm_done, device)) {
+        HARU_ERROR("%s", "s2mm transfer failed.");
     }
 }
 
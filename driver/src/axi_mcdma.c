@@ -15,7 +15,7 @@ This module is used to control the AXI MCDMA.
 #include <unistd.h>
 #include <string.h>
 
-int32_t axi_mcdma_init(axi_mcdma_t *device, uint32_t baseaddr, uint32_t src_addr, uint32_t dst_addr, uint32_t mm2s_bd_addr, uint32_t s2mm_bd_addr, uint32_t size) {
+int32_t axi_mcdma_init(axi_mcdma_t *device, uint32_t baseaddr, uint32_t src_addr, uint32_t dst_addr, uint32_t mm2s_bd_addr, uint32_t s2mm_bd_addr, uint32_t size, uint32_t bd_size, uint32_t src_size, uint8_t buf_backend) {
 	/*** Memory map address space ***/
 	// Open /dev/mem for memory mapping
 	int32_t dev_fd = open("/dev/mem", O_RDWR | O_SYNC);
@@ -34,6 +34,12 @@ int32_t axi_mcdma_init(axi_mcdma_t *device, uint32_t baseaddr, uint32_t src_addr
 		return -1;
 	}
 
+	// Disable all channels
+	device->channel_en = 0x0000;
+	for (int i = 0; i < NUM_CHANNELS; i++) {
+		device->channels[i] = NULL;
+	}
+
 	// Reset device
 	mcdma_reset(device);
 	mm2s_common_status(device);
@@ -41,27 +47,28 @@ int32_t axi_mcdma_init(axi_mcdma_t *device, uint32_t baseaddr, uint32_t src_addr
 	s2mm_common_status(device);
 	s2mm_channel_status(device);
 
-	// intialise mm2s buffer space
-	device->p_buffer_src_addr = src_addr;
-	device->v_buffer_src_addr = (uint32_t *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, dev_fd, src_addr); 
-	if (device->v_buffer_src_addr == MAP_FAILED) {
+	// intialise mm2s buffer space ("src_size" bytes, large enough for a whole reference), see dma_buf.h for the backends
+	if (dma_buf_init(&device->src_buf, buf_backend, DMA_BUF_UDMABUF_SRC, src_addr, src_size)) {
 		HARU_ERROR("%s", "buffer src address map failed.");
 		close(dev_fd);
 		return -1;
 	}
+	device->p_buffer_src_addr = device->src_buf.p_addr;
+	device->v_buffer_src_addr = (uint32_t *) device->src_buf.v_addr;
 
 	// initialise s2mm buffer space
-	device->p_buffer_dst_addr = dst_addr;
-	device->v_buffer_dst_addr = (uint32_t *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, dev_fd, dst_addr); 
-	if (device->v_buffer_dst_addr == MAP_FAILED) {
+	if (dma_buf_init(&device->dst_buf, buf_backend, DMA_BUF_UDMABUF_DST, dst_addr, size)) {
 		HARU_ERROR("%s", "buffer dst address map failed.");
 		close(dev_fd);
 		return -1;
 	}
+	device->p_buffer_dst_addr = device->dst_buf.p_addr;
+	device->v_buffer_dst_addr = (uint32_t *) device->dst_buf.v_addr;
 
-	// initialise mm2s bd chain space
+	// initialise mm2s bd chain space ("bd_size" bytes, one bd ring per channel)
+	device->bd_size = bd_size;
 	device->p_mm2s_bd_addr = mm2s_bd_addr;
-	device->v_mm2s_bd_addr = (uint32_t *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, dev_fd, mm2s_bd_addr); 
+	device->v_mm2s_bd_addr = (uint32_t *) mmap(NULL, bd_size, PROT_READ | PROT_WRITE, MAP_SHARED, dev_fd, mm2s_bd_addr); 
 	if (device->v_mm2s_bd_addr == MAP_FAILED) {
 		HARU_ERROR("%s", "mm2s bd chain address map failed.");
 		close(dev_fd);
@@ -70,19 +77,13 @@ int32_t axi_mcdma_init(axi_mcdma_t *device, uint32_t baseaddr, uint32_t src_addr
 
 	// initialise s2mm bd chain space
 	device->p_s2mm_bd_addr = s2mm_bd_addr;
-	device->v_s2mm_bd_addr = (uint32_t *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, dev_fd, s2mm_bd_addr); 
+	device->v_s2mm_bd_addr = (uint32_t *) mmap(NULL, bd_size, PROT_READ | PROT_WRITE, MAP_SHARED, dev_fd, s2mm_bd_addr); 
 	if (device->v_s2mm_bd_addr == MAP_FAILED) {
 		HARU_ERROR("%s", "s2mm bd chain address map failed.");
 		close(dev_fd);
 		return -1;
 	}
 
-	// Disable all channels
-	device->channel_en = 0x0000;
-	for (int i = 0; i < NUM_CHANNELS; i++) {
-		device->channels[i] = NULL;
-	}
-
 	close(dev_fd);
 
 	return 0;
@@ -96,11 +97,13 @@ int32_t axi_mcdma_init(axi_mcdma_t *device, uint32_t baseaddr, uint32_t src_addr
 		- source and destination buffer sizes
 		- channel enable
 */
-void axi_mcdma_channel_init(axi_mcdma_t *device, int channel_idx, uint32_t src_addr_offset, uint32_t dst_addr_offset, int buf_size) {
+void axi_mcdma_channel_init(axi_mcdma_t *device, int channel_idx, uint32_t src_addr_offset, uint32_t dst_addr_offset, uint32_t src_buf_size, uint32_t dst_buf_size) {
 	axi_mcdma_channel_t *channel;
 	if (device->channels[channel_idx] == NULL) {
 		channel = (axi_mcdma_channel_t *) malloc(sizeof( axi_mcdma_channel_t ));
 		HARU_MALLOC_CHK(channel);
+		uio_irq_init_poll(&channel->mm2s_irq);
+		uio_irq_init_poll(&channel->s2mm_irq);
 		device->channels[channel_idx] = channel;
 	} else {
 		channel = device->channels[channel_idx];
@@ -110,66 +113,105 @@ void axi_mcdma_channel_init(axi_mcdma_t *device, int channel_idx, uint32_t src_a
 
 	channel->channel_id = channel_idx;
 	channel->p_buf_src_addr = device->p_buffer_src_addr + src_addr_offset;
-	channel->v_buf_src_addr = device->v_buffer_src_addr + src_addr_offset;
+	channel->v_buf_src_addr = (uint32_t *) ((uint8_t *) device->v_buffer_src_addr + src_addr_offset);
 	channel->p_buf_dst_addr = device->p_buffer_dst_addr + dst_addr_offset;
-	channel->v_buf_dst_addr = device->v_buffer_dst_addr + dst_addr_offset;
-	channel->buf_size = buf_size;
-	channel->mm2s_bd_chain = NULL;
-	channel->s2mm_bd_chain = NULL;
+	channel->v_buf_dst_addr = (uint32_t *) ((uint8_t *) device->v_buffer_dst_addr + dst_addr_offset);
+	channel->src_buf_size = src_buf_size;
+	channel->dst_buf_size = dst_buf_size;
+	axi_mcdma_bd_rings_init(device, channel_idx);
 
 	HARU_LOG("Configuring channel %d struct", channel_idx);
 	HARU_LOG("ch%d_p_buf_src_addr : 0x%08x", channel_idx, channel->p_buf_src_addr);
 	HARU_LOG("ch%d_p_buf_dst_addr : 0x%08x", channel_idx, channel->p_buf_dst_addr);
-	HARU_LOG("ch%d_size : 0x%08x", channel_idx, channel->buf_size);
+	HARU_LOG("ch%d_src_size : 0x%08x", channel_idx, channel->src_buf_size);
+	HARU_LOG("ch%d_dst_size : 0x%08x", channel_idx, channel->dst_buf_size);
 }
 
 /*
-	Initialises a single buffer descriptor in memory space. Overwites existing buffer descriptor if there is one.
-	This buffer descriptor sets up a transfer with "transfer_size" number of bytes from the channel's source buffer.
+	Lays out a channel's mm2s and s2mm descriptor rings in the bd spaces. Channel i owns the
+	AXI_MCDMA_BD_RING_SIZE descriptors starting at i * AXI_MCDMA_BD_RING_BYTES. Each descriptor points
+	to the next one and the last points back to the first, so the engine can follow the ring forever and
+	new work is queued by writing descriptors and moving the tail.
 */
-void axi_mcdma_mm2s_bd_init(axi_mcdma_t *device, int channel_idx, uint32_t transfer_size, uint32_t bd_addr_offset) {
-	HARU_LOG("Configuring mm2s bd chain for channel %d", channel_idx);
+static void mcdma_bd_ring_init(axi_mcdma_bd_ring_t *ring, uint32_t p_ring_addr, uint32_t *v_ring_addr) {
+	for (int i = 0; i < AXI_MCDMA_BD_RING_SIZE; i++) {
+		axi_mcdma_bd_t *bd = &ring->bds[i];
+		bd->p_bd_addr = p_ring_addr + i * AXI_MCDMA_BD_SIZE;
+		bd->v_bd_addr = v_ring_addr + ((i * AXI_MCDMA_BD_SIZE) >> 2);
+		bd->next_bd_addr = p_ring_addr + ((i + 1) % AXI_MCDMA_BD_RING_SIZE) * AXI_MCDMA_BD_SIZE;
+		bd->buffer_addr = 0;
+		bd->buffer_length = 0;
+		bd->sof = 0;
+		bd->eof = 0;
+		bd->tid = 0;
+		bd->tdest = 0;
+
+		// Both bd layouts share the next descriptor and buffer address offsets
+		for (int j = 0; j < AXI_MCDMA_BD_SIZE; j += 4) {
+			_reg_set(bd->v_bd_addr, j, 0x00000000);
+		}
+		_reg_set(bd->v_bd_addr, AXI_MCDMA_MM2S_BD_NEXT_DESC_LSB, bd->next_bd_addr);
+	}
+	ring->prod = 0;
+	ring->cons = 0;
+}
+
+void axi_mcdma_bd_rings_init(axi_mcdma_t *device, int channel_idx) {
 	axi_mcdma_channel_t *channel = device->channels[channel_idx];
+	uint32_t ring_offset = channel_idx * AXI_MCDMA_BD_RING_BYTES;
 
-	if (transfer_size > channel->buf_size) {
-		HARU_ERROR("Transfer size (0x%08x) greater than buffer size (0x%08x)", transfer_size, channel->buf_size);
-	} else {
-		HARU_LOG("Setting up BD for %d bytes.", transfer_size);
+	if (ring_offset + AXI_MCDMA_BD_RING_BYTES > (uint32_t) device->bd_size) {
+		HARU_ERROR("bd ring of channel %d does not fit in the bd space (0x%08x bytes)", channel_idx, device->bd_size);
+		return;
 	}
 
-	axi_mcdma_bd_t *mm2s_bd = channel->mm2s_bd_chain;
-	if (mm2s_bd == NULL) {
-        HARU_LOG("allocating struct of size: %ld bytes", sizeof(axi_mcdma_bd_t));
-		mm2s_bd = (axi_mcdma_bd_t *) malloc(sizeof( axi_mcdma_bd_t ));
-		HARU_MALLOC_CHK(mm2s_bd);
-		channel->mm2s_bd_chain = mm2s_bd;
-	}
+	mcdma_bd_ring_init(&channel->mm2s_ring, device->p_mm2s_bd_addr + ring_offset, device->v_mm2s_bd_addr + (ring_offset >> 2));
+	mcdma_bd_ring_init(&channel->s2mm_ring, device->p_s2mm_bd_addr + ring_offset, device->v_s2mm_bd_addr + (ring_offset >> 2));
 
-	HARU_LOG("mm2s_bd_chain address: %p", channel->mm2s_bd_chain);
-	HARU_LOG("mm2s_bd address: %p", mm2s_bd);
+	channel->mm2s_curr_bd_addr = channel->mm2s_ring.bds[0].p_bd_addr;
+	channel->mm2s_tail_bd_addr = channel->mm2s_ring.bds[0].p_bd_addr;
+	channel->s2mm_curr_bd_addr = channel->s2mm_ring.bds[0].p_bd_addr;
+	channel->s2mm_tail_bd_addr = channel->s2mm_ring.bds[0].p_bd_addr;
 
-	channel->mm2s_curr_bd_addr = device->p_mm2s_bd_addr + bd_addr_offset;
-	channel->mm2s_tail_bd_addr = device->p_mm2s_bd_addr + bd_addr_offset;
-	mm2s_bd->p_bd_addr = device->p_mm2s_bd_addr + bd_addr_offset;
-	mm2s_bd->v_bd_addr = device->v_mm2s_bd_addr + bd_addr_offset;
+	HARU_LOG("ch%d mm2s bd ring @ 0x%08x, s2mm bd ring @ 0x%08x", channel_idx, channel->mm2s_ring.bds[0].p_bd_addr, channel->s2mm_ring.bds[0].p_bd_addr);
+}
+
+/*
+	Number of descriptors that can still be queued on a ring before it is full.
+*/
+int axi_mcdma_bd_ring_space(axi_mcdma_bd_ring_t *ring) {
+	return AXI_MCDMA_BD_RING_SIZE - (int) (ring->prod - ring->cons);
+}
+
+/*
+	Queues one mm2s descriptor on the channel's ring. The descriptor transfers "transfer_size" bytes starting at
+	"buf_offset" bytes into the channel's source buffer. The descriptor becomes the channel's new tail but the
+	tail register is not written until mcdma_mm2s_program_tail_bd, so several descriptors can be queued and
+	handed to the engine with a single register write. Returns -1 if the ring is full.
+*/
+int axi_mcdma_mm2s_bd_enqueue(axi_mcdma_t *device, int channel_idx, uint32_t buf_offset, uint32_t transfer_size, int sof, int eof) {
+	axi_mcdma_channel_t *channel = device->channels[channel_idx];
+	axi_mcdma_bd_ring_t *ring = &channel->mm2s_ring;
 
-	mm2s_bd->next_mcdma_bd = NULL;
-	mm2s_bd->next_bd_addr = channel->mm2s_tail_bd_addr;
-	mm2s_bd->buffer_addr = channel->p_buf_src_addr;
+	if (axi_mcdma_bd_ring_space(ring) == 0) {
+		HARU_ERROR("ch%d mm2s bd ring is full", channel_idx);
+		return -1;
+	}
+	if (buf_offset + transfer_size > channel->src_buf_size) {
+		HARU_ERROR("Transfer (0x%08x bytes @ 0x%08x) exceeds buffer size (0x%08x)", transfer_size, buf_offset, channel->src_buf_size);
+		return -1;
+	}
+
+	// Write the payload back to memory before the engine can fetch it
+	dma_buf_sync_for_device(&device->src_buf, channel->p_buf_src_addr - device->p_buffer_src_addr + buf_offset, transfer_size);
+
+	axi_mcdma_bd_t *mm2s_bd = &ring->bds[ring->prod % AXI_MCDMA_BD_RING_SIZE];
+	mm2s_bd->buffer_addr = channel->p_buf_src_addr + buf_offset;
 	mm2s_bd->buffer_length = transfer_size;
-	mm2s_bd->sof = 1;
-	mm2s_bd->eof = 1;
+	mm2s_bd->sof = sof;
+	mm2s_bd->eof = eof;
 	mm2s_bd->tid = 0;
 
-	// HARU_LOG("%s", "mm2s_bd fields:");
-	// HARU_LOG("> next_bd_addr: 0x%08x", mm2s_bd->next_bd_addr);
-	// HARU_LOG("> buffer_addr: 0x%08x", mm2s_bd->buffer_addr);
-	// HARU_LOG("> buffer_length: 0x%08x", mm2s_bd->buffer_length);
-	// HARU_LOG("> sof: %d", mm2s_bd->sof);
-	// HARU_LOG("> eof: %d", mm2s_bd->eof);
-	// HARU_LOG("> tid: %d", mm2s_bd->tid);
-
-	_reg_set(mm2s_bd->v_bd_addr, AXI_MCDMA_MM2S_BD_NEXT_DESC_LSB, mm2s_bd->next_bd_addr);
 	_reg_set(mm2s_bd->v_bd_addr, AXI_MCDMA_MM2S_BD_BUF_ADDR_LSB, mm2s_bd->buffer_addr);
 	uint32_t control = (uint32_t) (mm2s_bd->sof << 31) | (uint32_t) (mm2s_bd->eof << 30) | mm2s_bd->buffer_length;
 	_reg_set(mm2s_bd->v_bd_addr, AXI_MCDMA_MM2S_BD_CONTROL, control);
@@ -178,92 +220,313 @@ void axi_mcdma_mm2s_bd_init(axi_mcdma_t *device, int channel_idx, uint32_t trans
 	_reg_set(mm2s_bd->v_bd_addr, AXI_MCDMA_MM2S_BD_STATUS, 0x00000000);
 
 	HARU_LOG("Writing mm2s_bd fields to addr 0x%08x:", mm2s_bd->p_bd_addr);
-	HARU_LOG("reg@0x%03x : 0x%08x (next bd)", mm2s_bd->p_bd_addr + AXI_MCDMA_MM2S_BD_NEXT_DESC_LSB, mm2s_bd->next_bd_addr);
 	HARU_LOG("reg@0x%03x : 0x%08x (buf addr)", mm2s_bd->p_bd_addr + AXI_MCDMA_MM2S_BD_BUF_ADDR_LSB, mm2s_bd->buffer_addr);
 	HARU_LOG("reg@0x%03x : 0x%08x (bd sof, eof, buf length)", mm2s_bd->p_bd_addr + AXI_MCDMA_MM2S_BD_CONTROL, control);
 	HARU_LOG("reg@0x%03x : 0x%08x (bd tid)", mm2s_bd->p_bd_addr + AXI_MCDMA_MM2S_BD_CONTROL_SIDEBAND, control_sideband);
-	HARU_LOG("reg@0x%03x : 0x%08x (bd status)", mm2s_bd->p_bd_addr + AXI_MCDMA_MM2S_BD_STATUS, 0x00000000);
+
+	channel->mm2s_tail_bd_addr = mm2s_bd->p_bd_addr;
+	return (int) (ring->prod++ % AXI_MCDMA_BD_RING_SIZE);
 }
 
-void axi_mcdma_s2mm_bd_init(axi_mcdma_t *device, int channel_idx, uint32_t transfer_size, uint32_t bd_addr_offset) {
-	HARU_LOG("Configuring s2mm bd chain for channel %d", channel_idx);
+/*
+	Queues "transfer_size" bytes at "buf_offset" of the channel's source buffer as a single packet that is
+	spread over as many descriptors of at most AXI_MCDMA_BD_MAX_LENGTH bytes as needed. Only the first
+	descriptor carries sof and only the last eof, so the engine streams the whole packet without the
+	driver stepping in. Returns the number of descriptors queued, or -1 if they do not all fit the ring.
+*/
+int axi_mcdma_mm2s_packet_enqueue(axi_mcdma_t *device, int channel_idx, uint32_t buf_offset, uint32_t transfer_size) {
 	axi_mcdma_channel_t *channel = device->channels[channel_idx];
+	uint32_t n_bds = (transfer_size + AXI_MCDMA_BD_MAX_LENGTH - 1) / AXI_MCDMA_BD_MAX_LENGTH;
 
-	if (transfer_size > channel->buf_size) {
-		HARU_ERROR("Transfer size (0x%08x) greater than buffer size (0x%08x)", transfer_size, channel->buf_size);
-	} else {
-		HARU_LOG("Setting up BD for %d bytes.", transfer_size);
+	// Check everything up front so a packet is never left half queued
+	if (n_bds == 0 || (int) n_bds > axi_mcdma_bd_ring_space(&channel->mm2s_ring)) {
+		HARU_ERROR("ch%d mm2s bd ring cannot take a packet of %d descriptors", channel_idx, (int) n_bds);
+		return -1;
+	}
+	if (buf_offset + transfer_size > channel->src_buf_size) {
+		HARU_ERROR("Transfer (0x%08x bytes @ 0x%08x) exceeds buffer size (0x%08x)", transfer_size, buf_offset, channel->src_buf_size);
+		return -1;
 	}
 
+	for (uint32_t i = 0; i < n_bds; i++) {
+		uint32_t offset = i * AXI_MCDMA_BD_MAX_LENGTH;
+		uint32_t length = (transfer_size - offset) < AXI_MCDMA_BD_MAX_LENGTH ? (transfer_size - offset) : AXI_MCDMA_BD_MAX_LENGTH;
+		if (axi_mcdma_mm2s_bd_enqueue(device, channel_idx, buf_offset + offset, length, i == 0, i == n_bds - 1) < 0) {
+			return -1;
+		}
+	}
+	return (int) n_bds;
+}
 
-	axi_mcdma_bd_t *s2mm_bd = channel->s2mm_bd_chain;
-	if (s2mm_bd == NULL) {
-		s2mm_bd = (axi_mcdma_bd_t *) malloc(sizeof( axi_mcdma_bd_t ));
-		HARU_MALLOC_CHK(s2mm_bd);
-		channel->s2mm_bd_chain = s2mm_bd;
+/*
+	s2mm counterpart of axi_mcdma_mm2s_bd_enqueue. The descriptor receives up to "transfer_size" bytes into
+	"buf_offset" bytes of the channel's destination buffer.
+*/
+int axi_mcdma_s2mm_bd_enqueue(axi_mcdma_t *device, int channel_idx, uint32_t buf_offset, uint32_t transfer_size) {
+	axi_mcdma_channel_t *channel = device->channels[channel_idx];
+	axi_mcdma_bd_ring_t *ring = &channel->s2mm_ring;
+
+	if (axi_mcdma_bd_ring_space(ring) == 0) {
+		HARU_ERROR("ch%d s2mm bd ring is full", channel_idx);
+		return -1;
+	}
+	if (buf_offset + transfer_size > channel->dst_buf_size) {
+		HARU_ERROR("Transfer (0x%08x bytes @ 0x%08x) exceeds buffer size (0x%08x)", transfer_size, buf_offset, channel->dst_buf_size);
+		return -1;
 	}
 
-	channel->s2mm_curr_bd_addr = device->p_s2mm_bd_addr + bd_addr_offset;
-	channel->s2mm_tail_bd_addr = device->p_s2mm_bd_addr + bd_addr_offset;
-	s2mm_bd->p_bd_addr = device->p_s2mm_bd_addr + bd_addr_offset;
-	s2mm_bd->v_bd_addr = device->v_s2mm_bd_addr;
-	*s2mm_bd->v_bd_addr += bd_addr_offset;
+	// Drop cached lines of the target so none is evicted over the data the engine writes
+	dma_buf_sync_for_cpu(&device->dst_buf, channel->p_buf_dst_addr - device->p_buffer_dst_addr + buf_offset, transfer_size);
 
-	s2mm_bd->next_mcdma_bd = NULL;
-	s2mm_bd->next_bd_addr = channel->s2mm_tail_bd_addr;
-	s2mm_bd->buffer_addr = channel->p_buf_dst_addr;
+	axi_mcdma_bd_t *s2mm_bd = &ring->bds[ring->prod % AXI_MCDMA_BD_RING_SIZE];
+	s2mm_bd->buffer_addr = channel->p_buf_dst_addr + buf_offset;
 	s2mm_bd->buffer_length = transfer_size;
+	s2mm_bd->sof = 0;
+	s2mm_bd->eof = 0;
 
-	// HARU_LOG("%s", "s2mm_bd fields:");
-	// HARU_LOG("> next_bd_addr: 0x%08x", s2mm_bd->next_bd_addr);
-	// HARU_LOG("> buffer_addr: 0x%08x", s2mm_bd->buffer_addr);
-	// HARU_LOG("> buffer_length: 0x%08x", s2mm_bd->buffer_length);
-
-	_reg_set(s2mm_bd->v_bd_addr, AXI_MCDMA_S2MM_BD_NEXT_DESC_LSB, s2mm_bd->next_bd_addr);
 	_reg_set(s2mm_bd->v_bd_addr, AXI_MCDMA_S2MM_BD_BUF_ADDR_LSB, s2mm_bd->buffer_addr);
-	uint32_t control = (uint32_t) (s2mm_bd->sof << 31) | (uint32_t) (s2mm_bd->eof << 30) | s2mm_bd->buffer_length;
-	_reg_set(s2mm_bd->v_bd_addr, AXI_MCDMA_S2MM_BD_CONTROL, control);
+	_reg_set(s2mm_bd->v_bd_addr, AXI_MCDMA_S2MM_BD_CONTROL, s2mm_bd->buffer_length);
 	_reg_set(s2mm_bd->v_bd_addr, AXI_MCDMA_S2MM_BD_STATUS, 0x00000000);
 
 	HARU_LOG("Writing s2mm_bd fields to addr 0x%08x:", s2mm_bd->p_bd_addr);
-	HARU_LOG("reg@0x%03x : 0x%08x (next bd)", s2mm_bd->p_bd_addr + AXI_MCDMA_S2MM_BD_NEXT_DESC_LSB, s2mm_bd->next_bd_addr);
 	HARU_LOG("reg@0x%03x : 0x%08x (buf addr)", s2mm_bd->p_bd_addr + AXI_MCDMA_S2MM_BD_BUF_ADDR_LSB, s2mm_bd->buffer_addr);
 	HARU_LOG("reg@0x%03x : 0x%08x (buf length)", s2mm_bd->p_bd_addr + AXI_MCDMA_S2MM_BD_CONTROL, s2mm_bd->buffer_length);
-	HARU_LOG("reg@0x%03x : 0x%08x (bd status)", s2mm_bd->p_bd_addr + AXI_MCDMA_S2MM_BD_STATUS, 0x00000000);
+
+	channel->s2mm_tail_bd_addr = s2mm_bd->p_bd_addr;
+	return (int) (ring->prod++ % AXI_MCDMA_BD_RING_SIZE);
 }
 
-int axi_mcdma_mm2s_transfer(axi_mcdma_t *device) {
-	// Clearup
+/*
+	Takes back the s2mm descriptor queued last, which must not have been handed to the engine yet (its tail
+	not programmed), e.g. when the mm2s descriptor of the same query cannot be queued.
+*/
+void axi_mcdma_s2mm_bd_cancel(axi_mcdma_t *device, int channel_idx) {
+	axi_mcdma_channel_t *channel = device->channels[channel_idx];
+	axi_mcdma_bd_ring_t *ring = &channel->s2mm_ring;
+
+	if (ring->prod == ring->cons) {
+		return;
+	}
+	ring->prod--;
+	channel->s2mm_tail_bd_addr = ring->bds[(ring->prod - 1) % AXI_MCDMA_BD_RING_SIZE].p_bd_addr;
+}
+
+/*
+	Moves the consumer index of a ring past the descriptors the engine has marked completed, in order and at
+	most max of them. Returns the number of descriptors reclaimed, or -1 if a completed descriptor reports an error.
+	If sync_buf is given, the buffer of every reclaimed descriptor is made visible to the CPU.
+*/
+static int mcdma_bd_ring_reclaim(axi_mcdma_bd_ring_t *ring, uint32_t status_offset, uint32_t *curr_bd_addr, int max, dma_buf_t *sync_buf) {
+	int reclaimed = 0;
+	while (ring->cons != ring->prod && reclaimed < max) {
+		axi_mcdma_bd_t *bd = &ring->bds[ring->cons % AXI_MCDMA_BD_RING_SIZE];
+		uint32_t status = _reg_get(bd->v_bd_addr, status_offset);
+		if (!(status & AXI_MCDMA_MM2S_BD_DMA_COMPLETED)) {
+			break;
+		}
+		if (status & (AXI_MCDMA_MM2S_BD_DMA_INT_ERR | AXI_MCDMA_MM2S_BD_DMA_SLV_ERR | AXI_MCDMA_MM2S_BD_DMA_DEC_ERR)) {
+			HARU_ERROR("bd @ 0x%08x completed with error (status 0x%08x)", bd->p_bd_addr, status);
+			return -1;
+		}
+		if (sync_buf != NULL) {
+			dma_buf_sync_for_cpu(sync_buf, bd->buffer_addr - sync_buf->p_addr, bd->buffer_length);
+		}
+		ring->cons++;
+		reclaimed++;
+	}
+	*curr_bd_addr = ring->bds[ring->cons % AXI_MCDMA_BD_RING_SIZE].p_bd_addr;
+	return reclaimed;
+}
+
+int axi_mcdma_mm2s_bd_reclaim(axi_mcdma_t *device, int channel_idx) {
+	axi_mcdma_channel_t *channel = device->channels[channel_idx];
+	return mcdma_bd_ring_reclaim(&channel->mm2s_ring, AXI_MCDMA_MM2S_BD_STATUS, &channel->mm2s_curr_bd_addr, AXI_MCDMA_BD_RING_SIZE, NULL);
+}
+
+int axi_mcdma_s2mm_bd_reclaim(axi_mcdma_t *device, int channel_idx) {
+	axi_mcdma_channel_t *channel = device->channels[channel_idx];
+	return mcdma_bd_ring_reclaim(&channel->s2mm_ring, AXI_MCDMA_S2MM_BD_STATUS, &channel->s2mm_curr_bd_addr, AXI_MCDMA_BD_RING_SIZE, &device->dst_buf);
+}
+
+/*
+	Reclaims at most max completed s2mm descriptors, so a caller can consume results in bounded batches.
+*/
+int axi_mcdma_s2mm_bd_reclaim_max(axi_mcdma_t *device, int channel_idx, int max) {
+	axi_mcdma_channel_t *channel = device->channels[channel_idx];
+	return mcdma_bd_ring_reclaim(&channel->s2mm_ring, AXI_MCDMA_S2MM_BD_STATUS, &channel->s2mm_curr_bd_addr, max, &device->dst_buf);
+}
+
+/*
+	Starts the engine and leaves it running. Every enabled channel's current descriptor is pointed at the
+	oldest unreclaimed descriptor of its ring, so later transfers only queue descriptors and move the tail.
+	The engine is reset first; this is only done at init and on error recovery.
+*/
+void axi_mcdma_start(axi_mcdma_t *device) {
 	mcdma_reset(device);
-	mcdma_s2mm_stop(device);
-	mcdma_mm2s_stop(device);
 
-	// Config and start
 	_reg_set(device->v_baseaddr, AXI_MCDMA_MM2S_CHEN, device->channel_en);
 	HARU_LOG("reg@0x%03x : 0x%08x (channel enable)", AXI_MCDMA_MM2S_CHEN, device->channel_en);
+	_reg_set(device->v_baseaddr, AXI_MCDMA_S2MM_CHEN, device->channel_en);
+	HARU_LOG("reg@0x%03x : 0x%08x (channel enable)", AXI_MCDMA_S2MM_CHEN, device->channel_en);
 
-
-	// Program mm2s current and tail descriptor
 	for (int i = 0; i < NUM_CHANNELS; i++) {
 		if (device->channel_en & (1 << i)) {
 			mcdma_config_mm2s_channel(device, i);
+			mcdma_config_s2mm_channel(device, i);
 		}
 	}
 
+	mcdma_s2mm_start(device);
 	mcdma_mm2s_start(device);
+}
+
+/*
+	Error recovery: drops every descriptor still queued, resets the engine and starts it again.
+*/
+void axi_mcdma_recover(axi_mcdma_t *device) {
+	HARU_ERROR("%s", "Recovering MCDMA.");
+	mm2s_common_status(device);
+	mm2s_channel_status(device);
+	s2mm_common_status(device);
+	s2mm_channel_status(device);
 
 	for (int i = 0; i < NUM_CHANNELS; i++) {
-		if (device->channel_en & (1 << i)) {
-			mcdma_mm2s_program_tail_bd(device, i);
+		axi_mcdma_channel_t *channel = device->channels[i];
+		if (channel == NULL) {
+			continue;
 		}
+		channel->mm2s_ring.cons = channel->mm2s_ring.prod;
+		channel->s2mm_ring.cons = channel->s2mm_ring.prod;
+		channel->mm2s_curr_bd_addr = channel->mm2s_ring.bds[channel->mm2s_ring.cons % AXI_MCDMA_BD_RING_SIZE].p_bd_addr;
+		channel->s2mm_curr_bd_addr = channel->s2mm_ring.bds[channel->s2mm_ring.cons % AXI_MCDMA_BD_RING_SIZE].p_bd_addr;
 	}
 
-	int res;
-	res = mcdma_mm2s_busy_wait(device);
-	if (res) {
-		HARU_ERROR("%s", "mm2s transfer failed.");
+	axi_mcdma_start(device);
+}
+
+static int mcdma_halted(axi_mcdma_t *device) {
+	return (_reg_get(device->v_baseaddr, AXI_MCDMA_MM2S_CSR) & AXI_MCDMA_MM2S_HALTED) ||
+		(_reg_get(device->v_baseaddr, AXI_MCDMA_S2MM_CSR) & AXI_MCDMA_S2MM_HALTED);
+}
+
+typedef struct {
+	axi_mcdma_t *device;
+	int channel_idx;
+	int wait_mm2s;
+	int wait_s2mm;
+} mcdma_wait_t;
+
+/*
+	Completion check for uio_irq_wait_done. Reclaims completed descriptors and acknowledges the channel
+	interrupts so the lines drop before they are unmasked again.
+*/
+static int mcdma_channel_done(void *arg) {
+	mcdma_wait_t *wait = (mcdma_wait_t *) arg;
+	axi_mcdma_t *device = wait->device;
+	int channel_idx = wait->channel_idx;
+	axi_mcdma_channel_t *channel = device->channels[channel_idx];
+
+	if (channel->mm2s_irq.fd >= 0) {
+		_reg_set(device->v_baseaddr, (AXI_MCDMA_MM2S_CHSR + AXI_MCDMA_CH_OFFSET*channel_idx), AXI_MCDMA_CH_IOC_IRQ | AXI_MCDMA_CH_DLY_IRQ | AXI_MCDMA_CH_ERR_IRQ);
+	}
+	if (channel->s2mm_irq.fd >= 0) {
+		_reg_set(device->v_baseaddr, (AXI_MCDMA_S2MM_CHSR + AXI_MCDMA_CH_OFFSET*channel_idx), AXI_MCDMA_CH_IOC_IRQ | AXI_MCDMA_CH_DLY_IRQ | AXI_MCDMA_CH_ERR_IRQ);
+	}
+
+	if ((wait->wait_mm2s && axi_mcdma_mm2s_bd_reclaim(device, channel_idx) < 0) ||
+		(wait->wait_s2mm && axi_mcdma_s2mm_bd_reclaim(device, channel_idx) < 0) ||
+		mcdma_halted(device)) {
+		return -1;
+	}
+
+	return (!wait->wait_mm2s || channel->mm2s_ring.cons == channel->mm2s_ring.prod) &&
+		(!wait->wait_s2mm || channel->s2mm_ring.cons == channel->s2mm_ring.prod);
+}
+
+/*
+	Waits until every descriptor queued on the channel's mm2s and/or s2mm ring has completed, either by
+	polling the descriptors or by sleeping on the channel's interrupt (see axi_mcdma_channel_irq_init).
+	The engine halts on DMA/SG errors, in which case it is recovered and -1 is returned.
+*/
+static int mcdma_wait_channel(axi_mcdma_t *device, int channel_idx, int wait_mm2s, int wait_s2mm) {
+	axi_mcdma_channel_t *channel = device->channels[channel_idx];
+	mcdma_wait_t wait = {device, channel_idx, wait_mm2s, wait_s2mm};
+
+	// Results arrive after the query is consumed, so the s2mm interrupt covers both directions
+	uio_irq_t *irq = wait_s2mm ? &channel->s2mm_irq : &channel->mm2s_irq;
+	if (uio_irq_wait_done(irq, mcdma_channel_done, &wait)) {
+		HARU_ERROR("ch%d transfer failed.", channel_idx);
+		axi_mcdma_recover(device);
 		return -1;
 	}
+	return 0;
+}
+
+/*
+	Selects how completions on a channel are waited for (UIO_IRQ_MODE_*). In the interrupt modes the
+	channel's IOC and error interrupts are enabled and the driver sleeps on the given UIO devices.
+*/
+int32_t axi_mcdma_channel_irq_init(axi_mcdma_t *device, int channel_idx, const char *mm2s_uio, const char *s2mm_uio, uint8_t mode) {
+	axi_mcdma_channel_t *channel = device->channels[channel_idx];
+
+	uio_irq_release(&channel->mm2s_irq);
+	uio_irq_release(&channel->s2mm_irq);
+	if (uio_irq_init(&channel->mm2s_irq, mm2s_uio, mode) || uio_irq_init(&channel->s2mm_irq, s2mm_uio, mode)) {
+		uio_irq_release(&channel->mm2s_irq);
+		uio_irq_release(&channel->s2mm_irq);
+		return -1;
+	}
+
+	// Reprogram the channel control registers with the interrupt enables
+	uint32_t mm2s_chcr = AXI_MCDMA_MM2S_CHRS | (channel->mm2s_irq.fd >= 0 ? AXI_MCDMA_CH_IOC_IRQ_EN | AXI_MCDMA_CH_ERR_IRQ_EN : 0);
+	uint32_t s2mm_chcr = AXI_MCDMA_S2MM_CHRS | (channel->s2mm_irq.fd >= 0 ? AXI_MCDMA_CH_IOC_IRQ_EN | AXI_MCDMA_CH_ERR_IRQ_EN : 0);
+	_reg_set(device->v_baseaddr, (AXI_MCDMA_MM2S_CHCR + AXI_MCDMA_CH_OFFSET*channel_idx), mm2s_chcr);
+	_reg_set(device->v_baseaddr, (AXI_MCDMA_S2MM_CHCR + AXI_MCDMA_CH_OFFSET*channel_idx), s2mm_chcr);
+	HARU_LOG("reg@0x%03x : 0x%08x (channel %d control)", AXI_MCDMA_MM2S_CHCR + AXI_MCDMA_CH_OFFSET*channel_idx, mm2s_chcr, channel_idx);
+	HARU_LOG("reg@0x%03x : 0x%08x (channel %d control)", AXI_MCDMA_S2MM_CHCR + AXI_MCDMA_CH_OFFSET*channel_idx, s2mm_chcr, channel_idx);
+
+	return 0;
+}
+
+/*
+	Enabled channels with descriptors queued on their mm2s or s2mm ring that have not been reclaimed yet.
+*/
+static uint32_t mcdma_mm2s_pending(axi_mcdma_t *device) {
+	uint32_t channel_mask = 0;
+	for (int i = 0; i < NUM_CHANNELS; i++) {
+		if ((device->channel_en & (1 << i)) && device->channels[i]->mm2s_ring.prod != device->channels[i]->mm2s_ring.cons) {
+			channel_mask |= 1 << i;
+		}
+	}
+	return channel_mask;
+}
+
+static uint32_t mcdma_s2mm_pending(axi_mcdma_t *device) {
+	uint32_t channel_mask = 0;
+	for (int i = 0; i < NUM_CHANNELS; i++) {
+		if ((device->channel_en & (1 << i)) && device->channels[i]->s2mm_ring.prod != device->channels[i]->s2mm_ring.cons) {
+			channel_mask |= 1 << i;
+		}
+	}
+	return channel_mask;
+}
+
+int axi_mcdma_mm2s_transfer(axi_mcdma_t *device) {
+	// Hand queued descriptors to the running engine. A channel with nothing queued keeps its tail, which
+	// points at a zeroed (never used) or already completed descriptor.
+	uint32_t channel_mask = mcdma_mm2s_pending(device);
+	for (int i = 0; i < NUM_CHANNELS; i++) {
+		if (channel_mask & (1 << i)) {
+			mcdma_mm2s_program_tail_bd(device, i);
+		}
+	}
+
+	for (int i = 0; i < NUM_CHANNELS; i++) {
+		if ((channel_mask & (1 << i)) && mcdma_wait_channel(device, i, 1, 0)) {
+			HARU_ERROR("%s", "mm2s transfer failed.");
+			return -1;
+		}
+	}
 
 	HARU_LOG("%s", "mm2s transfer done.");
 	mm2s_common_status(device);
@@ -274,25 +537,20 @@ int axi_mcdma_mm2s_transfer(axi_mcdma_t *device) {
 }
 
 int axi_mcdma_s2mm_transfer(axi_mcdma_t *device) {
-	// Config and start
-	_reg_set(device->v_baseaddr, AXI_MCDMA_S2MM_CHEN, device->channel_en);
-	HARU_LOG("reg@0x%03x : 0x%08x (channel enable)", AXI_MCDMA_S2MM_CHEN, device->channel_en);
-
-
-	// Program s2mm current and tail descriptor
+	// Hand queued descriptors to the running engine. A channel with nothing queued keeps its tail, which
+	// points at a zeroed (never used) or already completed descriptor.
+	uint32_t channel_mask = mcdma_s2mm_pending(device);
 	for (int i = 0; i < NUM_CHANNELS; i++) {
-		if (device->channel_en & (1 << i)) {
-			mcdma_config_s2mm_channel(device, i);
-			mcdma_mm2s_start(device);
+		if (channel_mask & (1 << i)) {
 			mcdma_s2mm_program_tail_bd(device, i);
 		}
 	}
 
-	int res;
-	res = mcdma_s2mm_busy_wait(device);
-	if (res) {
-		HARU_ERROR("%s", "s2mm transfer failed.");
-		return -1;
+	for (int i = 0; i < NUM_CHANNELS; i++) {
+		if ((channel_mask & (1 << i)) && mcdma_wait_channel(device, i, 0, 1)) {
+			HARU_ERROR("%s", "s2mm transfer failed.");
+			return -1;
+		}
 	}
 
 	HARU_LOG("%s", "s2mm transfer done.");
@@ -304,129 +562,101 @@ int axi_mcdma_s2mm_transfer(axi_mcdma_t *device) {
 }
 
 void axi_mcdma_release(axi_mcdma_t *device) {
+	mcdma_reset(device);
 	munmap(device->v_baseaddr, device->size);
-	munmap(device->v_buffer_src_addr, device->size);
-	munmap(device->v_buffer_dst_addr, device->size);
-	munmap(device->v_mm2s_bd_addr, device->size);
-	munmap(device->v_s2mm_bd_addr, device->size);
+	dma_buf_release(&device->src_buf);
+	dma_buf_release(&device->dst_buf);
+	munmap(device->v_mm2s_bd_addr, device->bd_size);
+	munmap(device->v_s2mm_bd_addr, device->bd_size);
 }
 
 void axi_mcdma_free(axi_mcdma_t *device) {
-	axi_mcdma_channel_t *channel;
-	axi_mcdma_bd_t *curr_bd;
-	axi_mcdma_bd_t *next_bd;
 	for (int i = 0; i < NUM_CHANNELS; i++) {
-		channel = device->channels[i];
-		if (channel != NULL) {
-			HARU_LOG("%s", "channel not null.");
-			curr_bd = channel->mm2s_bd_chain;
-			while (curr_bd != NULL) {
-				HARU_LOG("freeing pointer @ %p", curr_bd);
-				next_bd = curr_bd->next_mcdma_bd;
-				free(curr_bd);
-				curr_bd = next_bd;
-			}
-			HARU_LOG("%s", "Freed mm2s bd chain.");
-
-			curr_bd = channel->s2mm_bd_chain;
-			while (curr_bd != NULL) {
-				HARU_LOG("freeing pointer @ %p", curr_bd);
-				next_bd = curr_bd->next_mcdma_bd;
-				free(curr_bd);
-				curr_bd = next_bd;
-			}
-			HARU_LOG("%s", "Freed s2mm bd chain.");
-
-			HARU_LOG("%s", "Freed channel");
-		} else {
-			HARU_LOG("%s", "channel is null.");
+		if (device->channels[i] != NULL) {
+			uio_irq_release(&device->channels[i]->mm2s_irq);
+			uio_irq_release(&device->channels[i]->s2mm_irq);
 		}
-	}
-
-	for (int i = 0; i < NUM_CHANNELS; i++) {
 		free(device->channels[i]);
+		device->channels[i] = NULL;
 	}
 }
 
 int axi_mcdma_haru_query_transfer(axi_mcdma_t *device, int channel_idx, uint32_t src_len, uint32_t dst_len) {
-	// Clearup
-	mcdma_reset(device);
-	mcdma_s2mm_stop(device);
-	mcdma_mm2s_stop(device);
-
-	// mm2s_clear_channel_status(device);
-	mm2s_common_status(device);
-	mm2s_channel_status(device);
-	s2mm_common_status(device);
-	s2mm_channel_status(device);
-
-	/* s2mm setup */
-	// s2mm bd config
-	axi_mcdma_s2mm_bd_init(device, channel_idx, dst_len, 0);
-	_reg_set(device->v_baseaddr, AXI_MCDMA_S2MM_CHEN, device->channel_en);
-	HARU_LOG("reg@0x%03x : 0x%08x (channel enable)", AXI_MCDMA_S2MM_CHEN, device->channel_en);
-	mcdma_config_s2mm_channel(device, channel_idx);
+	if (axi_mcdma_s2mm_bd_enqueue(device, channel_idx, 0, dst_len) < 0 ||
+		axi_mcdma_mm2s_bd_enqueue(device, channel_idx, 0, src_len, 1, 1) < 0) {
+		return -1;
+	}
 
-	// s2mm start
-	mcdma_s2mm_start(device);
-	mcdma_s2mm_program_tail_bd(device, channel_idx);
+	return axi_mcdma_haru_chain_transfer(device, channel_idx);
+}
 
-	/* mm2s setup */
-	// mm2s bd config
-	axi_mcdma_mm2s_bd_init(device, 0, src_len, 0);
-	_reg_set(device->v_baseaddr, AXI_MCDMA_MM2S_CHEN, device->channel_en);
-	HARU_LOG("reg@0x%03x : 0x%08x (channel enable)", AXI_MCDMA_MM2S_CHEN, device->channel_en);
-	mcdma_config_mm2s_channel(device, channel_idx);
+/*
+	Hands every mm2s and s2mm descriptor queued on a channel's rings (see axi_mcdma_*_bd_enqueue) to the
+	running engine and waits once for all of them to complete. The engine is not stopped or reset.
+*/
+int axi_mcdma_haru_chain_transfer(axi_mcdma_t *device, int channel_idx) {
+	return axi_mcdma_haru_chain_transfer_channels(device, 1 << channel_idx);
+}
 
-	// mm2s start
-	mcdma_mm2s_start(device);
-	mcdma_mm2s_program_tail_bd(device, channel_idx);
+/*
+	Same as axi_mcdma_haru_chain_transfer for every channel in channel_mask. All tails are programmed before
+	waiting on any channel, so the channels (and the cores behind their tdest) work concurrently.
+*/
+int axi_mcdma_haru_chain_transfer_channels(axi_mcdma_t *device, uint32_t channel_mask) {
+	channel_mask &= device->channel_en;
+	for (int i = 0; i < NUM_CHANNELS; i++) {
+		if (channel_mask & (1 << i)) {
+			mcdma_s2mm_program_tail_bd(device, i);
+			mcdma_mm2s_program_tail_bd(device, i);
+		}
+	}
 
-	int res;
-	res = mcdma_mm2s_busy_wait(device);
-	if (res) {
-		HARU_ERROR("%s", "mm2s query transfer failed.");
-		return -1;
+	for (int i = 0; i < NUM_CHANNELS; i++) {
+		if ((channel_mask & (1 << i)) && mcdma_wait_channel(device, i, 1, 1)) {
+			HARU_ERROR("%s", "query transfer failed.");
+			return -1;
+		}
 	}
-	HARU_LOG("%s", "mm2s query transfer done.");
-	mm2s_common_status(device);
-	mm2s_channel_status(device);
-	mm2s_bd_status(device->channels[0]);
 
-	res = mcdma_s2mm_busy_wait(device);
-	if (res) {
-		HARU_ERROR("%s", "s2mm query transfer failed.");
-		return -1;
+	HARU_LOG("%s", "query transfer done.");
+	for (int i = 0; i < NUM_CHANNELS; i++) {
+		if (channel_mask & (1 << i)) {
+			mm2s_bd_status(device->channels[i]);
+			s2mm_bd_status(device->channels[i]);
+		}
 	}
-	HARU_LOG("%s", "s2mm query transfer done.");
-	s2mm_common_status(device);
-	s2mm_channel_status(device);
-	s2mm_bd_status(device->channels[0]);
 
 	return 0;
 }
 
-
 void mcdma_config_mm2s_channel(axi_mcdma_t *device, int channel_idx) {
 	// Set current descriptor
 	_reg_set(device->v_baseaddr, (AXI_MCDMA_MM2S_CHCURDESC_LSB + AXI_MCDMA_CH_OFFSET*channel_idx), device->channels[channel_idx]->mm2s_curr_bd_addr);
-	// Channel fetch bit
-	_reg_set(device->v_baseaddr, (AXI_MCDMA_MM2S_CHCR + AXI_MCDMA_CH_OFFSET*channel_idx), AXI_MCDMA_MM2S_CHRS);
+	// Channel fetch bit, plus interrupt enables when waiting on the channel's interrupt
+	uint32_t chcr = AXI_MCDMA_MM2S_CHRS;
+	if (device->channels[channel_idx]->mm2s_irq.fd >= 0) {
+		chcr |= AXI_MCDMA_CH_IOC_IRQ_EN | AXI_MCDMA_CH_ERR_IRQ_EN;
+	}
+	_reg_set(device->v_baseaddr, (AXI_MCDMA_MM2S_CHCR + AXI_MCDMA_CH_OFFSET*channel_idx), chcr);
 
 	HARU_LOG("Writing mm2s configuration to addr 0x%08x", device->p_baseaddr + AXI_MCDMA_CH_OFFSET*channel_idx);
 	HARU_LOG("reg@0x%03x : 0x%08x (current bd)", AXI_MCDMA_MM2S_CHCURDESC_LSB + AXI_MCDMA_CH_OFFSET*channel_idx, device->channels[channel_idx]->mm2s_curr_bd_addr);
-	HARU_LOG("reg@0x%03x : 0x%08x (channel %d fetch)", AXI_MCDMA_MM2S_CHCR + AXI_MCDMA_CH_OFFSET*channel_idx, AXI_MCDMA_MM2S_CHRS, channel_idx);
+	HARU_LOG("reg@0x%03x : 0x%08x (channel %d fetch)", AXI_MCDMA_MM2S_CHCR + AXI_MCDMA_CH_OFFSET*channel_idx, chcr, channel_idx);
 }
 
 void mcdma_config_s2mm_channel(axi_mcdma_t *device, int channel_idx) {
 	// Set current descriptor
 	_reg_set(device->v_baseaddr, (AXI_MCDMA_S2MM_CHCURDESC_LSB + AXI_MCDMA_CH_OFFSET*channel_idx), device->channels[channel_idx]->s2mm_curr_bd_addr);
-	// Channel fetch bit
-	_reg_set(device->v_baseaddr, (AXI_MCDMA_S2MM_CHCR + AXI_MCDMA_CH_OFFSET*channel_idx), AXI_MCDMA_S2MM_CHRS);
+	// Channel fetch bit, plus interrupt enables when waiting on the channel's interrupt
+	uint32_t chcr = AXI_MCDMA_S2MM_CHRS;
+	if (device->channels[channel_idx]->s2mm_irq.fd >= 0) {
+		chcr |= AXI_MCDMA_CH_IOC_IRQ_EN | AXI_MCDMA_CH_ERR_IRQ_EN;
+	}
+	_reg_set(device->v_baseaddr, (AXI_MCDMA_S2MM_CHCR + AXI_MCDMA_CH_OFFSET*channel_idx), chcr);
 
 	HARU_LOG("Writing s2mm configuration to addr 0x%08x", device->p_baseaddr + AXI_MCDMA_CH_OFFSET*channel_idx);
 	HARU_LOG("reg@0x%03x : 0x%08x (current bd)", AXI_MCDMA_S2MM_CHCURDESC_LSB + AXI_MCDMA_CH_OFFSET*channel_idx, device->channels[channel_idx]->s2mm_curr_bd_addr);
-	HARU_LOG("reg@0x%03x : 0x%08x (channel %d fetch)", AXI_MCDMA_S2MM_CHCR + AXI_MCDMA_CH_OFFSET*channel_idx, AXI_MCDMA_S2MM_CHRS, channel_idx);
+	HARU_LOG("reg@0x%03x : 0x%08x (channel %d fetch)", AXI_MCDMA_S2MM_CHCR + AXI_MCDMA_CH_OFFSET*channel_idx, chcr, channel_idx);
 }
 void mcdma_mm2s_start(axi_mcdma_t *device) {
 	_reg_set(device->v_baseaddr, AXI_MCDMA_MM2S_CCR, AXI_MCDMA_MM2S_RS);
@@ -619,6 +849,9 @@ void s2mm_common_status(axi_mcdma_t *device) {
 
 void mm2s_channel_status(axi_mcdma_t *device) {
 	for (int i = 0; i < NUM_CHANNELS; i ++) {
+		if (!(device->channel_en & (1 << i))) {
+			continue;
+		}
 		uint32_t ch_mm2s_status = _reg_get(device->v_baseaddr, (AXI_MCDMA_MM2S_CHSR + AXI_MCDMA_CH_OFFSET*i));
 		// HARU_STATUS("ch1_mm2s_status = 0x%08x", ch1_mm2s_status);
 		if (ch_mm2s_status & AXI_MCDMA_CH_IDLE) {
@@ -647,6 +880,9 @@ void mm2s_clear_channel_status(axi_mcdma_t *device) {
 
 void s2mm_channel_status(axi_mcdma_t *device) {
 	for (int i = 0; i < NUM_CHANNELS; i ++) {
+		if (!(device->channel_en & (1 << i))) {
+			continue;
+		}
 		uint32_t ch_s2mm_status = _reg_get(device->v_baseaddr, (AXI_MCDMA_S2MM_CHSR + AXI_MCDMA_CH_OFFSET*i));
 		// HARU_STATUS("ch1_s2mm_status = 0x%08x", ch1_mm2s_status);
 		if (ch_s2mm_status & AXI_MCDMA_CH_IDLE) {
@@ -668,7 +904,8 @@ void s2mm_channel_status(axi_mcdma_t *device) {
 }
 
 void mm2s_bd_status(axi_mcdma_channel_t *channel) {
-	uint32_t mm2s_bd_status = _reg_get(channel->mm2s_bd_chain->v_bd_addr, AXI_MCDMA_MM2S_BD_STATUS);
+	axi_mcdma_bd_t *mm2s_bd = &channel->mm2s_ring.bds[(channel->mm2s_ring.prod - 1) % AXI_MCDMA_BD_RING_SIZE];
+	uint32_t mm2s_bd_status = _reg_get(mm2s_bd->v_bd_addr, AXI_MCDMA_MM2S_BD_STATUS);
 	// HARU_STATUS("mm2s bd status = 0x%08x", mm2s_bd_status);
 	HARU_STATUS("ch%d_mm2s_bd_status: %d bytes transferred", channel->channel_id, mm2s_bd_status & AXI_MCDMA_MM2S_BD_SBYTE_MASK);
 	if (mm2s_bd_status & AXI_MCDMA_MM2S_BD_DMA_INT_ERR) {
@@ -686,7 +923,8 @@ void mm2s_bd_status(axi_mcdma_channel_t *channel) {
 }
 
 void s2mm_bd_status(axi_mcdma_channel_t *channel) {
-	uint32_t s2mm_bd_status = _reg_get(channel->s2mm_bd_chain->v_bd_addr, AXI_MCDMA_S2MM_BD_STATUS);
+	axi_mcdma_bd_t *s2mm_bd = &channel->s2mm_ring.bds[(channel->s2mm_ring.prod - 1) % AXI_MCDMA_BD_RING_SIZE];
+	uint32_t s2mm_bd_status = _reg_get(s2mm_bd->v_bd_addr, AXI_MCDMA_S2MM_BD_STATUS);
 	// HARU_STATUS("s2mm bd status = 0x%08x", S2MM_bd_status);
 	HARU_STATUS("ch%d_s2mm_bd_status: %d bytes transferred", channel->channel_id, s2mm_bd_status & AXI_MCDMA_S2MM_BD_SBYTE_MASK);
 	if (s2mm_bd_status & AXI_MCDMA_S2MM_BD_DMA_INT_ERR) {
@@ -0,0 +1,211 @@
+/* MIT License
+
+Copyright (c) 2022 Po Jui Shih
+Copyright (c) 2022 Hassaan Saadat
+Copyright (c) 2022 Sri Parameswaran
+Copyright (c) 2022 Hasindu Gamaarachchi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "dma_buf.h"
+#include "misc.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/*
+ * Init and release functions
+ */
+static int32_t dma_buf_init_devmem(dma_buf_t *buf, uint32_t p_addr, uint32_t size) {
+    int fd = open("/dev/mem", O_RDWR | O_SYNC);
+    if (fd < 0) {
+        HARU_ERROR("%s", "Failed to open /dev/mem.");
+        return -1;
+    }
+    buf->v_addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, p_addr);
+    close(fd);
+    if (buf->v_addr == MAP_FAILED) {
+        HARU_ERROR("Failed to map 0x%08x.", p_addr);
+        return -1;
+    }
+    buf->p_addr = p_addr;
+    buf->cached = 0;
+    return 0;
+}
+
+// Reads a number from a u-dma-buf sysfs attribute (phys_addr, size)
+static int32_t dma_buf_udmabuf_attr(const char *name, const char *attr, unsigned long long *value) {
+    char path[128];
+    snprintf(path, sizeof(path), DMA_BUF_UDMABUF_SYSFS "/%s/%s", name, attr);
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    int ret = fscanf(fp, "%lli", value) == 1 ? 0 : -1;
+    fclose(fp);
+    return ret;
+}
+
+static int32_t dma_buf_init_udmabuf(dma_buf_t *buf, const char *name, uint32_t size) {
+    unsigned long long phys_addr, buf_size;
+    if (dma_buf_udmabuf_attr(name, "phys_addr", &phys_addr) || dma_buf_udmabuf_attr(name, "size", &buf_size)) {
+        return -1;
+    }
+    if (buf_size < size) {
+        HARU_ERROR("%s is too small (0x%llx < 0x%08x bytes).", name, buf_size, size);
+        return -1;
+    }
+
+    // Without O_SYNC u-dma-buf maps the buffer cacheable
+    char path[64];
+    snprintf(path, sizeof(path), "/dev/%s", name);
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        HARU_ERROR("Failed to open %s.", path);
+        return -1;
+    }
+    buf->v_addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (buf->v_addr == MAP_FAILED) {
+        HARU_ERROR("Failed to map %s.", path);
+        return -1;
+    }
+    buf->p_addr = (uint32_t) phys_addr;
+    buf->cached = 1;
+    return 0;
+}
+
+static int32_t dma_buf_init_anon(dma_buf_t *buf, uint32_t p_addr, uint32_t size) {
+    buf->v_addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf->v_addr == MAP_FAILED) {
+        HARU_ERROR("%s", "Failed to map anonymous memory.");
+        return -1;
+    }
+    buf->p_addr = p_addr;
+    buf->cached = 1;
+    return 0;
+}
+
+/*
+ * Maps "size" bytes of DMA buffer with the given backend. "p_addr" is the
+ * physical address for DMA_BUF_DEVMEM (and the nominal one for DMA_BUF_ANON);
+ * u-dma-buf reports its own address. "udmabuf_name" is the u-dma-buf device
+ * (e.g. "udmabuf0") and is only used by DMA_BUF_UDMABUF and DMA_BUF_AUTO.
+ */
+int32_t dma_buf_init(dma_buf_t *buf, uint8_t backend, const char *udmabuf_name, uint32_t p_addr, uint32_t size) {
+    int32_t ret = -1;
+    buf->v_addr = NULL;
+    buf->size = size;
+
+    switch (backend) {
+    case DMA_BUF_DEVMEM:
+        ret = dma_buf_init_devmem(buf, p_addr, size);
+        break;
+    case DMA_BUF_UDMABUF:
+        ret = dma_buf_init_udmabuf(buf, udmabuf_name, size);
+        if (ret) {
+            HARU_ERROR("u-dma-buf %s is not available.", udmabuf_name);
+        }
+        break;
+    case DMA_BUF_ANON:
+        ret = dma_buf_init_anon(buf, p_addr, size);
+        break;
+    case DMA_BUF_AUTO:
+        backend = DMA_BUF_UDMABUF;
+        ret = dma_buf_init_udmabuf(buf, udmabuf_name, size);
+        if (ret) {
+            backend = DMA_BUF_DEVMEM;
+            ret = dma_buf_init_devmem(buf, p_addr, size);
+        }
+        break;
+    default:
+        HARU_ERROR("Unknown dma buffer backend %d.", backend);
+        break;
+    }
+
+    if (ret) {
+        buf->v_addr = NULL;
+        return -1;
+    }
+    buf->backend = backend;
+    HARU_LOG("dma buffer @ 0x%08x (0x%08x bytes, backend %d, %s)", buf->p_addr, buf->size, buf->backend, buf->cached ? "cached" : "uncached");
+    return 0;
+}
+
+void dma_buf_release(dma_buf_t *buf) {
+    if (buf->v_addr != NULL) {
+        munmap(buf->v_addr, buf->size);
+        buf->v_addr = NULL;
+    }
+}
+
+/*
+ * Cache maintenance. On aarch64 this is done by virtual address from user
+ * space (the kernel sets SCTLR_EL1.UCI): DC CVAC cleans a line to the point of
+ * coherency, DC CIVAC cleans and invalidates it. Both are followed by a DSB so
+ * the maintenance completes before the DMA engine is started or its data is read.
+ */
+#if defined(__aarch64__)
+static uintptr_t dma_buf_dcache_line(void) {
+    static uintptr_t line = 0;
+    if (line == 0) {
+        uint64_t ctr;
+        __asm__ volatile("mrs %0, ctr_el0" : "=r" (ctr));
+        line = (uintptr_t) 4 << ((ctr >> 16) & 0xf); // CTR_EL0.DminLine, log2 of words
+    }
+    return line;
+}
+#endif
+
+void dma_buf_sync_for_device(dma_buf_t *buf, uint32_t offset, uint32_t len) {
+    if (!buf->cached || len == 0) {
+        return;
+    }
+#if defined(__aarch64__)
+    uintptr_t line = dma_buf_dcache_line();
+    uintptr_t addr = ((uintptr_t) buf->v_addr + offset) & ~(line - 1);
+    uintptr_t end = (uintptr_t) buf->v_addr + offset + len;
+    for (; addr < end; addr += line) {
+        __asm__ volatile("dc cvac, %0" : : "r" (addr) : "memory");
+    }
+    __asm__ volatile("dsb sy" : : : "memory");
+#else
+    __sync_synchronize();
+#endif
+}
+
+void dma_buf_sync_for_cpu(dma_buf_t *buf, uint32_t offset, uint32_t len) {
+    if (!buf->cached || len == 0) {
+        return;
+    }
+#if defined(__aarch64__)
+    uintptr_t line = dma_buf_dcache_line();
+    uintptr_t addr = ((uintptr_t) buf->v_addr + offset) & ~(line - 1);
+    uintptr_t end = (uintptr_t) buf->v_addr + offset + len;
+    for (; addr < end; addr += line) {
+        __asm__ volatile("dc civac, %0" : : "r" (addr) : "memory");
+    }
+    __asm__ volatile("dsb sy" : : : "memory");
+#else
+    __sync_synchronize();
+#endif
+}
@@ -87,6 +87,134 @@ void dtw_accel_set_ref_len(dtw_accel_t *device, uint32_t len) {
     _reg_set(device->v_baseaddr, DTW_ACCEL_REF_LEN_ADDR, len);
 }
 
+static int dtw_accel_has_version(dtw_accel_t *device, uint32_t major, uint32_t minor) {
+    uint32_t version = dtw_accel_get_version(device);
+    return DTW_ACCEL_VERSION_MAJOR(version) > major ||
+           (DTW_ACCEL_VERSION_MAJOR(version) == major && DTW_ACCEL_VERSION_MINOR(version) >= minor);
+}
+
+// The number of cores register was added in version 1.1; earlier designs only
+// ever used a single core.
+static int dtw_accel_has_num_accel(dtw_accel_t *device) {
+    return dtw_accel_has_version(device, 1, 1);
+}
+
+// The band register was added in version 1.2; earlier designs are always unconstrained.
+static int dtw_accel_has_band(dtw_accel_t *device) {
+    return dtw_accel_has_version(device, 1, 2);
+}
+
+// The hits register was added in version 1.3; earlier designs send one hit.
+static int dtw_accel_has_hits(dtw_accel_t *device) {
+    return dtw_accel_has_version(device, 1, 3);
+}
+
+// The strand register was added in version 1.4; earlier designs search one strand.
+static int dtw_accel_has_strand(dtw_accel_t *device) {
+    return dtw_accel_has_version(device, 1, 4);
+}
+
+// The query length register was added in version 1.6; earlier designs take
+// DTW_ACCEL_QLEN_MAX samples.
+static int dtw_accel_has_qlen(dtw_accel_t *device) {
+    return dtw_accel_has_version(device, 1, 6);
+}
+
+// The early accept register was added in version 1.7; earlier designs always
+// sweep the whole reference.
+static int dtw_accel_has_thresh(dtw_accel_t *device) {
+    return dtw_accel_has_version(device, 1, 7);
+}
+
+// The reference size register was added in version 1.8; earlier designs have
+// DTW_ACCEL_REF_SIZE_DEFAULT words.
+static int dtw_accel_has_ref_size(dtw_accel_t *device) {
+    return dtw_accel_has_version(device, 1, 8);
+}
+
+// The cohort register was added in version 1.9; earlier designs run their cores
+// independently.
+static int dtw_accel_has_cohort(dtw_accel_t *device) {
+    return dtw_accel_has_version(device, 1, 9);
+}
+
+// Sakoe-Chiba band of every core, 0 for unconstrained. Returns -1 if the band is
+// wider than DTW_ACCEL_BAND_MAX, or if it is not 0 and the design has no band.
+int32_t dtw_accel_set_band(dtw_accel_t *device, uint32_t band) {
+    if (band > DTW_ACCEL_BAND_MAX) {
+        return -1;
+    }
+    if (!dtw_accel_has_band(device)) {
+        return (band == 0) ? 0 : -1;
+    }
+    _reg_set(device->v_baseaddr, DTW_ACCEL_BAND_ADDR, band);
+    return 0;
+}
+
+// Hits per result packet of every core. Returns -1 if hits is 0 or more than
+// DTW_ACCEL_HITS_MAX, or if the design keeps fewer hits.
+int32_t dtw_accel_set_hits(dtw_accel_t *device, uint32_t hits) {
+    if (hits == 0 || hits > DTW_ACCEL_HITS_MAX) {
+        return -1;
+    }
+    if (!dtw_accel_has_hits(device)) {
+        return (hits == 1) ? 0 : -1;
+    }
+    // The register saturates at the HITS_MAX the design was built with
+    _reg_set(device->v_baseaddr, DTW_ACCEL_HITS_ADDR, hits);
+    return (_reg_get(device->v_baseaddr, DTW_ACCEL_HITS_ADDR) == hits) ? 0 : -1;
+}
+
+// First reference word of the second strand, 0 for a single strand. The cores
+// restart the alignment at that column. Returns -1 if strand is not 0 and the
+// design has a single strand.
+int32_t dtw_accel_set_strand(dtw_accel_t *device, uint32_t strand) {
+    if (!dtw_accel_has_strand(device)) {
+        return (strand == 0) ? 0 : -1;
+    }
+    _reg_set(device->v_baseaddr, DTW_ACCEL_STRAND_ADDR, strand);
+    return 0;
+}
+
+// Samples per query of every core. Returns -1 if qlen is 0 or more than
+// DTW_ACCEL_QLEN_MAX, or if the design has fewer PEs per core.
+int32_t dtw_accel_set_qlen(dtw_accel_t *device, uint32_t qlen) {
+    if (qlen == 0 || qlen > DTW_ACCEL_QLEN_MAX) {
+        return -1;
+    }
+    if (!dtw_accel_has_qlen(device)) {
+        return (qlen == DTW_ACCEL_QLEN_MAX) ? 0 : -1;
+    }
+    // The register saturates at the SQG_SIZE the design was built with
+    _reg_set(device->v_baseaddr, DTW_ACCEL_QLEN_ADDR, qlen);
+    return (_reg_get(device->v_baseaddr, DTW_ACCEL_QLEN_ADDR) == qlen) ? 0 : -1;
+}
+
+// Early accept score of every core, 0 for off: a core sends the first hit
+// scoring below it and skips the rest of the reference. Returns -1 if thresh
+// is more than DTW_ACCEL_THRESH_MAX, or if it is not 0 and the design has no
+// early accept.
+int32_t dtw_accel_set_thresh(dtw_accel_t *device, uint32_t thresh) {
+    if (thresh > DTW_ACCEL_THRESH_MAX) {
+        return -1;
+    }
+    if (!dtw_accel_has_thresh(device)) {
+        return (thresh == 0) ? 0 : -1;
+    }
+    _reg_set(device->v_baseaddr, DTW_ACCEL_THRESH_ADDR, thresh);
+    return 0;
+}
+
+// Cycles a cohort waits for the other cores' queries once one core has a full
+// query, 0 is taken as 1. Returns -1 if the cores do not run in cohorts.
+int32_t dtw_accel_set_cohort(dtw_accel_t *device, uint32_t cycles) {
+    if (dtw_accel_get_cohort(device) == 0) {
+        return -1;
+    }
+    _reg_set(device->v_baseaddr, DTW_ACCEL_COHORT_ADDR, cycles);
+    return 0;
+}
+
 /*
  * Register getter functions
  */
@@ -110,6 +238,67 @@ uint32_t dtw_accel_get_key(dtw_accel_t *device) {
     return _reg_get(device->v_baseaddr, DTW_ACCEL_KEY_ADDR);
 }
 
+// Number of DTW cores, one per MCDMA channel (tdest)
+uint32_t dtw_accel_get_num_accel(dtw_accel_t *device) {
+    if (!dtw_accel_has_num_accel(device)) {
+        return 1;
+    }
+
+    uint32_t num_accel = _reg_get(device->v_baseaddr, DTW_ACCEL_NUM_ACCEL_ADDR);
+    return num_accel ? num_accel : 1;
+}
+
+uint32_t dtw_accel_get_band(dtw_accel_t *device) {
+    if (!dtw_accel_has_band(device)) {
+        return 0;
+    }
+    return _reg_get(device->v_baseaddr, DTW_ACCEL_BAND_ADDR);
+}
+
+uint32_t dtw_accel_get_hits(dtw_accel_t *device) {
+    if (!dtw_accel_has_hits(device)) {
+        return 1;
+    }
+    return _reg_get(device->v_baseaddr, DTW_ACCEL_HITS_ADDR);
+}
+
+uint32_t dtw_accel_get_strand(dtw_accel_t *device) {
+    if (!dtw_accel_has_strand(device)) {
+        return 0;
+    }
+    return _reg_get(device->v_baseaddr, DTW_ACCEL_STRAND_ADDR);
+}
+
+uint32_t dtw_accel_get_qlen(dtw_accel_t *device) {
+    if (!dtw_accel_has_qlen(device)) {
+        return DTW_ACCEL_QLEN_MAX;
+    }
+    return _reg_get(device->v_baseaddr, DTW_ACCEL_QLEN_ADDR);
+}
+
+uint32_t dtw_accel_get_thresh(dtw_accel_t *device) {
+    if (!dtw_accel_has_thresh(device)) {
+        return 0;
+    }
+    return _reg_get(device->v_baseaddr, DTW_ACCEL_THRESH_ADDR);
+}
+
+// Words of the reference memory, the longest reference the cores can hold
+uint32_t dtw_accel_get_ref_size(dtw_accel_t *device) {
+    if (!dtw_accel_has_ref_size(device)) {
+        return DTW_ACCEL_REF_SIZE_DEFAULT;
+    }
+    return _reg_get(device->v_baseaddr, DTW_ACCEL_REF_SIZE_ADDR);
+}
+
+// Cohort wait in cycles, 0 if the cores run independently
+uint32_t dtw_accel_get_cohort(dtw_accel_t *device) {
+    if (!dtw_accel_has_cohort(device)) {
+        return 0;
+    }
+    return _reg_get(device->v_baseaddr, DTW_ACCEL_COHORT_ADDR);
+}
+
 /*
  * Bit getter functions
  */
@@ -0,0 +1,1077 @@
+/* MIT License
+
+Copyright (c) 2022 Po Jui Shih
+Copyright (c) 2022 Hassaan Saadat
+Copyright (c) 2022 Sri Parameswaran
+Copyright (c) 2022 Hasindu Gamaarachchi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "dtw_sw.h"
+#include "misc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DTW_SW_HAVE_AVX2
+#endif
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define DTW_SW_HAVE_NEON
+#endif
+
+// Columns of the widest reference, ref_len + 2, plus the padding on either side
+#define DTW_SW_COLS_WORDS   (DTW_SW_REF_MEM_SIZE + 2 + 2 * DTW_SW_COLS_PAD)
+
+// Diagonal buffers: word 0 is the row above the first PE, followed by the PEs and the
+// rows written by the lanes of the last vector that run past DTW_SW_SQG_SIZE
+#define DTW_SW_DIAG_WORDS   (1 + DTW_SW_SQG_SIZE + DTW_SW_LANES_MAX)
+
+/*
+ * Init and release functions
+ */
+int32_t dtw_sw_init(dtw_sw_t *sw) {
+    // Freshly configured block RAM reads 0
+    sw->mem = (uint16_t *) calloc(DTW_SW_REF_MEM_SIZE, sizeof(uint16_t));
+    sw->cols[0] = (uint16_t *) calloc(DTW_SW_COLS_WORDS, sizeof(uint16_t));
+    sw->cols[1] = (uint16_t *) calloc(DTW_SW_COLS_WORDS, sizeof(uint16_t));
+    HARU_MALLOC_CHK(sw->mem);
+    HARU_MALLOC_CHK(sw->cols[0]);
+    HARU_MALLOC_CHK(sw->cols[1]);
+    if (sw->mem == NULL || sw->cols[0] == NULL || sw->cols[1] == NULL) {
+        dtw_sw_release(sw);
+        return -1;
+    }
+    sw->ref_size = DTW_SW_REF_MEM_SIZE;
+    sw->ref_len = 0;
+    sw->isa = dtw_sw_detect_isa();
+    sw->band = 0;
+    sw->strand = 0;
+    sw->qlen = DTW_SW_SQG_SIZE;
+    sw->thresh = 0;
+    return 0;
+}
+
+void dtw_sw_release(dtw_sw_t *sw) {
+    free(sw->mem);
+    free(sw->cols[0]);
+    free(sw->cols[1]);
+    sw->mem = NULL;
+    sw->cols[0] = NULL;
+    sw->cols[1] = NULL;
+}
+
+/*
+ * Kernel selection
+ */
+uint8_t dtw_sw_detect_isa(void) {
+#if defined(DTW_SW_HAVE_NEON)
+    if (getauxval(AT_HWCAP) & HWCAP_ASIMD) {
+        return DTW_SW_ISA_NEON;
+    }
+#endif
+#if defined(DTW_SW_HAVE_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return DTW_SW_ISA_AVX2;
+    }
+#endif
+    return DTW_SW_ISA_SCALAR;
+}
+
+/*
+ * Forces a kernel, e.g. DTW_SW_ISA_SCALAR for comparisons. Returns -1 if the
+ * kernel is not built for or not supported by this CPU.
+ */
+int32_t dtw_sw_set_isa(dtw_sw_t *sw, uint8_t isa) {
+    if (isa != DTW_SW_ISA_SCALAR && isa != dtw_sw_detect_isa()) {
+        HARU_ERROR("Kernel %d is not supported on this CPU.", isa);
+        return -1;
+    }
+    sw->isa = isa;
+    return 0;
+}
+
+/*
+ * Sets the band like REG_BAND, 0 for unconstrained. Returns -1 if the band
+ * does not fit the register.
+ */
+int32_t dtw_sw_set_band(dtw_sw_t *sw, uint32_t band) {
+    if (band > DTW_SW_BAND_MAX) {
+        HARU_ERROR("Band %d exceeds the widest band (%d).", band, DTW_SW_BAND_MAX);
+        return -1;
+    }
+    sw->band = (uint16_t) band;
+    return 0;
+}
+
+/*
+ * Samples per query (REG_QLEN), 1 to DTW_SW_SQG_SIZE. Queries are then
+ * dtw_sw_query_words(sw) words long, and a hit candidate stays open for qlen
+ * columns.
+ */
+int32_t dtw_sw_set_query_len(dtw_sw_t *sw, uint32_t qlen) {
+    if (qlen == 0 || qlen > DTW_SW_SQG_SIZE) {
+        HARU_ERROR("Query of %d samples, the core takes 1 to %d.", qlen, DTW_SW_SQG_SIZE);
+        return -1;
+    }
+    sw->qlen = (uint16_t) qlen;
+    return 0;
+}
+
+/*
+ * Early accept score (REG_THRESH), 0 for off. A query stops at the first
+ * column whose last row value is below it and reports that column. Returns -1
+ * if the score does not fit the 16 bit PEs.
+ */
+int32_t dtw_sw_set_thresh(dtw_sw_t *sw, uint32_t thresh) {
+    if (thresh > DTW_SW_MAX_VALUE) {
+        HARU_ERROR("Early accept score %d exceeds the PE range (%d).", thresh, DTW_SW_MAX_VALUE);
+        return -1;
+    }
+    sw->thresh = (uint16_t) thresh;
+    return 0;
+}
+
+/*
+ * Words of the reference memory (REG_REF_SIZE, see dtw_accel_get_ref_size), a
+ * power of two up to DTW_SW_REF_MEM_SIZE. Column addresses wrap at it like the
+ * cores' read pointers, and longer references do not load. Returns -1 if the
+ * size is not one the design can have, or a reference is already loaded.
+ */
+int32_t dtw_sw_set_ref_size(dtw_sw_t *sw, uint32_t size) {
+    if (size == 0 || size > DTW_SW_REF_MEM_SIZE || (size & (size - 1)) != 0) {
+        HARU_ERROR("Reference memory of %d words, the model takes powers of two up to %d.", size, DTW_SW_REF_MEM_SIZE);
+        return -1;
+    }
+    if (sw->ref_len != 0) {
+        HARU_ERROR("%s", "Reference memory size set after the reference was loaded.");
+        return -1;
+    }
+    sw->ref_size = size;
+    return 0;
+}
+
+/*
+ * Reference loading (dtw_core_ref.sv). The write address is one step ahead of
+ * the sample it writes, so sample i lands in word i and sample 0 is dropped.
+ * Only the low 16 bits of each sample are stored.
+ */
+int32_t dtw_sw_load_reference(dtw_sw_t *sw, const int32_t *ref, uint32_t size) {
+    return dtw_sw_load_reference_strands(sw, ref, size, NULL, 0);
+}
+
+/*
+ * Loads the forward strand fwd and the reverse complement rev back to back, like
+ * haru_load_reference_strands: the strand register points at the first word of
+ * rev. Without rev it is a plain reference. Returns -1 if the strands do not fit
+ * the reference memory or rev comes without fwd.
+ */
+int32_t dtw_sw_load_reference_strands(dtw_sw_t *sw, const int32_t *fwd, uint32_t fwd_size, const int32_t *rev, uint32_t rev_size) {
+    uint32_t size = fwd_size + rev_size;
+    if (fwd_size > sw->ref_size || rev_size > sw->ref_size - fwd_size) {
+        HARU_ERROR("Reference of %d samples exceeds the reference memory (%d samples).", size, sw->ref_size);
+        return -1;
+    }
+    if (rev_size > 0 && fwd_size == 0) {
+        HARU_ERROR("%s", "Second strand without a first one.");
+        return -1;
+    }
+    for (uint32_t i = 1; i < size; i++) {
+        sw->mem[i] = (uint16_t) ((i < fwd_size) ? fwd[i] : rev[i - fwd_size]);
+    }
+    sw->ref_len = size;
+    sw->strand = (rev_size > 0) ? fwd_size : 0;
+
+    // Column j of core "core" sits at cols[core & 1][DTW_SW_COLS_PAD + ref_len + 1 - j]
+    uint32_t n_cols = size + 2;
+    for (uint32_t lag = 0; lag < 2; lag++) {
+        uint16_t *cols = sw->cols[lag];
+        memset(cols, 0, DTW_SW_COLS_WORDS * sizeof(uint16_t));
+        for (uint32_t j = 0; j < n_cols; j++) {
+            uint32_t addr = (j >= lag) ? j - lag : 0;
+            cols[DTW_SW_COLS_PAD + n_cols - 1 - j] = sw->mem[addr & (sw->ref_size - 1)];
+        }
+    }
+    return 0;
+}
+
+/*
+ * Hit list
+ */
+static void dtw_sw_hits_init(dtw_sw_hits_t *list, uint32_t span) {
+    list->span = span;
+    list->cand_score = DTW_SW_MAX_VALUE;
+    list->cand_pos = 0;
+    for (int i = 0; i < DTW_ACCEL_HITS_MAX; i++) {
+        list->hits[i].position = 0;
+        list->hits[i].score = DTW_SW_MAX_VALUE;
+    }
+}
+
+// Inserts the candidate after every hit that scores at most as much, the last hit drops out
+static void dtw_sw_hits_insert(dtw_sw_hits_t *list) {
+    int i = DTW_ACCEL_HITS_MAX;
+    while (i > 0 && list->hits[i - 1].score > list->cand_score) {
+        if (i < DTW_ACCEL_HITS_MAX) {
+            list->hits[i] = list->hits[i - 1];
+        }
+        i--;
+    }
+    if (i < DTW_ACCEL_HITS_MAX) {
+        list->hits[i].position = list->cand_pos;
+        list->hits[i].score = list->cand_score;
+    }
+}
+
+// Last row value v of column pos - 1
+static inline void dtw_sw_hits_update(dtw_sw_hits_t *list, uint32_t pos, uint16_t v) {
+    if (pos - list->cand_pos >= list->span) {
+        dtw_sw_hits_insert(list);
+        list->cand_score = v;
+        list->cand_pos = pos;
+    } else if (v < list->cand_score) {
+        list->cand_score = v;
+        list->cand_pos = pos;
+    }
+}
+
+/*
+ * Query processing
+ */
+// Scalar column sweep, the reference for the vectorized kernels. hits may be NULL.
+static void dtw_sw_scalar(const dtw_sw_t *sw, uint32_t core, const int32_t *query, uint16_t *minval_out, uint32_t *minpos_out,
+                          dtw_sw_hits_t *hits) {
+    uint32_t rows = sw->qlen;
+    uint16_t squiggle[DTW_SW_SQG_SIZE];
+    uint16_t column[DTW_SW_SQG_SIZE];       // DTW_prev, the previous column of every row
+    int16_t offset[DTW_SW_SQG_SIZE];        // Off_prev, reset to 0
+    for (uint32_t m = 0; m < rows; m++) {
+        squiggle[m] = (uint16_t) query[m + 2];
+        column[m] = DTW_SW_MAX_VALUE;
+        offset[m] = 0;
+    }
+
+    // Port a (even cores) reads one cycle later than port b, the address starts at 0 either way
+    uint32_t lag = (core & 1) ? 0 : 1;
+    uint32_t strand_col = dtw_sw_strand_col(sw, core);
+    uint16_t minval = DTW_SW_MAX_VALUE;
+    uint32_t minpos = 0;
+
+    for (uint32_t j = 0; j < sw->ref_len + 2; j++) {
+        uint32_t addr = (j >= lag) ? j - lag : 0;
+        uint16_t y = sw->mem[addr & (sw->ref_size - 1)];
+
+        // Second strand: no column before its first one, like column 0
+        if (strand_col != 0 && j == strand_col) {
+            for (uint32_t m = 0; m < rows; m++) {
+                column[m] = DTW_SW_MAX_VALUE;
+                offset[m] = 0;
+            }
+        }
+
+        // First row: N = NW = 0, N_off = 1 and NW_off = 0 so a path starts at offset 0
+        uint16_t n = 0;
+        uint16_t nw = 0;
+        if (sw->band == 0) {
+            for (uint32_t m = 0; m < rows; m++) {
+                uint16_t w = column[m];
+                uint16_t d = dtw_sw_pe(squiggle[m], y, n, w, nw);
+                column[m] = d;
+                nw = w;
+                n = d;
+            }
+        } else {
+            int16_t n_off = 1;
+            int16_t nw_off = 0;
+            for (uint32_t m = 0; m < rows; m++) {
+                uint16_t w = column[m];
+                int16_t w_off = offset[m];
+                uint16_t d = dtw_sw_pe_band(squiggle[m], y, n, w, nw, n_off, w_off, nw_off, sw->band, &offset[m]);
+                column[m] = d;
+                nw = w;
+                nw_off = w_off;
+                n = d;
+                n_off = offset[m];
+            }
+        }
+
+        if (column[rows - 1] < minval) {
+            minval = column[rows - 1];
+            // The position word leaves the core before the last column is compared
+            if (j <= sw->ref_len) {
+                minpos = j + 1;
+            }
+        }
+        if (hits != NULL && j <= sw->ref_len) {
+            dtw_sw_hits_update(hits, j + 1, column[rows - 1]);
+        }
+        // Early accept: the core stops at the first column under the threshold
+        if (j <= sw->ref_len && column[rows - 1] < sw->thresh) {
+            break;
+        }
+    }
+
+    *minval_out = minval;
+    *minpos_out = minpos;
+}
+
+/*
+ * Computes rows [lo, hi) of anti-diagonal d (row m at column d - m) into cur.
+ * The row pointers address PE 0, so p1[m - 1] is N and p1[m] is W on the
+ * previous diagonal and p2[m - 1] is NW. y[m] is the reference sample of row m.
+ * Rows below d have no column yet and stay at MAX, which is W and NW of their
+ * first cell. hi may be rounded up to a whole vector.
+ */
+typedef void (*dtw_sw_diag_fn)(uint16_t *cur, const uint16_t *p1, const uint16_t *p2,
+                               const uint16_t *x, const uint16_t *y, uint32_t lo, uint32_t hi, uint32_t d);
+
+/*
+ * Banded diagonal: as above, with the warp offsets of the cells in ocur and of
+ * the previous two diagonals in o1 and o2, addressed like the values. Rows
+ * below d get offset 0, the reset value of Off_prev.
+ */
+typedef void (*dtw_sw_diag_band_fn)(uint16_t *cur, const uint16_t *p1, const uint16_t *p2,
+                                    int16_t *ocur, const int16_t *o1, const int16_t *o2,
+                                    const uint16_t *x, const uint16_t *y, uint32_t lo, uint32_t hi, uint32_t d,
+                                    uint16_t band);
+
+#if defined(DTW_SW_HAVE_AVX2)
+#define DTW_SW_AVX2_LANES   16
+
+__attribute__((target("avx2")))
+static void dtw_sw_diag_avx2(uint16_t *cur, const uint16_t *p1, const uint16_t *p2,
+                             const uint16_t *x, const uint16_t *y, uint32_t lo, uint32_t hi, uint32_t d) {
+    const __m256i lane = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    for (uint32_t m = lo; m < hi; m += DTW_SW_AVX2_LANES) {
+        __m256i xv = _mm256_loadu_si256((const __m256i *) (x + m));
+        __m256i yv = _mm256_loadu_si256((const __m256i *) (y + m));
+        __m256i n = _mm256_loadu_si256((const __m256i *) (p1 + m - 1));
+        __m256i w = _mm256_loadu_si256((const __m256i *) (p1 + m));
+        __m256i nw = _mm256_loadu_si256((const __m256i *) (p2 + m - 1));
+
+        // |x - y| of the wrapped difference, 0x8000 stays 0x8000 like the PE
+        __m256i cost = _mm256_abs_epi16(_mm256_sub_epi16(xv, yv));
+        __m256i min3 = _mm256_min_epu16(_mm256_min_epu16(n, w), nw);
+        __m256i dv = _mm256_adds_epu16(cost, min3);
+        if (d < DTW_SW_SQG_SIZE) {
+            __m256i row = _mm256_add_epi16(_mm256_set1_epi16((int16_t) m), lane);
+            dv = _mm256_or_si256(dv, _mm256_cmpgt_epi16(row, _mm256_set1_epi16((int16_t) d)));
+        }
+        _mm256_storeu_si256((__m256i *) (cur + m), dv);
+    }
+}
+
+__attribute__((target("avx2")))
+static void dtw_sw_diag_band_avx2(uint16_t *cur, const uint16_t *p1, const uint16_t *p2,
+                                  int16_t *ocur, const int16_t *o1, const int16_t *o2,
+                                  const uint16_t *x, const uint16_t *y, uint32_t lo, uint32_t hi, uint32_t d,
+                                  uint16_t band) {
+    const __m256i lane = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i off_max = _mm256_set1_epi16(DTW_SW_OFF_MAX);
+    const __m256i off_min = _mm256_set1_epi16(-DTW_SW_OFF_MAX);
+    const __m256i bandv = _mm256_set1_epi16((int16_t) band);
+    for (uint32_t m = lo; m < hi; m += DTW_SW_AVX2_LANES) {
+        __m256i xv = _mm256_loadu_si256((const __m256i *) (x + m));
+        __m256i yv = _mm256_loadu_si256((const __m256i *) (y + m));
+        __m256i n = _mm256_loadu_si256((const __m256i *) (p1 + m - 1));
+        __m256i w = _mm256_loadu_si256((const __m256i *) (p1 + m));
+        __m256i nw = _mm256_loadu_si256((const __m256i *) (p2 + m - 1));
+        __m256i n_off = _mm256_loadu_si256((const __m256i *) (o1 + m - 1));
+        __m256i w_off = _mm256_loadu_si256((const __m256i *) (o1 + m));
+        __m256i nw_off = _mm256_loadu_si256((const __m256i *) (o2 + m - 1));
+
+        __m256i cost = _mm256_abs_epi16(_mm256_sub_epi16(xv, yv));
+        __m256i min2 = _mm256_min_epu16(n, w);
+        __m256i min3 = _mm256_min_epu16(min2, nw);
+        __m256i dv = _mm256_adds_epu16(cost, min3);
+
+        // Ties go the PE's way: N over W, then min2 over NW
+        __m256i n_taken = _mm256_cmpeq_epi16(min2, n);
+        __m256i min2_taken = _mm256_cmpeq_epi16(min3, min2);
+        __m256i off = _mm256_blendv_epi8(_mm256_add_epi16(w_off, one), _mm256_sub_epi16(n_off, one), n_taken);
+        off = _mm256_blendv_epi8(nw_off, off, min2_taken);
+        off = _mm256_min_epi16(_mm256_max_epi16(off, off_min), off_max);
+        dv = _mm256_or_si256(dv, _mm256_cmpgt_epi16(_mm256_abs_epi16(off), bandv));
+        if (d < DTW_SW_SQG_SIZE) {
+            __m256i row = _mm256_add_epi16(_mm256_set1_epi16((int16_t) m), lane);
+            __m256i gt = _mm256_cmpgt_epi16(row, _mm256_set1_epi16((int16_t) d));
+            dv = _mm256_or_si256(dv, gt);
+            off = _mm256_andnot_si256(gt, off);
+        }
+        _mm256_storeu_si256((__m256i *) (cur + m), dv);
+        _mm256_storeu_si256((__m256i *) (ocur + m), off);
+    }
+}
+#endif
+
+#if defined(DTW_SW_HAVE_NEON)
+#define DTW_SW_NEON_LANES   8
+
+static void dtw_sw_diag_neon(uint16_t *cur, const uint16_t *p1, const uint16_t *p2,
+                             const uint16_t *x, const uint16_t *y, uint32_t lo, uint32_t hi, uint32_t d) {
+    static const uint16_t lane_init[DTW_SW_NEON_LANES] = {0, 1, 2, 3, 4, 5, 6, 7};
+    const uint16x8_t lane = vld1q_u16(lane_init);
+    for (uint32_t m = lo; m < hi; m += DTW_SW_NEON_LANES) {
+        uint16x8_t xv = vld1q_u16(x + m);
+        uint16x8_t yv = vld1q_u16(y + m);
+        uint16x8_t n = vld1q_u16(p1 + m - 1);
+        uint16x8_t w = vld1q_u16(p1 + m);
+        uint16x8_t nw = vld1q_u16(p2 + m - 1);
+
+        // |x - y| of the wrapped difference, 0x8000 stays 0x8000 like the PE
+        uint16x8_t cost = vreinterpretq_u16_s16(vabsq_s16(vreinterpretq_s16_u16(vsubq_u16(xv, yv))));
+        uint16x8_t min3 = vminq_u16(vminq_u16(n, w), nw);
+        uint16x8_t dv = vqaddq_u16(cost, min3);
+        if (d < DTW_SW_SQG_SIZE) {
+            uint16x8_t row = vaddq_u16(vdupq_n_u16((uint16_t) m), lane);
+            dv = vorrq_u16(dv, vcgtq_u16(row, vdupq_n_u16((uint16_t) d)));
+        }
+        vst1q_u16(cur + m, dv);
+    }
+}
+
+static void dtw_sw_diag_band_neon(uint16_t *cur, const uint16_t *p1, const uint16_t *p2,
+                                  int16_t *ocur, const int16_t *o1, const int16_t *o2,
+                                  const uint16_t *x, const uint16_t *y, uint32_t lo, uint32_t hi, uint32_t d,
+                                  uint16_t band) {
+    static const uint16_t lane_init[DTW_SW_NEON_LANES] = {0, 1, 2, 3, 4, 5, 6, 7};
+    const uint16x8_t lane = vld1q_u16(lane_init);
+    const int16x8_t one = vdupq_n_s16(1);
+    const int16x8_t off_max = vdupq_n_s16(DTW_SW_OFF_MAX);
+    const int16x8_t off_min = vdupq_n_s16(-DTW_SW_OFF_MAX);
+    const int16x8_t bandv = vdupq_n_s16((int16_t) band);
+    for (uint32_t m = lo; m < hi; m += DTW_SW_NEON_LANES) {
+        uint16x8_t xv = vld1q_u16(x + m);
+        uint16x8_t yv = vld1q_u16(y + m);
+        uint16x8_t n = vld1q_u16(p1 + m - 1);
+        uint16x8_t w = vld1q_u16(p1 + m);
+        uint16x8_t nw = vld1q_u16(p2 + m - 1);
+        int16x8_t n_off = vld1q_s16(o1 + m - 1);
+        int16x8_t w_off = vld1q_s16(o1 + m);
+        int16x8_t nw_off = vld1q_s16(o2 + m - 1);
+
+        uint16x8_t cost = vreinterpretq_u16_s16(vabsq_s16(vreinterpretq_s16_u16(vsubq_u16(xv, yv))));
+        uint16x8_t min2 = vminq_u16(n, w);
+        uint16x8_t min3 = vminq_u16(min2, nw);
+        uint16x8_t dv = vqaddq_u16(cost, min3);
+
+        // Ties go the PE's way: N over W, then min2 over NW
+        int16x8_t off = vbslq_s16(vcgtq_u16(n, w), vaddq_s16(w_off, one), vsubq_s16(n_off, one));
+        off = vbslq_s16(vcgtq_u16(min2, nw), nw_off, off);
+        off = vminq_s16(vmaxq_s16(off, off_min), off_max);
+        dv = vorrq_u16(dv, vcgtq_s16(vabsq_s16(off), bandv));
+        if (d < DTW_SW_SQG_SIZE) {
+            uint16x8_t row = vaddq_u16(vdupq_n_u16((uint16_t) m), lane);
+            uint16x8_t gt = vcgtq_u16(row, vdupq_n_u16((uint16_t) d));
+            dv = vorrq_u16(dv, gt);
+            off = vbicq_s16(off, vreinterpretq_s16_u16(gt));
+        }
+        vst1q_u16(cur + m, dv);
+        vst1q_s16(ocur + m, off);
+    }
+}
+#endif
+
+// Scalar diagonal, so sweeps also run without a vector kernel
+static void dtw_sw_diag_scalar(uint16_t *cur, const uint16_t *p1, const uint16_t *p2,
+                               const uint16_t *x, const uint16_t *y, uint32_t lo, uint32_t hi, uint32_t d) {
+    const uint16_t *n = p1 - 1;
+    const uint16_t *nw = p2 - 1;
+    for (uint32_t m = lo; m < hi; m++) {
+        cur[m] = (m > d) ? (uint16_t) DTW_SW_MAX_VALUE : dtw_sw_pe(x[m], y[m], n[m], p1[m], nw[m]);
+    }
+}
+
+static void dtw_sw_diag_band_scalar(uint16_t *cur, const uint16_t *p1, const uint16_t *p2,
+                                    int16_t *ocur, const int16_t *o1, const int16_t *o2,
+                                    const uint16_t *x, const uint16_t *y, uint32_t lo, uint32_t hi, uint32_t d,
+                                    uint16_t band) {
+    const uint16_t *n = p1 - 1;
+    const uint16_t *nw = p2 - 1;
+    const int16_t *n_off = o1 - 1;
+    const int16_t *nw_off = o2 - 1;
+    for (uint32_t m = lo; m < hi; m++) {
+        if (m > d) {
+            cur[m] = DTW_SW_MAX_VALUE;
+            ocur[m] = 0;
+        } else {
+            cur[m] = dtw_sw_pe_band(x[m], y[m], n[m], p1[m], nw[m], n_off[m], o1[m], nw_off[m], band, &ocur[m]);
+        }
+    }
+}
+
+/*
+ * Recomputes row m of a diagonal, which lies on the first column of the second
+ * strand, with W = NW = MAX and offsets 0 like the PEs see them there. Its N
+ * is on the previous diagonal, so the kernels can run unchanged. A row the
+ * kernel did not compute stays MAX: its N was already dead.
+ */
+static inline void dtw_sw_sweep_restart(uint16_t *cur, const uint16_t *p1, int16_t *ocur, const int16_t *o1,
+                                        const uint16_t *x, const uint16_t *y, uint32_t lo, uint32_t hi, uint32_t m,
+                                        uint16_t band) {
+    if (m < lo || m >= hi || m >= DTW_SW_SQG_SIZE) {
+        return;
+    }
+    // Row 0 keeps the first row's N = NW = 0, N_off = 1
+    const uint16_t *n = p1 - 1;
+    const int16_t *n_off = o1 - 1;
+    uint16_t nw = (m > 0) ? (uint16_t) DTW_SW_MAX_VALUE : 0;
+    if (band != 0) {
+        cur[m] = dtw_sw_pe_band(x[m], y[m], n[m], DTW_SW_MAX_VALUE, nw, n_off[m], 0, 0, band, &ocur[m]);
+    } else {
+        cur[m] = dtw_sw_pe(x[m], y[m], n[m], DTW_SW_MAX_VALUE, nw);
+    }
+}
+
+/*
+ * Anti-diagonal sweep over columns [first, first + n_cols). Diagonal d holds
+ * row m at column first + d - m, and only depends on diagonals d - 1 and
+ * d - 2, so all its rows are independent. The last row reaches column
+ * first + j on diagonal j + qlen - 1, so the minima are still
+ * tracked in column order. A boundary column enters as the W/NW values of
+ * the first column: cell (m, -1) is written on diagonal m - 1.
+ */
+void dtw_sw_sweep(const dtw_sw_t *sw, uint32_t core, const uint16_t *squiggle, dtw_sw_sweep_t *sweep) {
+    dtw_sw_diag_fn diag = dtw_sw_diag_scalar;
+    dtw_sw_diag_band_fn diag_band = dtw_sw_diag_band_scalar;
+    uint32_t lanes = 1;
+    switch (sw->isa) {
+#if defined(DTW_SW_HAVE_AVX2)
+    case DTW_SW_ISA_AVX2:
+        diag = dtw_sw_diag_avx2;
+        diag_band = dtw_sw_diag_band_avx2;
+        lanes = DTW_SW_AVX2_LANES;
+        break;
+#endif
+#if defined(DTW_SW_HAVE_NEON)
+    case DTW_SW_ISA_NEON:
+        diag = dtw_sw_diag_neon;
+        diag_band = dtw_sw_diag_band_neon;
+        lanes = DTW_SW_NEON_LANES;
+        break;
+#endif
+    default:
+        break;
+    }
+
+    uint32_t rows = sw->qlen;
+    uint16_t x[DTW_SW_SQG_SIZE + DTW_SW_LANES_MAX];
+    uint16_t buf[3][DTW_SW_DIAG_WORDS];
+    for (uint32_t m = 0; m < DTW_SW_SQG_SIZE + DTW_SW_LANES_MAX; m++) {
+        x[m] = (m < rows) ? squiggle[m] : 0;
+    }
+    for (int b = 0; b < 3; b++) {
+        // First row: N = NW = 0, no column before the first: W = NW = MAX
+        buf[b][0] = 0;
+        for (int m = 1; m < DTW_SW_DIAG_WORDS; m++) {
+            buf[b][m] = DTW_SW_MAX_VALUE;
+        }
+    }
+    uint16_t *cur = buf[0] + 1;
+    uint16_t *p1 = buf[1] + 1;
+    uint16_t *p2 = buf[2] + 1;
+
+    // Band: warp offsets of the same cells. Above the first row N_off = 1, which also
+    // serves as NW_off there since NW never beats an equal N.
+    uint16_t band = sw->band;
+    int16_t off_buf[3][DTW_SW_DIAG_WORDS];
+    if (band != 0) {
+        for (int b = 0; b < 3; b++) {
+            off_buf[b][0] = 1;
+            memset(off_buf[b] + 1, 0, (DTW_SW_DIAG_WORDS - 1) * sizeof(int16_t));
+        }
+    }
+    int16_t *o_cur = off_buf[0] + 1;
+    int16_t *o_p1 = off_buf[1] + 1;
+    int16_t *o_p2 = off_buf[2] + 1;
+
+    // Abandoning: rows written on each buffer, and 1 + the highest row under the
+    // cutoff on the previous two diagonals
+    uint32_t written[3] = {0, 0, 0};
+    uint32_t *w_cur = &written[0];
+    uint32_t *w_p1 = &written[1];
+    uint32_t *w_p2 = &written[2];
+    uint32_t top_p1 = 0;
+    uint32_t top_p2 = 0;
+
+    const uint16_t *boundary = sweep->boundary;
+    if (boundary != NULL) {
+        p1[0] = boundary[0];
+    }
+    uint32_t top_boundary = 0;      // 1 + the highest boundary row under the cutoff
+    for (uint32_t m = 0; sweep->cutoff != 0 && boundary != NULL && m < rows; m++) {
+        top_boundary = (boundary[m] < sweep->cutoff) ? m + 1 : top_boundary;
+    }
+    if (sweep->checkpoint > 0 && sweep->own == 0 && sweep->n_checkpoints > 0) {
+        for (uint32_t m = 0; m < rows; m++) {
+            sweep->columns[m] = (boundary != NULL) ? boundary[m] : (uint16_t) DTW_SW_MAX_VALUE;
+        }
+    }
+
+    uint32_t n_cols = sweep->n_cols;
+    const uint16_t *cols = sw->cols[(core & 1) ? 0 : 1] + DTW_SW_COLS_PAD + sw->ref_len + 1 - sweep->first;
+
+    // Second strand: diagonal d crosses its first column at row d - restart
+    uint32_t strand_col = dtw_sw_strand_col(sw, core);
+    int has_restart = (strand_col != 0 && strand_col >= sweep->first && strand_col - sweep->first < n_cols);
+    uint32_t restart = strand_col - sweep->first;
+    sweep->score = DTW_SW_MAX_VALUE;
+    sweep->pos_score = DTW_SW_MAX_VALUE;
+    sweep->pos_col = 0;
+    sweep->accepted = 0;
+
+    for (uint32_t d = 0; d < n_cols + rows - 1; d++) {
+        // Rows whose column is past the end are skipped, rounded down to a whole vector
+        uint32_t lo = (d >= n_cols) ? (d - n_cols + 1) / lanes * lanes : 0;
+        uint32_t hi = (d < rows - 1) ? d + 1 : rows;
+        if (sweep->cutoff == 0) {
+            if (band != 0) {
+                diag_band(cur, p1, p2, o_cur, o_p1, o_p2, x, cols - d, lo, hi, d, band);
+            } else {
+                diag(cur, p1, p2, x, cols - d, lo, hi, d);
+            }
+            if (has_restart && d >= restart) {
+                dtw_sw_sweep_restart(cur, p1, o_cur, o_p1, x, cols - d, lo, hi, d - restart, band);
+            }
+            if (boundary != NULL && d + 1 < rows) {
+                cur[d + 1] = boundary[d + 1];
+            }
+        } else {
+            // A cell whose N, W and NW are all at or above the cutoff is too, so rows past
+            // one above the highest live row of the last two diagonals are not computed.
+            // They hold MAX instead, like the rows the kernel rounds up to a whole vector.
+            // Their offsets go stale, but a live cell never takes a dead dependency.
+            uint32_t top = (top_p1 > top_p2) ? top_p1 : top_p2;
+            hi = (top + 1 < hi) ? top + 1 : hi;
+            uint32_t end = (hi > lo) ? lo + (hi - lo + lanes - 1) / lanes * lanes : lo;
+            if (hi > lo && band != 0) {
+                diag_band(cur, p1, p2, o_cur, o_p1, o_p2, x, cols - d, lo, hi, d, band);
+            } else if (hi > lo) {
+                diag(cur, p1, p2, x, cols - d, lo, hi, d);
+            }
+            if (has_restart && d >= restart) {
+                dtw_sw_sweep_restart(cur, p1, o_cur, o_p1, x, cols - d, lo, hi, d - restart, band);
+            }
+            for (uint32_t m = end; m < *w_cur; m++) {
+                cur[m] = DTW_SW_MAX_VALUE;
+            }
+            *w_cur = end;
+
+            // Rows from hi on only had dead inputs, rows whose column is past the end never count
+            uint16_t cutoff = (sweep->score < sweep->cutoff) ? sweep->score : sweep->cutoff;
+            uint32_t real = (d + 1 > n_cols) ? d + 1 - n_cols : 0;
+            top = 0;
+            for (uint32_t m = hi; m > real && m > lo; m--) {
+                if (cur[m - 1] < cutoff) {
+                    top = m;
+                    break;
+                }
+            }
+            if (boundary != NULL && d + 1 < rows) {
+                cur[d + 1] = boundary[d + 1];
+                *w_cur = (d + 2 > end) ? d + 2 : end;
+                top = (boundary[d + 1] < cutoff) ? d + 2 : top;
+            }
+            top_p2 = top_p1;
+            top_p1 = top;
+        }
+
+        // Saved columns own - 1 + k * checkpoint, at most one per diagonal
+        if (sweep->checkpoint > 0 && d + 1 >= sweep->own) {
+            uint32_t k = (d + 1 - sweep->own) / sweep->checkpoint;
+            uint32_t c = k * sweep->checkpoint + sweep->own;     // column + 1
+            if (c > 0 && k < sweep->n_checkpoints && c <= n_cols && d + 1 - c < rows) {
+                sweep->columns[k * DTW_SW_SQG_SIZE + d + 1 - c] = cur[d + 1 - c];
+            }
+        }
+        if (sweep->last != NULL && d + 1 >= n_cols && d + 1 - n_cols < rows) {
+            sweep->last[d + 1 - n_cols] = cur[d + 1 - n_cols];
+        }
+
+        if (d >= rows - 1) {
+            uint32_t j = d - (rows - 1);
+            uint16_t v = cur[rows - 1];
+            if (j >= sweep->own && v < sweep->score) {
+                sweep->score = v;
+            }
+            // The position word leaves the core before the last column is compared
+            if (j >= sweep->own && sweep->first + j <= sw->ref_len && v < sweep->pos_score) {
+                sweep->pos_score = v;
+                sweep->pos_col = sweep->first + j;
+            }
+            if (sweep->hits != NULL && j >= sweep->own && sweep->first + j <= sw->ref_len) {
+                dtw_sw_hits_update(sweep->hits, sweep->first + j + 1, v);
+            }
+            // Nothing before it was below accept, so pos_col is this column
+            if (j >= sweep->own && sweep->first + j <= sw->ref_len && v < sweep->accept) {
+                sweep->accepted = 1;
+                break;
+            }
+        }
+
+        uint16_t *tmp = p2;
+        p2 = p1;
+        p1 = cur;
+        cur = tmp;
+        uint32_t *w_tmp = w_p2;
+        w_p2 = w_p1;
+        w_p1 = w_cur;
+        w_cur = w_tmp;
+        int16_t *o_tmp = o_p2;
+        o_p2 = o_p1;
+        o_p1 = o_cur;
+        o_cur = o_tmp;
+
+        // Nothing live left in range and no live boundary cell to come: the rest of the
+        // last column and of the last row are dead
+        uint32_t top = (top_p1 > top_p2) ? top_p1 : top_p2;
+        if (sweep->cutoff != 0 && d + 2 > n_cols && top + 1 <= d + 2 - n_cols && top_boundary <= d + 2) {
+            for (uint32_t m = d + 2 - n_cols; sweep->last != NULL && m < rows; m++) {
+                sweep->last[m] = DTW_SW_MAX_VALUE;
+            }
+            break;
+        }
+    }
+}
+
+/*
+ * Batch kernels: one query per lane, two vectors of lanes per pass. The lanes
+ * share the reference sample of each column and keep their own DTW_prev
+ * column, lane l of row m at column[m * lanes + l]. x holds the squiggles in
+ * the same layout.
+ */
+typedef void (*dtw_sw_batch_fn)(const dtw_sw_t *sw, uint32_t core, const uint16_t *x, uint16_t *column,
+                                uint16_t *minval, uint32_t *minpos);
+
+// Lanes whose last row improved on their minimum, in column order like the core
+static inline void dtw_sw_batch_update(const uint16_t *last, uint32_t lanes, uint32_t j, uint32_t ref_len,
+                                       uint16_t *minval, uint32_t *minpos) {
+    for (uint32_t l = 0; l < lanes; l++) {
+        if (last[l] < minval[l]) {
+            minval[l] = last[l];
+            if (j <= ref_len) {
+                minpos[l] = j + 1;
+            }
+        }
+    }
+}
+
+#if defined(DTW_SW_HAVE_AVX2)
+__attribute__((target("avx2")))
+static void dtw_sw_batch_avx2(const dtw_sw_t *sw, uint32_t core, const uint16_t *x, uint16_t *column,
+                              uint16_t *minval, uint32_t *minpos) {
+    const __m256i *xv = (const __m256i *) x;
+    __m256i *cv = (__m256i *) column;
+    const __m256i bias = _mm256_set1_epi16((int16_t) 0x8000);
+    uint32_t rows = sw->qlen;
+    uint32_t lag = (core & 1) ? 0 : 1;
+    uint32_t strand_col = dtw_sw_strand_col(sw, core);
+    __m256i best0 = _mm256_set1_epi16((int16_t) DTW_SW_MAX_VALUE);
+    __m256i best1 = best0;
+
+    for (uint32_t j = 0; j < sw->ref_len + 2; j++) {
+        uint32_t addr = (j >= lag) ? j - lag : 0;
+        __m256i y = _mm256_set1_epi16((int16_t) sw->mem[addr & (sw->ref_size - 1)]);
+        if (strand_col != 0 && j == strand_col) {
+            memset(column, 0xff, rows * 32 * sizeof(uint16_t));
+        }
+
+        // Two independent vectors per row hide the latency of the N chain. W and NW are
+        // combined first so only one min and the add wait on N.
+        __m256i n0 = _mm256_setzero_si256();        // First row: N = NW = 0
+        __m256i n1 = _mm256_setzero_si256();
+        __m256i nw0 = _mm256_setzero_si256();
+        __m256i nw1 = _mm256_setzero_si256();
+        for (uint32_t m = 0; m < rows; m++) {
+            __m256i w0 = _mm256_load_si256(cv + 2 * m);
+            __m256i w1 = _mm256_load_si256(cv + 2 * m + 1);
+            __m256i cost0 = _mm256_abs_epi16(_mm256_sub_epi16(_mm256_load_si256(xv + 2 * m), y));
+            __m256i cost1 = _mm256_abs_epi16(_mm256_sub_epi16(_mm256_load_si256(xv + 2 * m + 1), y));
+            n0 = _mm256_adds_epu16(cost0, _mm256_min_epu16(n0, _mm256_min_epu16(w0, nw0)));
+            n1 = _mm256_adds_epu16(cost1, _mm256_min_epu16(n1, _mm256_min_epu16(w1, nw1)));
+            _mm256_store_si256(cv + 2 * m, n0);
+            _mm256_store_si256(cv + 2 * m + 1, n1);
+            nw0 = w0;
+            nw1 = w1;
+        }
+
+        // Unsigned last < best, done on the rare columns where a lane improves
+        __m256i lt0 = _mm256_cmpgt_epi16(_mm256_xor_si256(best0, bias), _mm256_xor_si256(n0, bias));
+        __m256i lt1 = _mm256_cmpgt_epi16(_mm256_xor_si256(best1, bias), _mm256_xor_si256(n1, bias));
+        __m256i lt = _mm256_or_si256(lt0, lt1);
+        if (!_mm256_testz_si256(lt, lt)) {
+            best0 = _mm256_min_epu16(best0, n0);
+            best1 = _mm256_min_epu16(best1, n1);
+            dtw_sw_batch_update(column + (rows - 1) * 32, 32, j, sw->ref_len, minval, minpos);
+        }
+    }
+}
+#endif
+
+#if defined(DTW_SW_HAVE_NEON)
+static void dtw_sw_batch_neon(const dtw_sw_t *sw, uint32_t core, const uint16_t *x, uint16_t *column,
+                              uint16_t *minval, uint32_t *minpos) {
+    uint32_t rows = sw->qlen;
+    uint32_t lag = (core & 1) ? 0 : 1;
+    uint32_t strand_col = dtw_sw_strand_col(sw, core);
+    uint16x8_t best0 = vdupq_n_u16(DTW_SW_MAX_VALUE);
+    uint16x8_t best1 = best0;
+
+    for (uint32_t j = 0; j < sw->ref_len + 2; j++) {
+        uint32_t addr = (j >= lag) ? j - lag : 0;
+        uint16x8_t y = vdupq_n_u16(sw->mem[addr & (sw->ref_size - 1)]);
+        if (strand_col != 0 && j == strand_col) {
+            memset(column, 0xff, rows * 16 * sizeof(uint16_t));
+        }
+
+        // Two independent vectors per row hide the latency of the N chain. W and NW are
+        // combined first so only one min and the add wait on N.
+        uint16x8_t n0 = vdupq_n_u16(0);             // First row: N = NW = 0
+        uint16x8_t n1 = vdupq_n_u16(0);
+        uint16x8_t nw0 = vdupq_n_u16(0);
+        uint16x8_t nw1 = vdupq_n_u16(0);
+        for (uint32_t m = 0; m < rows; m++) {
+            uint16x8_t w0 = vld1q_u16(column + m * 16);
+            uint16x8_t w1 = vld1q_u16(column + m * 16 + 8);
+            uint16x8_t diff0 = vsubq_u16(vld1q_u16(x + m * 16), y);
+            uint16x8_t diff1 = vsubq_u16(vld1q_u16(x + m * 16 + 8), y);
+            uint16x8_t cost0 = vreinterpretq_u16_s16(vabsq_s16(vreinterpretq_s16_u16(diff0)));
+            uint16x8_t cost1 = vreinterpretq_u16_s16(vabsq_s16(vreinterpretq_s16_u16(diff1)));
+            n0 = vqaddq_u16(cost0, vminq_u16(n0, vminq_u16(w0, nw0)));
+            n1 = vqaddq_u16(cost1, vminq_u16(n1, vminq_u16(w1, nw1)));
+            vst1q_u16(column + m * 16, n0);
+            vst1q_u16(column + m * 16 + 8, n1);
+            nw0 = w0;
+            nw1 = w1;
+        }
+
+        // Done on the rare columns where a lane improves
+        if (vmaxvq_u16(vorrq_u16(vcltq_u16(n0, best0), vcltq_u16(n1, best1)))) {
+            best0 = vminq_u16(best0, n0);
+            best1 = vminq_u16(best1, n1);
+            dtw_sw_batch_update(column + (rows - 1) * 16, 16, j, sw->ref_len, minval, minpos);
+        }
+    }
+}
+#endif
+
+/*
+ * Runs n queries against the reference as core "core" would, out[i] gets the
+ * result of queries[i]. With a vector kernel the reference is streamed once
+ * for every 16 (NEON) or 32 (AVX2) queries, unless a band is set. Returns -1
+ * if a query is not dtw_sw_query_words(sw) words long.
+ */
+int32_t dtw_sw_process_queries(const dtw_sw_t *sw, uint32_t core, const int32_t **queries, const uint32_t *lens, size_t n, search_result_t *out) {
+    for (size_t i = 0; i < n; i++) {
+        if (lens[i] != dtw_sw_query_words(sw)) {
+            HARU_ERROR("Query %zu of %d words, the core takes %d.", i, lens[i], dtw_sw_query_words(sw));
+            return -1;
+        }
+    }
+
+    dtw_sw_batch_fn batch = NULL;
+    uint32_t lanes = 1;
+    switch (sw->isa) {
+#if defined(DTW_SW_HAVE_AVX2)
+    case DTW_SW_ISA_AVX2:
+        batch = dtw_sw_batch_avx2;
+        lanes = 2 * 16;
+        break;
+#endif
+#if defined(DTW_SW_HAVE_NEON)
+    case DTW_SW_ISA_NEON:
+        batch = dtw_sw_batch_neon;
+        lanes = 2 * 8;
+        break;
+#endif
+    default:
+        break;
+    }
+    // The batch kernels carry no warp offsets and do not stop early
+    if (batch == NULL || sw->band != 0 || sw->thresh != 0) {
+        for (size_t i = 0; i < n; i++) {
+            dtw_sw_process_query(sw, core, queries[i], lens[i], &out[i]);
+        }
+        return 0;
+    }
+
+    alignas(32) uint16_t x[DTW_SW_SQG_SIZE * DTW_SW_BATCH_LANES_MAX];
+    alignas(32) uint16_t column[DTW_SW_SQG_SIZE * DTW_SW_BATCH_LANES_MAX];
+    uint16_t minval[DTW_SW_BATCH_LANES_MAX];
+    uint32_t minpos[DTW_SW_BATCH_LANES_MAX];
+
+    for (size_t i = 0; i < n; i += lanes) {
+        // Unused lanes of the last group run a zero squiggle
+        uint32_t used = (n - i < lanes) ? (uint32_t) (n - i) : lanes;
+        for (uint32_t l = 0; l < lanes; l++) {
+            for (uint32_t m = 0; m < sw->qlen; m++) {
+                x[m * lanes + l] = (l < used) ? (uint16_t) queries[i + l][m + 2] : 0;
+                column[m * lanes + l] = DTW_SW_MAX_VALUE;
+            }
+            minval[l] = DTW_SW_MAX_VALUE;
+            minpos[l] = 0;
+        }
+
+        batch(sw, core, x, column, minval, minpos);
+
+        for (uint32_t l = 0; l < used; l++) {
+            out[i + l].qid = (uint32_t) queries[i + l][0];
+            out[i + l].position = dtw_sw_position(sw, core, minpos[l]);
+            out[i + l].score = minval[l];
+        }
+    }
+    return 0;
+}
+
+/*
+ * Runs one query (qid, pad word, sw->qlen samples, as sent to the core)
+ * against the reference as core "core" would. Returns -1 if the query is not
+ * dtw_sw_query_words(sw) words long.
+ */
+int32_t dtw_sw_process_query(const dtw_sw_t *sw, uint32_t core, const int32_t *query, uint32_t size, search_result_t *result) {
+    if (size != dtw_sw_query_words(sw)) {
+        HARU_ERROR("Query of %d words, the core takes %d.", size, dtw_sw_query_words(sw));
+        return -1;
+    }
+
+    uint16_t minval;
+    uint32_t minpos;
+    if (sw->isa == DTW_SW_ISA_SCALAR) {
+        dtw_sw_scalar(sw, core, query, &minval, &minpos, NULL);
+    } else {
+        uint16_t squiggle[DTW_SW_SQG_SIZE];
+        for (uint32_t m = 0; m < sw->qlen; m++) {
+            squiggle[m] = (uint16_t) query[m + 2];
+        }
+        dtw_sw_sweep_t sweep = {};
+        sweep.n_cols = sw->ref_len + 2;
+        sweep.accept = sw->thresh;
+        dtw_sw_sweep(sw, core, squiggle, &sweep);
+
+        // The core's position is the last strict improvement, the first minimum up to REF_LEN
+        minval = sweep.score;
+        minpos = (sweep.pos_score < DTW_SW_MAX_VALUE) ? sweep.pos_col + 1 : 0;
+    }
+
+    result->qid = (uint32_t) query[0];
+    result->position = dtw_sw_position(sw, core, minpos);
+    result->score = minval;
+    return 0;
+}
+
+/*
+ * Runs one query like dtw_sw_process_query and returns its n_hits best
+ * non-overlapping hits, best first, like the core with REG_HITS = n_hits. A
+ * single hit is the core's plain result. Hits that were not found and the
+ * entries past n_hits have position 0 and score DTW_SW_MAX_VALUE. Returns -1
+ * if the query is not dtw_sw_query_words(sw) words long or n_hits is not 1 to
+ * DTW_ACCEL_HITS_MAX.
+ */
+int32_t dtw_sw_process_query_hits(const dtw_sw_t *sw, uint32_t core, const int32_t *query, uint32_t size, uint32_t n_hits,
+                                  search_hits_t *hits) {
+    if (size != dtw_sw_query_words(sw)) {
+        HARU_ERROR("Query of %d words, the core takes %d.", size, dtw_sw_query_words(sw));
+        return -1;
+    }
+    if (n_hits == 0 || n_hits > DTW_ACCEL_HITS_MAX) {
+        HARU_ERROR("%d hits per query, the core keeps 1 to %d.", n_hits, DTW_ACCEL_HITS_MAX);
+        return -1;
+    }
+
+    dtw_sw_hits_t list;
+    dtw_sw_hits_init(&list, sw->qlen);
+    if (n_hits == 1) {
+        search_result_t result;
+        dtw_sw_process_query(sw, core, query, size, &result);
+        list.hits[0].position = result.position;
+        list.hits[0].score = result.score;
+    } else if (sw->isa == DTW_SW_ISA_SCALAR) {
+        uint16_t minval;
+        uint32_t minpos;
+        dtw_sw_scalar(sw, core, query, &minval, &minpos, &list);
+        dtw_sw_hits_insert(&list);
+    } else {
+        uint16_t squiggle[DTW_SW_SQG_SIZE];
+        for (uint32_t m = 0; m < sw->qlen; m++) {
+            squiggle[m] = (uint16_t) query[m + 2];
+        }
+        dtw_sw_sweep_t sweep = {};
+        sweep.n_cols = sw->ref_len + 2;
+        sweep.hits = &list;
+        sweep.accept = sw->thresh;
+        dtw_sw_sweep(sw, core, squiggle, &sweep);
+        dtw_sw_hits_insert(&list);
+    }
+    for (uint32_t i = 0; n_hits > 1 && i < n_hits; i++) {
+        list.hits[i].position = dtw_sw_position(sw, core, list.hits[i].position);
+    }
+
+    hits->qid = (uint32_t) query[0];
+    for (uint32_t i = 0; i < DTW_ACCEL_HITS_MAX; i++) {
+        hits->hits[i].position = (i < n_hits) ? list.hits[i].position : 0;
+        hits->hits[i].score = (i < n_hits) ? list.hits[i].score : (uint32_t) DTW_SW_MAX_VALUE;
+    }
+    return 0;
+}
+
+/*
+ * Like dtw_sw_process_query, but the sweep abandons every cell that can no
+ * longer beat the best score so far or max_score (see dtw_sw_sweep_t.cutoff).
+ * Most of a large reference only keeps a few rows of each column under the
+ * best score, so most cells are never computed. The result is exact when its
+ * score is below max_score, DTW_SW_MAX_VALUE always gives the core's result.
+ * Otherwise the query has no hit: position 0, score DTW_SW_MAX_VALUE.
+ */
+int32_t dtw_sw_process_query_pruned(const dtw_sw_t *sw, uint32_t core, const int32_t *query, uint32_t size, uint16_t max_score,
+                                    search_result_t *result) {
+    if (size != dtw_sw_query_words(sw)) {
+        HARU_ERROR("Query of %d words, the core takes %d.", size, dtw_sw_query_words(sw));
+        return -1;
+    }
+
+    uint16_t squiggle[DTW_SW_SQG_SIZE];
+    for (uint32_t m = 0; m < sw->qlen; m++) {
+        squiggle[m] = (uint16_t) query[m + 2];
+    }
+    dtw_sw_sweep_t sweep = {};
+    sweep.n_cols = sw->ref_len + 2;
+    // An early accept above max_score still has to find the column it stops at
+    uint16_t cutoff = (sw->thresh > max_score) ? sw->thresh : max_score;
+    sweep.cutoff = (cutoff > 0) ? cutoff : 1;
+    sweep.accept = sw->thresh;
+    dtw_sw_sweep(sw, core, squiggle, &sweep);
+
+    result->qid = (uint32_t) query[0];
+    if (sweep.score < max_score || max_score == DTW_SW_MAX_VALUE) {
+        result->position = dtw_sw_position(sw, core, (sweep.pos_score < DTW_SW_MAX_VALUE) ? sweep.pos_col + 1 : 0);
+        result->score = sweep.score;
+    } else {
+        result->position = 0;
+        result->score = DTW_SW_MAX_VALUE;
+    }
+    return 0;
+}
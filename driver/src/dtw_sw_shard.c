@@ -0,0 +1,271 @@
+/* MIT License
+
+Copyright (c) 2022 Po Jui Shih
+Copyright (c) 2022 Hassaan Saadat
+Copyright (c) 2022 Sri Parameswaran
+Copyright (c) 2022 Hasindu Gamaarachchi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "dtw_sw_shard.h"
+#include "misc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DTW_SW_COLUMN_BYTES (DTW_SW_SQG_SIZE * sizeof(uint16_t))
+
+/*
+ * Pass 1: sweeps the shards that are left, on the workers and the caller
+ */
+static void dtw_sw_shard_run(dtw_sw_shard_t *shard) {
+    while (1) {
+        pthread_mutex_lock(&shard->lock);
+        uint32_t k = shard->next_shard++;
+        pthread_mutex_unlock(&shard->lock);
+        if (k >= shard->n_shards) {
+            return;
+        }
+
+        dtw_sw_sweep(shard->sw, shard->core, shard->squiggle, &shard->sweeps[k]);
+
+        pthread_mutex_lock(&shard->lock);
+        if (++shard->shards_done == shard->n_shards) {
+            pthread_cond_signal(&shard->done);
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+static void *dtw_sw_shard_worker(void *arg) {
+    dtw_sw_shard_t *shard = (dtw_sw_shard_t *) arg;
+    uint32_t seen = 0;
+
+    pthread_mutex_lock(&shard->lock);
+    while (1) {
+        while (!shard->stop && shard->generation == seen) {
+            pthread_cond_wait(&shard->start, &shard->lock);
+        }
+        if (shard->stop) {
+            break;
+        }
+        seen = shard->generation;
+        pthread_mutex_unlock(&shard->lock);
+        dtw_sw_shard_run(shard);
+        pthread_mutex_lock(&shard->lock);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return NULL;
+}
+
+/*
+ * Init and release functions
+ */
+int32_t dtw_sw_shard_init(dtw_sw_shard_t *shard, const dtw_sw_t *sw, uint32_t n_threads) {
+    if (n_threads == 0) {
+        n_threads = 1;
+    }
+    memset(shard, 0, sizeof(dtw_sw_shard_t));
+    shard->sw = sw;
+    shard->n_threads = n_threads;
+    shard->warmup = DTW_SW_SHARD_WARMUP;
+    pthread_mutex_init(&shard->lock, NULL);
+    pthread_cond_init(&shard->start, NULL);
+    pthread_cond_init(&shard->done, NULL);
+
+    shard->starts = (uint32_t *) malloc((n_threads + 1) * sizeof(uint32_t));
+    shard->sweeps = (dtw_sw_sweep_t *) calloc(n_threads, sizeof(dtw_sw_sweep_t));
+    shard->columns = (uint16_t *) malloc((size_t) n_threads * DTW_SW_SHARD_MAX_CHECKPOINTS * DTW_SW_COLUMN_BYTES);
+    shard->lasts = (uint16_t *) malloc((size_t) n_threads * DTW_SW_COLUMN_BYTES);
+    shard->threads = (pthread_t *) calloc(n_threads, sizeof(pthread_t));
+    HARU_MALLOC_CHK(shard->starts);
+    HARU_MALLOC_CHK(shard->sweeps);
+    HARU_MALLOC_CHK(shard->columns);
+    HARU_MALLOC_CHK(shard->lasts);
+    HARU_MALLOC_CHK(shard->threads);
+    if (shard->starts == NULL || shard->sweeps == NULL || shard->columns == NULL || shard->lasts == NULL || shard->threads == NULL) {
+        dtw_sw_shard_release(shard);
+        return -1;
+    }
+
+    // The calling thread sweeps a shard as well
+    for (uint32_t i = 1; i < n_threads; i++) {
+        if (pthread_create(&shard->threads[i], NULL, dtw_sw_shard_worker, shard)) {
+            HARU_ERROR("Failed to start sDTW worker thread %d.", i);
+            shard->n_threads = i;
+            dtw_sw_shard_release(shard);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void dtw_sw_shard_release(dtw_sw_shard_t *shard) {
+    if (shard->threads != NULL && shard->n_threads > 1) {
+        pthread_mutex_lock(&shard->lock);
+        shard->stop = 1;
+        pthread_cond_broadcast(&shard->start);
+        pthread_mutex_unlock(&shard->lock);
+        for (uint32_t i = 1; i < shard->n_threads; i++) {
+            pthread_join(shard->threads[i], NULL);
+        }
+    }
+    pthread_mutex_destroy(&shard->lock);
+    pthread_cond_destroy(&shard->start);
+    pthread_cond_destroy(&shard->done);
+
+    free(shard->starts);
+    free(shard->sweeps);
+    free(shard->columns);
+    free(shard->lasts);
+    free(shard->threads);
+    shard->starts = NULL;
+    shard->sweeps = NULL;
+    shard->columns = NULL;
+    shard->lasts = NULL;
+    shard->threads = NULL;
+}
+
+/*
+ * Query processing
+ */
+// Folds the minima of a sweep over true columns into the result
+static void dtw_sw_shard_merge(const dtw_sw_sweep_t *sweep, uint16_t *score, uint16_t *pos_score, uint32_t *pos_col) {
+    if (sweep->score < *score) {
+        *score = sweep->score;
+    }
+    if (sweep->pos_score < *pos_score || (sweep->pos_score == *pos_score && sweep->pos_col < *pos_col)) {
+        *pos_score = sweep->pos_score;
+        *pos_col = sweep->pos_col;
+    }
+}
+
+/*
+ * Runs one query like dtw_sw_process_query, with the reference split over the
+ * threads of the pool. Returns -1 if the query is not dtw_sw_query_words(sw)
+ * words long.
+ */
+int32_t dtw_sw_shard_process_query(dtw_sw_shard_t *shard, uint32_t core, const int32_t *query, uint32_t size, search_result_t *result) {
+    const dtw_sw_t *sw = shard->sw;
+    if (size != dtw_sw_query_words(sw)) {
+        HARU_ERROR("Query of %d words, the core takes %d.", size, dtw_sw_query_words(sw));
+        return -1;
+    }
+
+    // A boundary column carries no warp offsets, so a band runs in one piece. An
+    // early accept needs the columns in order, so it does too.
+    if (sw->band != 0 || sw->thresh != 0) {
+        return dtw_sw_process_query(sw, core, query, size, result);
+    }
+    uint32_t n_cols = sw->ref_len + 2;
+    uint32_t n_shards = n_cols / DTW_SW_SHARD_MIN_COLS;
+    if (n_shards > shard->n_threads) {
+        n_shards = shard->n_threads;
+    }
+    if (n_shards == 0) {
+        n_shards = 1;
+    }
+
+    // Set up under the lock, a worker may still be leaving the previous query
+    pthread_mutex_lock(&shard->lock);
+    shard->core = core;
+    for (uint32_t m = 0; m < sw->qlen; m++) {
+        shard->squiggle[m] = (uint16_t) query[m + 2];
+    }
+    shard->n_shards = n_shards;
+    for (uint32_t k = 0; k <= n_shards; k++) {
+        shard->starts[k] = (uint32_t) ((uint64_t) n_cols * k / n_shards);
+    }
+    for (uint32_t k = 0; k < n_shards; k++) {
+        uint32_t start = shard->starts[k];
+        uint32_t end = shard->starts[k + 1];
+        uint32_t first = (start > shard->warmup) ? start - shard->warmup : 0;
+
+        dtw_sw_sweep_t *sweep = &shard->sweeps[k];
+        memset(sweep, 0, sizeof(dtw_sw_sweep_t));
+        sweep->first = first;
+        sweep->n_cols = end - first;
+        sweep->own = start - first;
+        sweep->checkpoint = DTW_SW_SHARD_CHECKPOINT;
+        sweep->n_checkpoints = (end - start) / DTW_SW_SHARD_CHECKPOINT + 1;
+        sweep->columns = shard->columns + (size_t) k * DTW_SW_SHARD_MAX_CHECKPOINTS * DTW_SW_SQG_SIZE;
+        sweep->last = shard->lasts + (size_t) k * DTW_SW_SQG_SIZE;
+    }
+    shard->next_shard = 0;
+    shard->shards_done = 0;
+    shard->generation++;
+    pthread_cond_broadcast(&shard->start);
+    pthread_mutex_unlock(&shard->lock);
+
+    dtw_sw_shard_run(shard);
+
+    pthread_mutex_lock(&shard->lock);
+    while (shard->shards_done < n_shards) {
+        pthread_cond_wait(&shard->done, &shard->lock);
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    // Pass 2: stitch the shards in column order. true_col is the true column left of shard k.
+    uint16_t score = DTW_SW_MAX_VALUE;
+    uint16_t pos_score = DTW_SW_MAX_VALUE;
+    uint32_t pos_col = 0;
+    uint16_t true_col[DTW_SW_SQG_SIZE];
+    uint16_t next_col[DTW_SW_SQG_SIZE];
+    size_t column_bytes = sw->qlen * sizeof(uint16_t);
+
+    for (uint32_t k = 0; k < n_shards; k++) {
+        const dtw_sw_sweep_t *sweep = &shard->sweeps[k];
+        uint32_t start = shard->starts[k];
+        uint32_t end = shard->starts[k + 1];
+
+        // The pass 1 minima are never below the true ones and match them past the first
+        // matching column, so merging both sets gives the true minima of the shard
+        dtw_sw_shard_merge(sweep, &score, &pos_score, &pos_col);
+        if (k == 0 || sweep->first == 0 || !memcmp(true_col, sweep->columns, column_bytes)) {
+            memcpy(true_col, sweep->last, column_bytes);
+            continue;
+        }
+
+        for (uint32_t i = 1; ; i++) {
+            dtw_sw_sweep_t fix = {};
+            fix.first = start + (i - 1) * DTW_SW_SHARD_CHECKPOINT;
+            fix.n_cols = (end - fix.first < DTW_SW_SHARD_CHECKPOINT) ? end - fix.first : DTW_SW_SHARD_CHECKPOINT;
+            fix.boundary = true_col;
+            fix.last = next_col;
+            dtw_sw_sweep(sw, core, shard->squiggle, &fix);
+            dtw_sw_shard_merge(&fix, &score, &pos_score, &pos_col);
+
+            if (fix.first + fix.n_cols == end) {
+                memcpy(true_col, next_col, column_bytes);
+                break;
+            }
+            if (!memcmp(next_col, sweep->columns + i * DTW_SW_SQG_SIZE, column_bytes)) {
+                memcpy(true_col, sweep->last, column_bytes);
+                break;
+            }
+            memcpy(true_col, next_col, column_bytes);
+        }
+    }
+
+    result->qid = (uint32_t) query[0];
+    result->position = dtw_sw_position(sw, core, (pos_score < DTW_SW_MAX_VALUE) ? pos_col + 1 : 0);
+    result->score = score;
+    return 0;
+}
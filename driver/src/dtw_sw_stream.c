@@ -0,0 +1,163 @@
+/* MIT License
+
+Copyright (c) 2022 Po Jui Shih
+Copyright (c) 2022 Hassaan Saadat
+Copyright (c) 2022 Sri Parameswaran
+Copyright (c) 2022 Hasindu Gamaarachchi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "dtw_sw_stream.h"
+#include "misc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Init and release functions
+ */
+int32_t dtw_sw_stream_init(dtw_sw_stream_t *stream, const dtw_sw_t *sw, uint32_t core) {
+    stream->sw = sw;
+    stream->core = core;
+    stream->row = (uint16_t *) malloc((DTW_SW_REF_MEM_SIZE + 2) * sizeof(uint16_t));
+    stream->row_off = (int16_t *) malloc((DTW_SW_REF_MEM_SIZE + 2) * sizeof(int16_t));
+    HARU_MALLOC_CHK(stream->row);
+    HARU_MALLOC_CHK(stream->row_off);
+    if (stream->row == NULL || stream->row_off == NULL) {
+        dtw_sw_stream_release(stream);
+        return -1;
+    }
+    dtw_sw_stream_reset(stream, 0);
+    return 0;
+}
+
+void dtw_sw_stream_release(dtw_sw_stream_t *stream) {
+    free(stream->row);
+    free(stream->row_off);
+    stream->row = NULL;
+    stream->row_off = NULL;
+}
+
+// Starts a new read, also needed after a new reference was loaded
+void dtw_sw_stream_reset(dtw_sw_stream_t *stream, uint32_t qid) {
+    stream->qid = qid;
+    stream->n_samples = 0;
+}
+
+/*
+ * Adds n samples of the read and returns the best match so far in "result",
+ * position 0 and score DTW_SW_MAX_VALUE before the first sample. The samples
+ * are added DTW_SW_STREAM_STRIP rows at a time: each pass goes once over the
+ * reference and computes the strip column by column, starting from the
+ * stored last row. Returns -1 if more than 2^32 - 1 samples were pushed.
+ */
+int32_t dtw_sw_stream_push(dtw_sw_stream_t *stream, const int32_t *samples, uint32_t n, search_result_t *result) {
+    const dtw_sw_t *sw = stream->sw;
+    uint32_t n_cols = sw->ref_len + 2;
+    uint16_t *row = stream->row;
+    int16_t *row_off = stream->row_off;
+    uint32_t strand_col = dtw_sw_strand_col(sw, stream->core);
+
+    if (stream->n_samples + n < stream->n_samples) {
+        HARU_ERROR("%s", "Read is too long.");
+        return -1;
+    }
+
+    for (uint32_t r0 = 0; r0 < n; r0 += DTW_SW_STREAM_STRIP) {
+        uint32_t k = (n - r0 < DTW_SW_STREAM_STRIP) ? n - r0 : DTW_SW_STREAM_STRIP;
+        uint16_t x[DTW_SW_STREAM_STRIP];
+        uint16_t column[DTW_SW_STREAM_STRIP];   // W of every row of the strip
+        int16_t offset[DTW_SW_STREAM_STRIP];    // warp offsets of column, reset to 0
+        for (uint32_t i = 0; i < k; i++) {
+            x[i] = (uint16_t) samples[r0 + i];
+            column[i] = DTW_SW_MAX_VALUE;
+            offset[i] = 0;
+        }
+
+        // The row above the first sample is the free first row: N = NW = 0, N_off = 1
+        int first = (stream->n_samples == 0);
+        uint16_t above_prev = first ? 0 : (uint16_t) DTW_SW_MAX_VALUE;
+        int16_t above_prev_off = 0;
+        for (uint32_t j = 0; j < n_cols; j++) {
+            uint16_t y = dtw_sw_column(sw, stream->core, j);
+
+            // Second strand: no column before its first one, like column 0
+            if (strand_col != 0 && j == strand_col) {
+                for (uint32_t i = 0; i < k; i++) {
+                    column[i] = DTW_SW_MAX_VALUE;
+                    offset[i] = 0;
+                }
+                above_prev = first ? 0 : (uint16_t) DTW_SW_MAX_VALUE;
+                above_prev_off = 0;
+            }
+            uint16_t above = first ? 0 : row[j];
+            int16_t above_off = first ? 1 : row_off[j];
+            uint16_t nv = above;
+            uint16_t nw = above_prev;
+            if (sw->band == 0) {
+                for (uint32_t i = 0; i < k; i++) {
+                    uint16_t w = column[i];
+                    uint16_t d = dtw_sw_pe(x[i], y, nv, w, nw);
+                    column[i] = d;
+                    nw = w;
+                    nv = d;
+                }
+            } else {
+                int16_t n_off = above_off;
+                int16_t nw_off = above_prev_off;
+                for (uint32_t i = 0; i < k; i++) {
+                    uint16_t w = column[i];
+                    int16_t w_off = offset[i];
+                    uint16_t d = dtw_sw_pe_band(x[i], y, nv, w, nw, n_off, w_off, nw_off, sw->band, &offset[i]);
+                    column[i] = d;
+                    nw = w;
+                    nw_off = w_off;
+                    nv = d;
+                    n_off = offset[i];
+                }
+                row_off[j] = n_off;
+            }
+            above_prev = above;
+            above_prev_off = above_off;
+            row[j] = nv;
+        }
+        stream->n_samples += k;
+    }
+
+    // Same minimum, position and early accept rules as dtw_sw_process_query
+    uint16_t minval = DTW_SW_MAX_VALUE;
+    uint32_t minpos = 0;
+    if (stream->n_samples > 0) {
+        for (uint32_t j = 0; j < n_cols; j++) {
+            if (row[j] < minval) {
+                minval = row[j];
+                if (j <= sw->ref_len) {
+                    minpos = j + 1;
+                }
+            }
+            if (j <= sw->ref_len && row[j] < sw->thresh) {
+                break;
+            }
+        }
+    }
+    result->qid = stream->qid;
+    result->position = dtw_sw_position(sw, stream->core, minpos);
+    result->score = minval;
+    return 0;
+}
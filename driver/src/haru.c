@@ -26,6 +26,7 @@ SOFTWARE. */
 #include "haru.h"
 #include "misc.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 /*
@@ -36,7 +37,7 @@ int32_t haru_init(haru_t *haru) {
     uint32_t ret;
 
     // Initialize axi_dma
-    ret = axi_dma_init(&haru->axi_dma, HARU_AXI_DMA_ADDR_BASE, HARU_AXI_SRC_ADDR, HARU_AXI_DST_ADDR, HARU_AXI_DMA_SIZE);
+    ret = axi_dma_init(&haru->axi_dma, HARU_AXI_DMA_ADDR_BASE, HARU_AXI_SRC_ADDR, HARU_AXI_DST_ADDR, HARU_AXI_DMA_SIZE, HARU_AXI_SRC_BUFFER_SIZE, HARU_DMA_BUF_BACKEND);
     if (ret != 0) {
         return -1;
     }
@@ -48,6 +49,7 @@ int32_t haru_init(haru_t *haru) {
     }
 
     haru_check_key(haru);
+    haru->n_hits = 1;
     // uint32_t version = haru_get_version(haru);
     // printf("HARU version: %x\n", version);
     // printf("DTW_ACCEL busy: %x\n", dtw_accel_busy(&haru->dtw_accel));
@@ -64,7 +66,7 @@ int32_t haru_init(haru_t *haru) {
 int haru_multi_accel_init(haru_t *haru) {
     uint32_t ret;
     // Initialise axi_mcdma
-    ret = axi_mcdma_init(&haru->axi_mcdma, HARU_AXI_DMA_ADDR_BASE, HARU_AXI_SRC_ADDR, HARU_AXI_DST_ADDR, HARU_AXI_MM2S_BD_CHAIN_ADDR, HARU_AXI_S2MM_BD_CHAIN_ADDR, HARU_AXI_DMA_SIZE);
+    ret = axi_mcdma_init(&haru->axi_mcdma, HARU_AXI_DMA_ADDR_BASE, HARU_AXI_SRC_ADDR, HARU_AXI_DST_ADDR, HARU_AXI_MM2S_BD_CHAIN_ADDR, HARU_AXI_S2MM_BD_CHAIN_ADDR, HARU_AXI_DMA_SIZE, HARU_AXI_BD_CHAIN_SIZE, HARU_AXI_SRC_BUFFER_SIZE, HARU_DMA_BUF_BACKEND);
     if (ret != 0) {
         return -1;
     }
@@ -76,6 +78,35 @@ int haru_multi_accel_init(haru_t *haru) {
     }
 
     haru_check_key(haru);
+
+    // One channel per DTW core, mm2s_packet_filter routes channel i (tdest i) to core i.
+    // All channels share the source and destination buffers; the regions their
+    // descriptors point at never overlap.
+    haru->num_accel = dtw_accel_get_num_accel(&haru->dtw_accel);
+    if (haru->num_accel > HARU_MAX_ACCEL) {
+        HARU_ERROR("Only %d of %u DTW cores can be used.", HARU_MAX_ACCEL, haru->num_accel);
+        haru->num_accel = HARU_MAX_ACCEL;
+    }
+    HARU_STATUS("Using %u DTW core(s)", haru->num_accel);
+    if (dtw_accel_get_cohort(&haru->dtw_accel) != 0) {
+        HARU_STATUS("%s", "DTW cores start their queries in cohorts");
+    }
+
+    // REG_HITS, REG_QLEN, REG_THRESH and REG_BAND outlive the process that set
+    // them, go back to one hit per result, full length queries (saturated at
+    // the design's PEs), full reference sweeps and unconstrained warping
+    dtw_accel_set_hits(&haru->dtw_accel, 1);
+    haru->n_hits = 1;
+    dtw_accel_set_qlen(&haru->dtw_accel, DTW_ACCEL_QLEN_MAX);
+    dtw_accel_set_thresh(&haru->dtw_accel, 0);
+    dtw_accel_set_band(&haru->dtw_accel, 0);
+
+    // Lay out the channels' bd rings and start the engine once; it is left running
+    for (uint32_t i = 0; i < haru->num_accel; i++) {
+        axi_mcdma_channel_init(&haru->axi_mcdma, i, 0, 0, HARU_AXI_SRC_BUFFER_SIZE, HARU_AXI_BUFFER_SIZE);
+    }
+    axi_mcdma_start(&haru->axi_mcdma);
+    memset(&haru->async, 0, sizeof(haru_async_t));
     // uint32_t version = haru_get_version(haru);
     // printf("HARU version: %x\n", version);
     // printf("DTW_ACCEL busy: %x\n", dtw_accel_busy(&haru->dtw_accel));
@@ -89,6 +120,29 @@ int haru_multi_accel_init(haru_t *haru) {
     return 0;
 }
 
+/*
+ * Selects how DMA completions are waited for: UIO_IRQ_MODE_POLL spins on the
+ * status registers, UIO_IRQ_MODE_IRQ sleeps on the interrupt and
+ * UIO_IRQ_MODE_HYBRID spins briefly before sleeping.
+ */
+int32_t haru_irq_init(haru_t *haru, uint8_t mode) {
+    return axi_dma_irq_init(&haru->axi_dma, HARU_AXI_DMA_MM2S_UIO, HARU_AXI_DMA_S2MM_UIO, mode);
+}
+
+int haru_multi_accel_irq_init(haru_t *haru, uint8_t mode) {
+    char mm2s_uio[32];
+    char s2mm_uio[32];
+
+    for (uint32_t i = 0; i < haru->num_accel; i++) {
+        snprintf(mm2s_uio, sizeof(mm2s_uio), HARU_AXI_MCDMA_UIO_FMT, 2 * i);
+        snprintf(s2mm_uio, sizeof(s2mm_uio), HARU_AXI_MCDMA_UIO_FMT, 2 * i + 1);
+        if (axi_mcdma_channel_irq_init(&haru->axi_mcdma, i, mm2s_uio, s2mm_uio, mode)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
 void haru_release(haru_t *haru) {
     axi_dma_release(&haru->axi_dma);
     dtw_accel_release(&haru->dtw_accel);
@@ -113,6 +167,74 @@ uint32_t haru_get_version(haru_t *haru) {
     return version;
 }
 
+/*
+ * Sakoe-Chiba band of all cores, in warp steps off the diagonal of each
+ * alignment's start (see dtw_sw_set_band). 0 lifts the constraint. Takes effect
+ * from the next query; set it while no query is in flight.
+ */
+int32_t haru_set_band(haru_t *haru, uint32_t band) {
+    if (dtw_accel_set_band(&haru->dtw_accel, band)) {
+        HARU_ERROR("Band %u not supported by this design (version 0x%08x).", band, haru_get_version(haru));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Number of hits (1 to DTW_ACCEL_HITS_MAX) in the result packet of every core,
+ * see haru_process_query_hits. With more than one hit, haru_process_queries and
+ * the asynchronous calls refuse to run. Returns -1 if the design keeps fewer hits.
+ */
+int32_t haru_set_hits(haru_t *haru, uint32_t n_hits) {
+    if (dtw_accel_set_hits(&haru->dtw_accel, n_hits)) {
+        HARU_ERROR("%u hits per result not supported by this design (version 0x%08x).", n_hits, haru_get_version(haru));
+        return -1;
+    }
+    haru->n_hits = n_hits;
+    return 0;
+}
+
+/*
+ * Samples per query (1 to DTW_ACCEL_QLEN_MAX) of every core: queries are then
+ * qid, pad word and qlen samples (see dtw_sw_set_query_len). Set it while no
+ * query is in flight. Returns -1 if the cores have fewer PEs.
+ */
+int32_t haru_set_query_len(haru_t *haru, uint32_t qlen) {
+    if (dtw_accel_set_qlen(&haru->dtw_accel, qlen)) {
+        HARU_ERROR("Query of %u samples not supported by this design (version 0x%08x).", qlen, haru_get_version(haru));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Early accept score of every core (see dtw_sw_set_thresh), 0 for off. A query
+ * whose last row drops below it returns the first such hit as soon as the core
+ * reaches it, instead of the best hit after the whole reference. Set it while
+ * no query is in flight. Returns -1 if the design has no early accept.
+ */
+int32_t haru_set_thresh(haru_t *haru, uint32_t thresh) {
+    if (dtw_accel_set_thresh(&haru->dtw_accel, thresh)) {
+        HARU_ERROR("Early accept score %u not supported by this design (version 0x%08x).", thresh, haru_get_version(haru));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Cycles the cores of a cohort design wait for each other's queries once the
+ * first has a full query, before the ones that have theirs start the reference
+ * sweep together. Short waits favour the latency of lone queries, long ones the
+ * throughput of batches. Returns -1 if the cores do not run in cohorts.
+ */
+int32_t haru_set_cohort(haru_t *haru, uint32_t cycles) {
+    if (dtw_accel_set_cohort(&haru->dtw_accel, cycles)) {
+        HARU_ERROR("Cohort wait not supported by this design (version 0x%08x).", haru_get_version(haru));
+        return -1;
+    }
+    return 0;
+}
+
 void haru_get_load_done(haru_t *haru) {
     uint32_t done = dtw_accel_ref_load_done(&haru->dtw_accel);
     if (done == 0) {
@@ -122,7 +244,89 @@ void haru_get_load_done(haru_t *haru) {
     fprintf(stderr, "Load done\n");
 }
 
+/*
+ * Reference residency. The reference memory and REF_LEN keep their contents across a core
+ * reset, so the driver remembers what it loaded in HARU_REF_STATE_FILE and a later load of
+ * the same reference (from any process) returns without touching the DMA. A bitstream reload
+ * clears REF_LEN and the load done flag, which invalidates the record.
+ */
+static uint64_t haru_ref_hash(const int32_t *ref, uint32_t size) {
+    // FNV-1a over the sample bytes
+    const uint8_t *bytes = (const uint8_t *) ref;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size * sizeof(int32_t); i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static int haru_ref_resident(haru_t *haru, uint32_t size, uint64_t hash) {
+    const char *state_file = HARU_REF_STATE_FILE;
+    if (state_file == NULL) {
+        return 0;
+    }
+    if (!dtw_accel_ref_load_done(&haru->dtw_accel) || dtw_accel_get_ref_len(&haru->dtw_accel) != size) {
+        return 0;
+    }
+
+    FILE *fp = fopen(state_file, "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    unsigned int version, len;
+    unsigned long long state_hash;
+    int n = fscanf(fp, "%x %u %llx", &version, &len, &state_hash);
+    fclose(fp);
+    return n == 3 && version == haru_get_version(haru) && len == size && state_hash == hash;
+}
+
+// Called with resident = 0 before a load starts, so an interrupted load is never trusted
+static void haru_ref_state_update(haru_t *haru, uint32_t size, uint64_t hash, int resident) {
+    const char *state_file = HARU_REF_STATE_FILE;
+    if (state_file == NULL) {
+        return;
+    }
+    if (!resident) {
+        remove(state_file);
+        return;
+    }
+
+    FILE *fp = fopen(state_file, "w");
+    if (fp == NULL) {
+        HARU_LOG("Could not record the resident reference in %s", state_file);
+        return;
+    }
+    fprintf(fp, "%08x %u %016llx\n", haru_get_version(haru), size, (unsigned long long) hash);
+    fclose(fp);
+}
+
+// Puts the cores back into query mode over the resident reference
+static void haru_ref_reuse(haru_t *haru) {
+    dtw_accel_reset(&haru->dtw_accel);
+    dtw_accel_set_mode(&haru->dtw_accel, DTW_ACCEL_MODE_QUERY);
+    dtw_accel_run(&haru->dtw_accel);
+}
+
+// Longest reference the design holds, within the source buffer
+static uint32_t haru_ref_max_size(haru_t *haru) {
+    uint32_t ref_size = dtw_accel_get_ref_size(&haru->dtw_accel);
+    return (ref_size < HARU_REF_MAX_SIZE) ? ref_size : HARU_REF_MAX_SIZE;
+}
+
 int32_t haru_load_reference(haru_t *haru, int32_t *ref, uint32_t size) {
+    uint32_t max_size = haru_ref_max_size(haru);
+    if (size > max_size) {
+        HARU_ERROR("Reference of %d samples exceeds the reference memory (%d samples).", size, max_size);
+        return -1;
+    }
+
+    // Already on chip
+    uint64_t hash = haru_ref_hash(ref, size);
+    if (haru_ref_resident(haru, size, hash)) {
+        haru_ref_reuse(haru);
+        return 1;
+    }
+    haru_ref_state_update(haru, size, hash, 0);
 
     // Reset dtw_accel
     dtw_accel_reset(&haru->dtw_accel);
@@ -130,22 +334,37 @@ int32_t haru_load_reference(haru_t *haru, int32_t *ref, uint32_t size) {
     dtw_accel_set_ref_len(&haru->dtw_accel, size);
     dtw_accel_run(&haru->dtw_accel);
 
-    uint32_t size_left = size;
-    int32_t *curr_ref = ref;
-    while (size_left > 0) {
-        uint32_t transfer_size = size_left < HARU_AXIS_BATCH_MAX_SIZE ? size_left : HARU_AXIS_BATCH_MAX_SIZE;
-        memset((void *) haru->axi_dma.v_src_addr, 0, 0xffff);
-        memcpy((void *) haru->axi_dma.v_src_addr, (void *) curr_ref, transfer_size * sizeof(int32_t));
-        axi_dma_mm2s_transfer(&haru->axi_dma, (transfer_size) * sizeof(int32_t));
-        
-        size_left -= transfer_size;
-        curr_ref += transfer_size;
-    }
+    // Stage the whole reference once and stream it without resetting the engine in between
+    memcpy((void *) haru->axi_dma.v_src_addr, (void *) ref, size * sizeof(int32_t));
+    axi_dma_mm2s_stream(&haru->axi_dma, size * sizeof(int32_t));
+
     // fprintf(stderr, "ref_addr: %d\n", dtw_accel_addrw_ref(&haru->dtw_accel));
-    return dtw_accel_ref_load_done(&haru->dtw_accel);
+    uint32_t done = dtw_accel_ref_load_done(&haru->dtw_accel);
+    haru_ref_state_update(haru, size, hash, done);
+    return done;
 }
 
 int32_t haru_multi_accel_load_reference(haru_t *haru, int32_t *ref, uint32_t size) {
+    uint32_t max_size = haru_ref_max_size(haru);
+    if (size > max_size) {
+        HARU_ERROR("Reference of %d samples exceeds the reference memory (%d samples).", size, max_size);
+        return -1;
+    }
+    // The reference is staged over the query slots
+    if (haru->async.in_flight || haru->async.acquired) {
+        HARU_ERROR("%s", "Asynchronous query slots are still in use.");
+        return -1;
+    }
+    // REG_STRAND outlives the reference that set it, a plain reference has one strand
+    dtw_accel_set_strand(&haru->dtw_accel, 0);
+
+    // Already on chip
+    uint64_t hash = haru_ref_hash(ref, size);
+    if (haru_ref_resident(haru, size, hash)) {
+        haru_ref_reuse(haru);
+        return 1;
+    }
+    haru_ref_state_update(haru, size, hash, 0);
 
     // Reset dtw_accel
     dtw_accel_reset(&haru->dtw_accel);
@@ -153,53 +372,393 @@ int32_t haru_multi_accel_load_reference(haru_t *haru, int32_t *ref, uint32_t siz
     dtw_accel_set_ref_len(&haru->dtw_accel, size);
     dtw_accel_run(&haru->dtw_accel);
 
-    // Transfer reference with one channel
-    uint32_t size_left = size;
-    int32_t *curr_ref = ref;
-    int res;
-    axi_mcdma_channel_init(&haru->axi_mcdma, 0, 0, 0, 0xffff);
-    while (size_left > 0) {
-        uint32_t transfer_size = size_left < HARU_AXIS_BATCH_MAX_SIZE ? size_left : HARU_AXIS_BATCH_MAX_SIZE;
-        // Copy reference to buffer
-        memset((void *) haru->axi_mcdma.v_buffer_src_addr, 0, 0xffff);
-        memcpy((void *) haru->axi_mcdma.v_buffer_src_addr, (void *) curr_ref, transfer_size * sizeof(int32_t));
-
-        // Set up channel and buffer descriptor
-        axi_mcdma_mm2s_bd_init(&haru->axi_mcdma, 0, (transfer_size) * sizeof(int32_t), 0);
-        // axi_mcdma_haru_query_transfer(&haru->axi_mcdma, 0, (transfer_size) * sizeof(int32_t), (transfer_size) * sizeof(int32_t));
-        res = axi_mcdma_mm2s_transfer(&haru->axi_mcdma);
-        if (res) {
-            HARU_ERROR("%s", "Could not complete reference load.");
-            return -1;
-        }
-
-        size_left -= transfer_size;
-        curr_ref += transfer_size;
+    // Copy the whole reference to the buffer and send it through channel 0 as one packet,
+    // described by a single buffer descriptor chain
+    memcpy((void *) haru->axi_mcdma.v_buffer_src_addr, (void *) ref, size * sizeof(int32_t));
+    if (axi_mcdma_mm2s_packet_enqueue(&haru->axi_mcdma, 0, 0, size * sizeof(int32_t)) < 0 ||
+        axi_mcdma_mm2s_transfer(&haru->axi_mcdma)) {
+        HARU_ERROR("%s", "Could not complete reference load.");
+        return -1;
     }
+
     // fprintf(stderr, "ref_addr: %d\n", dtw_accel_addrw_ref(&haru->dtw_accel));
-    return dtw_accel_ref_load_done(&haru->dtw_accel);
+    uint32_t done = dtw_accel_ref_load_done(&haru->dtw_accel);
+    haru_ref_state_update(haru, size, hash, done);
+    return done;
+}
+
+/*
+ * Loads the forward strand fwd and the reverse complement rev of a reference
+ * back to back and searches both in one pass: the cores restart the alignment at
+ * the first word of rev, so no hit spans the two strands. Positions on rev have
+ * bit 31 set and count from the start of rev like positions on fwd do (see
+ * DTW_ACCEL_POSITION_STRAND). Returns like haru_multi_accel_load_reference.
+ */
+int32_t haru_load_reference_strands(haru_t *haru, const int32_t *fwd, uint32_t fwd_size, const int32_t *rev, uint32_t rev_size) {
+    uint32_t max_size = haru_ref_max_size(haru);
+    if (fwd_size == 0 || rev_size == 0 || fwd_size > max_size || rev_size > max_size - fwd_size) {
+        HARU_ERROR("Strands of %u and %u samples do not fit the reference memory (%u samples).", fwd_size, rev_size, max_size);
+        return -1;
+    }
+
+    int32_t *ref = (int32_t *) malloc((fwd_size + rev_size) * sizeof(int32_t));
+    if (ref == NULL) {
+        HARU_ERROR("%s", "Could not allocate the reference.");
+        return -1;
+    }
+    memcpy(ref, fwd, fwd_size * sizeof(int32_t));
+    memcpy(ref + fwd_size, rev, rev_size * sizeof(int32_t));
+    int32_t ret = haru_multi_accel_load_reference(haru, ref, fwd_size + rev_size);
+    free(ref);
+    if (ret <= 0) {
+        return ret;
+    }
+
+    if (dtw_accel_set_strand(&haru->dtw_accel, fwd_size)) {
+        HARU_ERROR("Two strands not supported by this design (version 0x%08x).", haru_get_version(haru));
+        return -1;
+    }
+    return ret;
 }
 
 void haru_process_query(haru_t *haru, int32_t *query, uint32_t size, search_result_t *results) {
-    // Copy query into src buffer
-    memset((void *)haru->axi_dma.v_src_addr, 0, 0xffff);
+    // Copy query into src buffer, only the transferred bytes are touched
     memcpy(haru->axi_dma.v_src_addr, query, size * sizeof(int32_t));
-    memset(haru->axi_dma.v_dst_addr, 0, 0xffff);
 
     dtw_accel_set_mode(&haru->dtw_accel, DTW_ACCEL_MODE_QUERY);
     axi_dma_haru_query_transfer(&haru->axi_dma, size * sizeof(int32_t), sizeof(search_result_t));
     memcpy(results, haru->axi_dma.v_dst_addr, sizeof(search_result_t));
 }
 
-void haru_multi_accel_process_query(haru_t *haru, int32_t *query, uint32_t size, search_result_t *results) {
-    // Copy query into src buffer
-    memset((void *)haru->axi_mcdma.v_buffer_src_addr, 0, 0xffff);
+/*
+ * Runs one query on core 0. The query goes through async slot 0 and channel 0,
+ * so it is refused (-1) while asynchronous slots are acquired or in flight.
+ * Returns -1 if the transfer fails.
+ */
+int haru_multi_accel_process_query(haru_t *haru, int32_t *query, uint32_t size, search_result_t *results) {
+    if (haru->async.in_flight || haru->async.acquired) {
+        HARU_ERROR("%s", "Asynchronous query slots are still in use.");
+        return -1;
+    }
+
+    // Copy query into src buffer, only the transferred bytes are touched
     memcpy(haru->axi_mcdma.v_buffer_src_addr, query, size * sizeof(int32_t));
-    memset(haru->axi_mcdma.v_buffer_dst_addr, 0, 0xffff);
 
     dtw_accel_set_mode(&haru->dtw_accel, DTW_ACCEL_MODE_QUERY);
-    axi_mcdma_haru_query_transfer(&haru->axi_mcdma, 0, size * sizeof(int32_t), sizeof(search_result_t));
+    // The best hit leads a top-K packet, so the packet starts with a search_result_t either way
+    if (axi_mcdma_haru_query_transfer(&haru->axi_mcdma, 0, size * sizeof(int32_t), DTW_ACCEL_HITS_WORDS(haru->n_hits) * sizeof(uint32_t))) {
+        HARU_ERROR("%s", "Query failed.");
+        return -1;
+    }
     memcpy(results, haru->axi_mcdma.v_buffer_dst_addr, sizeof(search_result_t));
+    return 0;
+}
+
+/*
+ * Runs one query on core 0 and returns its haru->n_hits best non-overlapping
+ * hits (see haru_set_hits), best first. Hits the core did not find have
+ * position 0 and score DTW_ACCEL_MAX_SCORE, as do the entries past
+ * n_hits. Returns -1 if the transfer fails, or while asynchronous slots are
+ * acquired or in flight (the query uses slot 0 and channel 0).
+ */
+int haru_process_query_hits(haru_t *haru, const int32_t *query, uint32_t size, search_hits_t *hits) {
+    if (haru->async.in_flight || haru->async.acquired) {
+        HARU_ERROR("%s", "Asynchronous query slots are still in use.");
+        return -1;
+    }
+
+    memcpy(haru->axi_mcdma.v_buffer_src_addr, query, size * sizeof(int32_t));
+
+    dtw_accel_set_mode(&haru->dtw_accel, DTW_ACCEL_MODE_QUERY);
+    uint32_t words = DTW_ACCEL_HITS_WORDS(haru->n_hits);
+    if (axi_mcdma_haru_query_transfer(&haru->axi_mcdma, 0, size * sizeof(int32_t), words * sizeof(uint32_t))) {
+        HARU_ERROR("%s", "Query failed.");
+        return -1;
+    }
+    memcpy(hits, haru->axi_mcdma.v_buffer_dst_addr, words * sizeof(uint32_t));
+    for (uint32_t i = haru->n_hits; i < DTW_ACCEL_HITS_MAX; i++) {
+        hits->hits[i].position = 0;
+        hits->hits[i].score = DTW_ACCEL_MAX_SCORE;
+    }
+    return 0;
+}
+
+/*
+ * Packs as many queries as fit into the source buffer, queues one mm2s/s2mm buffer
+ * descriptor per query on the channels' rings and moves the whole batch with one
+ * chain transfer. Queries are dealt round robin over the channels so every core
+ * works on the batch at the same time.
+ * Results land at consecutive search_result_t slots in the destination buffer.
+ */
+static int haru_process_query_batch(haru_t *haru, const int32_t **queries, const uint32_t *lens, size_t n, search_result_t *out) {
+    uint32_t src_offset = 0;
+    uint32_t channel_mask = 0;
+    for (size_t i = 0; i < n; i++) {
+        int channel_idx = i % haru->num_accel;
+        uint32_t src_size = lens[i] * sizeof(int32_t);
+        memcpy((uint8_t *) haru->axi_mcdma.v_buffer_src_addr + src_offset, queries[i], src_size);
+
+        if (axi_mcdma_s2mm_bd_enqueue(&haru->axi_mcdma, channel_idx, i * sizeof(search_result_t), sizeof(search_result_t)) < 0 ||
+            axi_mcdma_mm2s_bd_enqueue(&haru->axi_mcdma, channel_idx, src_offset, src_size, 1, 1) < 0) {
+            // Drop the descriptors queued so far, a later transfer would otherwise pair them with its own
+            HARU_ERROR("Batch of %ld queries could not be queued.", (long) n);
+            axi_mcdma_recover(&haru->axi_mcdma);
+            return -1;
+        }
+        channel_mask |= 1 << channel_idx;
+        src_offset += src_size;
+    }
+
+    if (axi_mcdma_haru_chain_transfer_channels(&haru->axi_mcdma, channel_mask)) {
+        HARU_ERROR("Batch of %ld queries failed.", (long) n);
+        return -1;
+    }
+
+    memcpy(out, haru->axi_mcdma.v_buffer_dst_addr, n * sizeof(search_result_t));
+    return 0;
+}
+
+int haru_process_queries(haru_t *haru, const int32_t **queries, const uint32_t *lens, size_t n, search_result_t *out) {
+    if (haru->async.in_flight || haru->async.acquired) {
+        HARU_ERROR("%s", "Asynchronous query slots are still in use.");
+        return -1;
+    }
+    if (haru->n_hits > 1) {
+        HARU_ERROR("%u hits per result, use haru_process_query_hits.", haru->n_hits);
+        return -1;
+    }
+    dtw_accel_set_mode(&haru->dtw_accel, DTW_ACCEL_MODE_QUERY);
+
+    size_t start = 0;
+    while (start < n) {
+        // Grow the batch until the source buffer or the descriptor budget is full
+        size_t count = 0;
+        uint32_t bytes = 0;
+        while (start + count < n && count < HARU_BATCH_MAX_QUERIES * haru->num_accel) {
+            uint32_t query_bytes = lens[start + count] * sizeof(int32_t);
+            if (query_bytes > HARU_AXIS_BATCH_MAX_SIZE * sizeof(int32_t)) {
+                HARU_ERROR("Query %ld is too long (%d samples).", (long) (start + count), lens[start + count]);
+                return -1;
+            }
+            if (query_bytes == 0) {
+                // A zero length mm2s descriptor stops the engine with an SG error
+                HARU_ERROR("Query %ld is empty.", (long) (start + count));
+                return -1;
+            }
+            if (bytes + query_bytes > HARU_AXI_BUFFER_SIZE) {
+                break;
+            }
+            bytes += query_bytes;
+            count++;
+        }
+
+        if (haru_process_query_batch(haru, queries + start, lens + start, count, out + start)) {
+            return -1;
+        }
+        start += count;
+    }
+    return 0;
+}
+
+/*
+ * Lends the caller a free slot of the source buffer so a query can be built in
+ * place, straight in DMA memory, instead of being copied there by haru_submit.
+ * The slot is HARU_QUERY_SLOT_SIZE bytes: word 0 is the qid, which the driver
+ * overwrites, and the samples follow. "slot_id" receives the handle to pass to
+ * haru_submit_slot, or to haru_release_query_slot to give the slot back unused.
+ * Returns NULL if every slot is acquired or in flight.
+ */
+int32_t *haru_acquire_query_slot(haru_t *haru, uint32_t *slot_id) {
+    haru_async_t *async = &haru->async;
+
+    for (uint32_t i = 0; i < HARU_ASYNC_SLOTS; i++) {
+        uint32_t slot = (async->next_slot + i) % HARU_ASYNC_SLOTS;
+        if (async->slots[slot].state == HARU_SLOT_FREE) {
+            async->slots[slot].state = HARU_SLOT_ACQUIRED;
+            async->acquired++;
+            async->next_slot = (slot + 1) % HARU_ASYNC_SLOTS;
+            *slot_id = slot;
+            return (int32_t *) ((uint8_t *) haru->axi_mcdma.v_buffer_src_addr + slot * HARU_QUERY_SLOT_SIZE);
+        }
+    }
+    return NULL;
+}
+
+void haru_release_query_slot(haru_t *haru, uint32_t slot_id) {
+    haru_async_t *async = &haru->async;
+
+    if (slot_id < HARU_ASYNC_SLOTS && async->slots[slot_id].state == HARU_SLOT_ACQUIRED) {
+        async->slots[slot_id].state = HARU_SLOT_FREE;
+        async->acquired--;
+    }
+}
+
+/*
+ * Queues the query of "size" words written into an acquired slot without
+ * waiting for its result. Its first word (qid) is replaced by a driver
+ * generated id, which the accelerator echoes back in the result so the result
+ * can be matched to "tag" by haru_poll_completions. The query goes to the core
+ * with the fewest queries in flight. Returns -1 if the slot is not acquired or
+ * the query does not fit in it; the slot then stays with the caller.
+ */
+int haru_submit_slot(haru_t *haru, uint32_t slot_id, uint32_t size, uint64_t tag) {
+    haru_async_t *async = &haru->async;
+
+    if (slot_id >= HARU_ASYNC_SLOTS || async->slots[slot_id].state != HARU_SLOT_ACQUIRED) {
+        HARU_ERROR("Query slot %d is not acquired.", slot_id);
+        return -1;
+    }
+    if (haru->n_hits > 1) {
+        HARU_ERROR("%u hits per result, use haru_process_query_hits.", haru->n_hits);
+        return -1;
+    }
+    if (size * sizeof(int32_t) > HARU_QUERY_SLOT_SIZE) {
+        HARU_ERROR("Query is too long (%d words).", size);
+        return -1;
+    }
+
+    uint32_t qid = (async->seq++ << HARU_ASYNC_QID_SLOT_BITS) | slot_id;
+    uint32_t src_offset = slot_id * HARU_QUERY_SLOT_SIZE;
+    int32_t *src = (int32_t *) ((uint8_t *) haru->axi_mcdma.v_buffer_src_addr + src_offset);
+    src[0] = qid;
+
+    uint32_t channel_idx = 0;
+    for (uint32_t i = 1; i < haru->num_accel; i++) {
+        if (async->channel_in_flight[i] < async->channel_in_flight[channel_idx]) {
+            channel_idx = i;
+        }
+    }
+
+    // Each channel has its own result area, filled in the order its core finishes, one result per s2mm descriptor
+    axi_mcdma_channel_t *channel = haru->axi_mcdma.channels[channel_idx];
+    uint32_t dst_offset = (channel_idx * AXI_MCDMA_BD_RING_SIZE + channel->s2mm_ring.prod % AXI_MCDMA_BD_RING_SIZE) * sizeof(search_result_t);
+    if (axi_mcdma_s2mm_bd_enqueue(&haru->axi_mcdma, channel_idx, dst_offset, sizeof(search_result_t)) < 0) {
+        return -1;
+    }
+    if (axi_mcdma_mm2s_bd_enqueue(&haru->axi_mcdma, channel_idx, src_offset, size * sizeof(int32_t), 1, 1) < 0) {
+        // Otherwise the result of the next query on this channel lands in the lone s2mm descriptor
+        axi_mcdma_s2mm_bd_cancel(&haru->axi_mcdma, channel_idx);
+        return -1;
+    }
+
+    if (async->in_flight == 0) {
+        dtw_accel_set_mode(&haru->dtw_accel, DTW_ACCEL_MODE_QUERY);
+    }
+    async->slots[slot_id].tag = tag;
+    async->slots[slot_id].qid = qid;
+    async->slots[slot_id].state = HARU_SLOT_IN_FLIGHT;
+    async->slots[slot_id].channel = channel_idx;
+    async->acquired--;
+    async->in_flight++;
+    async->channel_in_flight[channel_idx]++;
+
+    mcdma_s2mm_program_tail_bd(&haru->axi_mcdma, channel_idx);
+    mcdma_mm2s_program_tail_bd(&haru->axi_mcdma, channel_idx);
+    return 0;
+}
+
+/*
+ * Copying counterpart of haru_acquire_query_slot + haru_submit_slot for queries
+ * that already live in host memory. Returns -1 if all slots are in use or the
+ * query does not fit in a slot.
+ */
+int haru_submit(haru_t *haru, const int32_t *query, uint32_t size, uint64_t tag) {
+    if (size * sizeof(int32_t) > HARU_QUERY_SLOT_SIZE) {
+        HARU_ERROR("Query is too long (%d words).", size);
+        return -1;
+    }
+
+    uint32_t slot_id;
+    int32_t *src = haru_acquire_query_slot(haru, &slot_id);
+    if (src == NULL) {
+        return -1;
+    }
+    memcpy(src, query, size * sizeof(int32_t));
+
+    if (haru_submit_slot(haru, slot_id, size, tag)) {
+        haru_release_query_slot(haru, slot_id);
+        return -1;
+    }
+    return 0;
+}
+
+// Recovers the engine and drops every query in flight. Slots lent out with
+// haru_acquire_query_slot stay with the caller. The cores are reset too, or the
+// queries already in their source FIFOs and shadow buffers would still send
+// results, which would land on the descriptors of the next queries.
+static void haru_async_drop(haru_t *haru) {
+    haru_async_t *async = &haru->async;
+
+    HARU_ERROR("%s", "Dropping queries in flight.");
+    // Stopped cores stay idle and keep their source FIFOs clear until they run again
+    dtw_accel_reset(&haru->dtw_accel);
+    axi_mcdma_recover(&haru->axi_mcdma);
+    dtw_accel_set_mode(&haru->dtw_accel, DTW_ACCEL_MODE_QUERY);
+    dtw_accel_run(&haru->dtw_accel);
+    for (uint32_t slot = 0; slot < HARU_ASYNC_SLOTS; slot++) {
+        if (async->slots[slot].state == HARU_SLOT_IN_FLIGHT) {
+            async->slots[slot].state = HARU_SLOT_FREE;
+        }
+    }
+    async->in_flight = 0;
+    memset(async->channel_in_flight, 0, sizeof(async->channel_in_flight));
+}
+
+/*
+ * Collects up to "max" finished queries without blocking. Each completion
+ * carries the tag given to haru_submit and the result (whose qid is the driver
+ * generated one). Completions of one core come back in the order it finishes
+ * them; the cores are visited starting from a different one on every call.
+ * Returns the number of completions written to "out", or -1 on a DMA error or a
+ * result with an unknown qid, in which case every query in flight is dropped.
+ */
+int haru_poll_completions(haru_t *haru, haru_completion_t *out, int max) {
+    haru_async_t *async = &haru->async;
+
+    if (async->in_flight == 0) {
+        return 0;
+    }
+
+    int n = 0;
+    for (uint32_t k = 0; k < haru->num_accel && n < max; k++) {
+        uint32_t channel_idx = (async->next_poll + k) % haru->num_accel;
+        axi_mcdma_channel_t *channel = haru->axi_mcdma.channels[channel_idx];
+        if (async->channel_in_flight[channel_idx] == 0) {
+            continue;
+        }
+
+        uint32_t first = channel->s2mm_ring.cons;
+        int done = axi_mcdma_s2mm_bd_reclaim_max(&haru->axi_mcdma, channel_idx, max - n);
+        if (done < 0 || axi_mcdma_mm2s_bd_reclaim(&haru->axi_mcdma, channel_idx) < 0) {
+            haru_async_drop(haru);
+            return -1;
+        }
+
+        for (int i = 0; i < done; i++) {
+            uint32_t dst_offset = (channel_idx * AXI_MCDMA_BD_RING_SIZE + (first + i) % AXI_MCDMA_BD_RING_SIZE) * sizeof(search_result_t);
+            search_result_t result;
+            memcpy(&result, (uint8_t *) haru->axi_mcdma.v_buffer_dst_addr + dst_offset, sizeof(search_result_t));
+
+            uint32_t slot = result.qid & ((1 << HARU_ASYNC_QID_SLOT_BITS) - 1);
+            if (slot >= HARU_ASYNC_SLOTS || async->slots[slot].state != HARU_SLOT_IN_FLIGHT || async->slots[slot].qid != result.qid ||
+                async->slots[slot].channel != channel_idx) {
+                // Its descriptor is reclaimed, so the slot it was queued for would never complete
+                HARU_ERROR("Result with unknown qid (0x%08x) on channel %u.", result.qid, channel_idx);
+                haru_async_drop(haru);
+                return -1;
+            }
+
+            out[n].tag = async->slots[slot].tag;
+            out[n].result = result;
+            out[n].core = channel_idx;
+            n++;
+            async->slots[slot].state = HARU_SLOT_FREE;
+            async->in_flight--;
+            async->channel_in_flight[channel_idx]--;
+        }
+    }
+    async->next_poll = (async->next_poll + 1) % haru->num_accel;
+    return n;
 }
 
 void haru_multi_accel_free(haru_t *haru) {
@@ -0,0 +1,290 @@
+/* MIT License
+
+Copyright (c) 2022 Po Jui Shih
+Copyright (c) 2022 Hassaan Saadat
+Copyright (c) 2022 Sri Parameswaran
+Copyright (c) 2022 Hasindu Gamaarachchi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "haru_sched.h"
+#include "misc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t haru_sched_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void haru_sched_ewma(uint64_t *avg, uint64_t sample) {
+    if (*avg == 0) {
+        *avg = sample;
+    } else {
+        *avg = *avg - (*avg >> HARU_SCHED_EWMA_SHIFT) + (sample >> HARU_SCHED_EWMA_SHIFT);
+    }
+}
+
+/*
+ * Routing, called with the lock held. An engine finishes a read after its
+ * backlog and the read itself: (backlog / servers + 1) * service time. Until
+ * both service times are measured every engine takes work.
+ */
+static int haru_sched_fpga_should_take(const haru_sched_t *sched) {
+    if (sched->haru == NULL || sched->count == 0 ||
+        sched->fpga_in_flight >= HARU_SCHED_FPGA_DEPTH * sched->haru->num_accel || sched->fpga_in_flight >= HARU_ASYNC_SLOTS) {
+        return 0;
+    }
+    if (sched->n_workers == 0 || sched->fpga_in_flight == 0 || sched->fpga_ns == 0 || sched->cpu_ns == 0) {
+        return 1;
+    }
+
+    // The head of the queue, the CPU gets to it after the reads behind it
+    uint64_t num_accel = sched->haru->num_accel;
+    uint64_t fpga_eta = (sched->fpga_in_flight + num_accel) * sched->fpga_ns * sched->n_workers;
+    uint64_t cpu_eta = (sched->cpu_busy + sched->count - 1 + sched->n_workers) * sched->cpu_ns * num_accel;
+    return fpga_eta <= cpu_eta;
+}
+
+static int haru_sched_cpu_should_take(const haru_sched_t *sched) {
+    if (sched->count == 0) {
+        return 0;
+    }
+    if (sched->haru == NULL || sched->fpga_ns == 0 || sched->cpu_ns == 0) {
+        return 1;
+    }
+
+    // The tail of the queue on an idle worker, the FPGA gets to it after all reads in front
+    uint64_t num_accel = sched->haru->num_accel;
+    uint64_t fpga_eta = (sched->fpga_in_flight + sched->count - 1 + num_accel) * sched->fpga_ns;
+    uint64_t cpu_eta = sched->cpu_ns * num_accel;
+    return cpu_eta <= fpga_eta;
+}
+
+// Hands reads from the head of the queue to the DTW cores, called with the lock held
+static void haru_sched_pump(haru_sched_t *sched) {
+    while (haru_sched_fpga_should_take(sched)) {
+        uint32_t i = 0;
+        while (i < HARU_ASYNC_SLOTS && sched->fpga_used[i]) {
+            i++;
+        }
+        haru_sched_job_t *job = &sched->queue[sched->head];
+        if (i == HARU_ASYNC_SLOTS || haru_submit(sched->haru, job->query, dtw_sw_query_words(sched->sw), i)) {
+            break;
+        }
+
+        sched->fpga_jobs[i] = *job;
+        sched->fpga_jobs[i].start_ns = haru_sched_now_ns();
+        sched->fpga_used[i] = 1;
+        sched->fpga_in_flight++;
+        sched->head = (sched->head + 1) % HARU_SCHED_QUEUE_SIZE;
+        sched->count--;
+    }
+}
+
+static void *haru_sched_worker(void *arg) {
+    haru_sched_t *sched = (haru_sched_t *) arg;
+    haru_sched_job_t job;
+
+    pthread_mutex_lock(&sched->lock);
+    while (1) {
+        while (!sched->stop && !haru_sched_cpu_should_take(sched)) {
+            pthread_cond_wait(&sched->work, &sched->lock);
+        }
+        if (sched->stop) {
+            break;
+        }
+        job = sched->queue[(sched->head + sched->count - 1) % HARU_SCHED_QUEUE_SIZE];
+        sched->count--;
+        sched->cpu_busy++;
+        pthread_mutex_unlock(&sched->lock);
+
+        search_result_t result;
+        uint64_t start_ns = haru_sched_now_ns();
+        dtw_sw_process_query(sched->sw, HARU_SCHED_SW_CORE, job.query, dtw_sw_query_words(sched->sw), &result);
+        uint64_t end_ns = haru_sched_now_ns();
+
+        pthread_mutex_lock(&sched->lock);
+        sched->cpu_busy--;
+        sched->cpu_reads++;
+        haru_sched_ewma(&sched->cpu_ns, end_ns - start_ns);
+        haru_completion_t *done = &sched->done[(sched->done_head + sched->done_count) % HARU_SCHED_QUEUE_SIZE];
+        done->tag = job.tag;
+        done->result = result;
+        done->core = HARU_SCHED_CPU_CORE;
+        sched->done_count++;
+    }
+    pthread_mutex_unlock(&sched->lock);
+    return NULL;
+}
+
+/*
+ * Init and release functions. haru (set up with haru_multi_accel_init) and sw
+ * must hold the same reference; either side may be left out with haru = NULL
+ * or n_workers = 0. sw is needed either way, it sets the query length.
+ */
+int haru_sched_init(haru_sched_t *sched, haru_t *haru, const dtw_sw_t *sw, uint32_t n_workers) {
+    if (haru == NULL && n_workers == 0) {
+        HARU_ERROR("%s", "Scheduler without DTW cores or CPU workers.");
+        return -1;
+    }
+    if (sw == NULL) {
+        HARU_ERROR("%s", "Scheduler without the software model.");
+        return -1;
+    }
+
+    memset(sched, 0, sizeof(haru_sched_t));
+    sched->haru = haru;
+    sched->sw = sw;
+    pthread_mutex_init(&sched->lock, NULL);
+    pthread_cond_init(&sched->work, NULL);
+
+    sched->queue = (haru_sched_job_t *) malloc(HARU_SCHED_QUEUE_SIZE * sizeof(haru_sched_job_t));
+    sched->done = (haru_completion_t *) malloc(HARU_SCHED_QUEUE_SIZE * sizeof(haru_completion_t));
+    sched->workers = (pthread_t *) calloc(n_workers + 1, sizeof(pthread_t));
+    HARU_MALLOC_CHK(sched->queue);
+    HARU_MALLOC_CHK(sched->done);
+    HARU_MALLOC_CHK(sched->workers);
+    if (sched->queue == NULL || sched->done == NULL || sched->workers == NULL) {
+        haru_sched_release(sched);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < n_workers; i++) {
+        if (pthread_create(&sched->workers[i], NULL, haru_sched_worker, sched)) {
+            HARU_ERROR("Failed to start CPU worker %d.", i);
+            haru_sched_release(sched);
+            return -1;
+        }
+        sched->n_workers++;
+    }
+    return 0;
+}
+
+/*
+ * Stops the CPU workers. Reads that are still queued are dropped, poll until
+ * every submitted read has completed first.
+ */
+void haru_sched_release(haru_sched_t *sched) {
+    pthread_mutex_lock(&sched->lock);
+    sched->stop = 1;
+    pthread_cond_broadcast(&sched->work);
+    pthread_mutex_unlock(&sched->lock);
+    for (uint32_t i = 0; i < sched->n_workers; i++) {
+        pthread_join(sched->workers[i], NULL);
+    }
+    sched->n_workers = 0;
+
+    pthread_mutex_destroy(&sched->lock);
+    pthread_cond_destroy(&sched->work);
+    free(sched->queue);
+    free(sched->done);
+    free(sched->workers);
+    sched->queue = NULL;
+    sched->done = NULL;
+    sched->workers = NULL;
+}
+
+/*
+ * Queues a read (dtw_sw_query_words(sw) words, as for haru_process_query) and
+ * hands it straight to a DTW core if that is where it finishes first. Returns
+ * -1 if HARU_SCHED_QUEUE_SIZE reads are already waiting for haru_sched_poll.
+ */
+int haru_sched_submit(haru_sched_t *sched, const int32_t *query, uint32_t size, uint64_t tag) {
+    if (size != dtw_sw_query_words(sched->sw)) {
+        HARU_ERROR("Query of %d words, the cores take %d.", size, dtw_sw_query_words(sched->sw));
+        return -1;
+    }
+
+    pthread_mutex_lock(&sched->lock);
+    if (sched->count + sched->cpu_busy + sched->done_count + sched->fpga_in_flight >= HARU_SCHED_QUEUE_SIZE) {
+        pthread_mutex_unlock(&sched->lock);
+        return -1;
+    }
+    haru_sched_job_t *job = &sched->queue[(sched->head + sched->count) % HARU_SCHED_QUEUE_SIZE];
+    job->tag = tag;
+    memcpy(job->query, query, size * sizeof(int32_t));
+    sched->count++;
+
+    haru_sched_pump(sched);
+    pthread_cond_broadcast(&sched->work);
+    pthread_mutex_unlock(&sched->lock);
+    return 0;
+}
+
+/*
+ * Collects up to "max" finished reads from both sides without blocking and
+ * keeps the DTW cores fed. Completions of the CPU carry HARU_SCHED_CPU_CORE.
+ * Reads dropped by a DMA error are queued again. Returns the number of
+ * completions written to "out".
+ */
+int haru_sched_poll(haru_sched_t *sched, haru_completion_t *out, int max) {
+    int n = 0;
+
+    pthread_mutex_lock(&sched->lock);
+    while (n < max && sched->done_count > 0) {
+        out[n++] = sched->done[sched->done_head];
+        sched->done_head = (sched->done_head + 1) % HARU_SCHED_QUEUE_SIZE;
+        sched->done_count--;
+    }
+
+    if (sched->haru != NULL && sched->fpga_in_flight > 0 && n < max) {
+        int got = haru_poll_completions(sched->haru, out + n, max - n);
+        if (got < 0) {
+            for (uint32_t i = 0; i < HARU_ASYNC_SLOTS; i++) {
+                if (sched->fpga_used[i]) {
+                    sched->head = (sched->head + HARU_SCHED_QUEUE_SIZE - 1) % HARU_SCHED_QUEUE_SIZE;
+                    sched->queue[sched->head] = sched->fpga_jobs[i];
+                    sched->count++;
+                    sched->fpga_used[i] = 0;
+                }
+            }
+            sched->fpga_in_flight = 0;
+            got = 0;
+        }
+
+        // A core serves a read from when it got it or finished the one before, whichever is later
+        uint64_t now_ns = haru_sched_now_ns();
+        for (int i = 0; i < got; i++) {
+            haru_completion_t *c = &out[n + i];
+            haru_sched_job_t *job = &sched->fpga_jobs[c->tag];
+            uint64_t start_ns = job->start_ns;
+            if (sched->fpga_last_done_ns[c->core] > start_ns) {
+                start_ns = sched->fpga_last_done_ns[c->core];
+            }
+            haru_sched_ewma(&sched->fpga_ns, now_ns - start_ns);
+            sched->fpga_last_done_ns[c->core] = now_ns;
+
+            sched->fpga_used[c->tag] = 0;
+            c->tag = job->tag;
+            sched->fpga_in_flight--;
+            sched->fpga_reads++;
+        }
+        n += got;
+    }
+
+    haru_sched_pump(sched);
+    pthread_cond_broadcast(&sched->work);
+    pthread_mutex_unlock(&sched->lock);
+    return n;
+}
@@ -25,7 +25,14 @@ SOFTWARE. */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "haru.h"
+#include "dtw_sw.h"
+#include "dtw_sw_shard.h"
+#include "dtw_sw_stream.h"
+#include "haru_sched.h"
 
 void test_dtw_accel_key() {
     printf("==================================\n");
@@ -76,6 +83,1095 @@ void test_dtw_accel_reset() {
     dma_s2mm_reset(&haru.axi_dma);
 
     printf("[test_dtw_accel_reset] Status\n");
-    haru_print_status(&haru);
+    dma_mm2s_status(&haru.axi_dma);
+    dma_s2mm_status(&haru.axi_dma);
     haru_release(&haru);
-}
\ No newline at end of file
+}
+
+typedef struct {
+    uio_irq_t *irq;
+    volatile int done;
+} test_irq_ctx_t;
+
+static int test_irq_done(void *arg) {
+    return ((test_irq_ctx_t *) arg)->done;
+}
+
+// Stands in for the DMA: finishes the "transfer" and raises the interrupt
+static void *test_irq_raise(void *arg) {
+    test_irq_ctx_t *ctx = (test_irq_ctx_t *) arg;
+    usleep(10000);
+    ctx->done = 1;
+    uio_irq_signal(ctx->irq);
+    return NULL;
+}
+
+void test_uio_irq_eventfd() {
+    printf("==================================\n");
+    printf("Testing interrupt completion (eventfd)\n");
+    printf("==================================\n");
+    uint8_t modes[] = {UIO_IRQ_MODE_POLL, UIO_IRQ_MODE_IRQ, UIO_IRQ_MODE_HYBRID};
+    for (int i = 0; i < 3; i++) {
+        uio_irq_t irq;
+        if (uio_irq_init_eventfd(&irq, modes[i])) {
+            printf("Error: Failed to create eventfd\n");
+            return;
+        }
+
+        test_irq_ctx_t ctx = {&irq, 0};
+        pthread_t thread;
+        pthread_create(&thread, NULL, test_irq_raise, &ctx);
+        int32_t ret = uio_irq_wait_done(&irq, test_irq_done, &ctx);
+        pthread_join(thread, NULL);
+        uio_irq_release(&irq);
+
+        printf("[test_uio_irq_eventfd] mode %d: %s\n", modes[i], (ret == 0 && ctx.done) ? "passed" : "failed");
+    }
+}
+
+void test_dma_buf_anon() {
+    printf("==================================\n");
+    printf("Testing cache maintenance (anonymous buffer)\n");
+    printf("==================================\n");
+    dma_buf_t buf;
+    if (dma_buf_init(&buf, DMA_BUF_ANON, NULL, 0, 0x1000)) {
+        printf("Error: Failed to allocate buffer\n");
+        return;
+    }
+
+    uint32_t *words = (uint32_t *) buf.v_addr;
+    for (uint32_t i = 0; i < 0x1000 / 4; i++) {
+        words[i] = i;
+    }
+    // Unaligned ranges have to widen to whole cache lines without faulting
+    dma_buf_sync_for_device(&buf, 4, 0x1000 - 8);
+    dma_buf_sync_for_cpu(&buf, 0, 0x1000);
+
+    int passed = 1;
+    for (uint32_t i = 0; i < 0x1000 / 4; i++) {
+        if (words[i] != i) {
+            passed = 0;
+        }
+    }
+    dma_buf_release(&buf);
+
+    printf("[test_dma_buf_anon] %s\n", passed ? "passed" : "failed");
+}
+
+// Same reference and query as test_load_small_query in hdl/test_dut.py, which
+// sends the query to core 1 and expects position 450 and score 0
+void test_dtw_sw_small_query() {
+    printf("==================================\n");
+    printf("Testing software DTW model\n");
+    printf("==================================\n");
+    dtw_sw_t sw;
+    if (dtw_sw_init(&sw)) {
+        printf("Error: Failed to initialize dtw_sw\n");
+        return;
+    }
+
+    int32_t ref[4000];
+    int32_t query[DTW_SW_QUERY_WORDS];
+    for (int i = 0; i < 4000; i++) {
+        ref[i] = i % 1000;
+    }
+    query[0] = 1;
+    query[1] = 0;
+    for (int i = 0; i < DTW_SW_SQG_SIZE; i++) {
+        query[i + 2] = ref[i + 200];
+    }
+    dtw_sw_load_reference(&sw, ref, 4000);
+
+    // Core 0 reads the reference memory one cycle later and reports one position further
+    search_result_t results[2];
+    dtw_sw_process_query(&sw, 0, query, DTW_SW_QUERY_WORDS, &results[0]);
+    dtw_sw_process_query(&sw, 1, query, DTW_SW_QUERY_WORDS, &results[1]);
+    dtw_sw_release(&sw);
+
+    int passed = results[1].qid == 1 && results[1].position == 450 && results[1].score == 0 &&
+                 results[0].qid == 1 && results[0].position == 451 && results[0].score == 0;
+    printf("[test_dtw_sw_small_query] %s\n", passed ? "passed" : "failed");
+}
+
+// The vectorized kernel against the scalar model, on random signals that
+// saturate the PEs and wrap the 16 bit differences
+void test_dtw_sw_simd() {
+    printf("==================================\n");
+    printf("Testing vectorized software DTW\n");
+    printf("==================================\n");
+    dtw_sw_t sw;
+    if (dtw_sw_init(&sw)) {
+        printf("Error: Failed to initialize dtw_sw\n");
+        return;
+    }
+    uint8_t isa = sw.isa;
+    printf("Kernel: %d\n", isa);
+
+    int passed = 1;
+    int32_t ref[3000];
+    int32_t query[DTW_SW_QUERY_WORDS];
+    srand(11);
+    for (int trial = 0; trial < 8 && passed; trial++) {
+        // Every other trial stays in the range where the scores do not saturate
+        int32_t range = (trial & 1) ? 0x10000 : 256;
+        uint32_t size = 1 + rand() % 3000;
+        for (uint32_t i = 0; i < size; i++) {
+            ref[i] = rand() % range;
+        }
+        query[0] = trial;
+        query[1] = 0;
+        for (int i = 0; i < DTW_SW_SQG_SIZE; i++) {
+            query[i + 2] = rand() % range;
+        }
+        dtw_sw_load_reference(&sw, ref, size);
+
+        for (uint32_t core = 0; core < 2; core++) {
+            search_result_t scalar, simd;
+            dtw_sw_set_isa(&sw, DTW_SW_ISA_SCALAR);
+            dtw_sw_process_query(&sw, core, query, DTW_SW_QUERY_WORDS, &scalar);
+            dtw_sw_set_isa(&sw, isa);
+            dtw_sw_process_query(&sw, core, query, DTW_SW_QUERY_WORDS, &simd);
+            if (scalar.qid != simd.qid || scalar.position != simd.position || scalar.score != simd.score) {
+                printf("Error: Reference of %d, core %d: %d/%d, expected %d/%d\n",
+                       size, core, simd.position, simd.score, scalar.position, scalar.score);
+                passed = 0;
+            }
+        }
+    }
+    dtw_sw_release(&sw);
+
+    printf("[test_dtw_sw_simd] %s\n", passed ? "passed" : "failed");
+}
+
+// The batch entry point against one query at a time, with a batch that does
+// not fill the last group of lanes
+void test_dtw_sw_batch() {
+    printf("==================================\n");
+    printf("Testing batched software DTW\n");
+    printf("==================================\n");
+    dtw_sw_t sw;
+    if (dtw_sw_init(&sw)) {
+        printf("Error: Failed to initialize dtw_sw\n");
+        return;
+    }
+
+    int passed = 1;
+    const size_t n = 37;
+    int32_t ref[2000];
+    int32_t query_buf[37][DTW_SW_QUERY_WORDS];
+    const int32_t *queries[37];
+    uint32_t lens[37];
+    search_result_t results[37];
+    srand(13);
+    for (int i = 0; i < 2000; i++) {
+        ref[i] = rand() % 1024;
+    }
+    for (size_t q = 0; q < n; q++) {
+        // Half of the queries are cut from the reference, the other half are noise
+        int32_t start = rand() % (2000 - DTW_SW_SQG_SIZE);
+        query_buf[q][0] = (int32_t) q;
+        query_buf[q][1] = 0;
+        for (int i = 0; i < DTW_SW_SQG_SIZE; i++) {
+            query_buf[q][i + 2] = (q & 1) ? rand() % 0x10000 : ref[start + i];
+        }
+        queries[q] = query_buf[q];
+        lens[q] = DTW_SW_QUERY_WORDS;
+    }
+    dtw_sw_load_reference(&sw, ref, 2000);
+
+    for (uint32_t core = 0; core < 2 && passed; core++) {
+        dtw_sw_process_queries(&sw, core, queries, lens, n, results);
+        for (size_t q = 0; q < n; q++) {
+            search_result_t expected;
+            dtw_sw_process_query(&sw, core, queries[q], lens[q], &expected);
+            if (results[q].qid != expected.qid || results[q].position != expected.position || results[q].score != expected.score) {
+                printf("Error: Query %zu, core %d: %d/%d, expected %d/%d\n",
+                       q, core, results[q].position, results[q].score, expected.position, expected.score);
+                passed = 0;
+            }
+        }
+    }
+    dtw_sw_release(&sw);
+
+    printf("[test_dtw_sw_batch] %s\n", passed ? "passed" : "failed");
+}
+
+// Sharded sweep against the single-threaded one, with the default warm-up and
+// with none, which makes every shard boundary go through the re-sweep
+void test_dtw_sw_shard() {
+    printf("==================================\n");
+    printf("Testing sharded software DTW\n");
+    printf("==================================\n");
+    dtw_sw_t sw;
+    dtw_sw_shard_t shard;
+    if (dtw_sw_init(&sw)) {
+        printf("Error: Failed to initialize dtw_sw\n");
+        return;
+    }
+    if (dtw_sw_shard_init(&shard, &sw, 4)) {
+        printf("Error: Failed to initialize dtw_sw_shard\n");
+        dtw_sw_release(&sw);
+        return;
+    }
+
+    int passed = 1;
+    const uint32_t size = 30000;
+    int32_t *ref = (int32_t *) malloc(size * sizeof(int32_t));
+    int32_t query[DTW_SW_QUERY_WORDS];
+    srand(14);
+    for (uint32_t i = 0; i < size; i++) {
+        ref[i] = rand() % 512;
+    }
+    dtw_sw_load_reference(&sw, ref, size);
+
+    for (int trial = 0; trial < 8 && passed; trial++) {
+        // Alternate between reads cut from the reference and noise
+        uint32_t start = rand() % (size - DTW_SW_SQG_SIZE);
+        query[0] = trial;
+        query[1] = 0;
+        for (int i = 0; i < DTW_SW_SQG_SIZE; i++) {
+            query[i + 2] = (trial & 1) ? rand() % 512 : ref[start + i];
+        }
+        shard.warmup = (trial & 2) ? 0 : DTW_SW_SHARD_WARMUP;
+
+        uint32_t core = (trial >> 2) & 1;
+        search_result_t expected, result;
+        dtw_sw_process_query(&sw, core, query, DTW_SW_QUERY_WORDS, &expected);
+        dtw_sw_shard_process_query(&shard, core, query, DTW_SW_QUERY_WORDS, &result);
+        if (result.qid != expected.qid || result.position != expected.position || result.score != expected.score) {
+            printf("Error: Trial %d: %d/%d, expected %d/%d\n",
+                   trial, result.position, result.score, expected.position, expected.score);
+            passed = 0;
+        }
+    }
+    free(ref);
+    dtw_sw_shard_release(&shard);
+    dtw_sw_release(&sw);
+
+    printf("[test_dtw_sw_shard] %s\n", passed ? "passed" : "failed");
+}
+
+// A read pushed in uneven chunks matches the whole query after
+// DTW_SW_SQG_SIZE samples and keeps matching a single push beyond that
+void test_dtw_sw_stream() {
+    printf("==================================\n");
+    printf("Testing streaming software DTW\n");
+    printf("==================================\n");
+    dtw_sw_t sw;
+    dtw_sw_stream_t chunked, whole;
+    if (dtw_sw_init(&sw)) {
+        printf("Error: Failed to initialize dtw_sw\n");
+        return;
+    }
+
+    int passed = 1;
+    int32_t ref[5000];
+    int32_t read[400];
+    int32_t query[DTW_SW_QUERY_WORDS];
+    srand(16);
+    for (int i = 0; i < 5000; i++) {
+        ref[i] = rand() % 300;
+    }
+    for (int i = 0; i < 400; i++) {
+        read[i] = ref[1200 + i] + rand() % 8;
+    }
+    query[0] = 7;
+    query[1] = 0;
+    for (int i = 0; i < DTW_SW_SQG_SIZE; i++) {
+        query[i + 2] = read[i];
+    }
+    dtw_sw_load_reference(&sw, ref, 5000);
+
+    for (uint32_t core = 0; core < 2 && passed; core++) {
+        search_result_t expected, result, result_whole;
+        dtw_sw_process_query(&sw, core, query, DTW_SW_QUERY_WORDS, &expected);
+        if (dtw_sw_stream_init(&chunked, &sw, core) || dtw_sw_stream_init(&whole, &sw, core)) {
+            printf("Error: Failed to initialize dtw_sw_stream\n");
+            passed = 0;
+            break;
+        }
+        dtw_sw_stream_reset(&chunked, 7);
+        dtw_sw_stream_reset(&whole, 7);
+
+        uint32_t pushed = 0;
+        while (pushed < DTW_SW_SQG_SIZE) {
+            uint32_t n = 1 + rand() % 90;
+            n = (pushed + n > DTW_SW_SQG_SIZE) ? DTW_SW_SQG_SIZE - pushed : n;
+            dtw_sw_stream_push(&chunked, read + pushed, n, &result);
+            pushed += n;
+        }
+        if (result.qid != expected.qid || result.position != expected.position || result.score != expected.score) {
+            printf("Error: Core %d: %d/%d, expected %d/%d\n", core, result.position, result.score, expected.position, expected.score);
+            passed = 0;
+        }
+
+        dtw_sw_stream_push(&chunked, read + pushed, 400 - pushed, &result);
+        dtw_sw_stream_push(&whole, read, 400, &result_whole);
+        if (result.position != result_whole.position || result.score != result_whole.score) {
+            printf("Error: Core %d: %d/%d after 400 samples, expected %d/%d\n",
+                   core, result.position, result.score, result_whole.position, result_whole.score);
+            passed = 0;
+        }
+        dtw_sw_stream_release(&chunked);
+        dtw_sw_stream_release(&whole);
+    }
+    dtw_sw_release(&sw);
+
+    printf("[test_dtw_sw_stream] %s\n", passed ? "passed" : "failed");
+}
+
+// Pruned software DTW returns the core's result, or no hit when the score
+// is not below max_score
+void test_dtw_sw_pruned() {
+    printf("==================================\n");
+    printf("Testing pruned software DTW\n");
+    printf("==================================\n");
+    dtw_sw_t sw;
+    if (dtw_sw_init(&sw)) {
+        printf("Error: Failed to initialize dtw_sw\n");
+        return;
+    }
+
+    int passed = 1;
+    const int ref_len = 20000;
+    static int32_t ref[20000];
+    int32_t query[DTW_SW_QUERY_WORDS];
+    srand(17);
+    for (int i = 0; i < ref_len;) {
+        // Signal levels of a few samples each, like a squiggle
+        int32_t level = 200 + rand() % 600;
+        for (int k = 4 + rand() % 8; k > 0 && i < ref_len; k--) {
+            ref[i++] = level + rand() % 16;
+        }
+    }
+    dtw_sw_load_reference(&sw, ref, ref_len);
+
+    for (int q = 0; q < 24 && passed; q++) {
+        uint32_t core = q & 3;
+        int32_t start = rand() % (ref_len - 2 * DTW_SW_SQG_SIZE);
+        query[0] = q;
+        query[1] = 0;
+        for (int i = 0; i < DTW_SW_SQG_SIZE; i++) {
+            // Stretched reads from the reference with noise, then random ones
+            query[i + 2] = (q < 16) ? ref[start + i + i / 8] + rand() % 24 - 12 : rand() % 1000;
+        }
+        dtw_sw_set_isa(&sw, (q % 3 == 0) ? DTW_SW_ISA_SCALAR : dtw_sw_detect_isa());
+
+        search_result_t expected, result, below, at;
+        dtw_sw_process_query(&sw, core, query, DTW_SW_QUERY_WORDS, &expected);
+        dtw_sw_process_query_pruned(&sw, core, query, DTW_SW_QUERY_WORDS, DTW_SW_MAX_VALUE, &result);
+        dtw_sw_process_query_pruned(&sw, core, query, DTW_SW_QUERY_WORDS, expected.score + 1, &below);
+        dtw_sw_process_query_pruned(&sw, core, query, DTW_SW_QUERY_WORDS, expected.score, &at);
+        if (result.qid != expected.qid || result.position != expected.position || result.score != expected.score) {
+            printf("Error: Query %d: %d/%d, expected %d/%d\n", q, result.position, result.score, expected.position, expected.score);
+            passed = 0;
+        }
+        if (below.position != expected.position || below.score != expected.score) {
+            printf("Error: Query %d: %d/%d below %d, expected %d/%d\n",
+                   q, below.position, below.score, expected.score + 1, expected.position, expected.score);
+            passed = 0;
+        }
+        if (at.position != 0 || at.score != DTW_SW_MAX_VALUE) {
+            printf("Error: Query %d: %d/%d at its own score, expected no hit\n", q, at.position, at.score);
+            passed = 0;
+        }
+    }
+    dtw_sw_release(&sw);
+
+    printf("[test_dtw_sw_pruned] %s\n", passed ? "passed" : "failed");
+}
+
+// Banded model: the sweep kernels, the stream and the pruned mode agree with the
+// scalar column sweep, and an unwarped copy of the reference stays in a band of 1
+void test_dtw_sw_band() {
+    printf("==================================\n");
+    printf("Testing banded software DTW\n");
+    printf("==================================\n");
+    dtw_sw_t sw;
+    dtw_sw_stream_t stream;
+    if (dtw_sw_init(&sw)) {
+        printf("Error: Failed to initialize dtw_sw\n");
+        return;
+    }
+    if (dtw_sw_stream_init(&stream, &sw, 0)) {
+        printf("Error: Failed to initialize dtw_sw_stream\n");
+        dtw_sw_release(&sw);
+        return;
+    }
+
+    int passed = 1;
+    const int ref_len = 4000;
+    static int32_t ref[4000];
+    int32_t query[DTW_SW_QUERY_WORDS];
+    srand(18);
+    for (int i = 0; i < ref_len; i++) {
+        ref[i] = rand() % 512;
+    }
+    dtw_sw_load_reference(&sw, ref, ref_len);
+    if (dtw_sw_set_band(&sw, DTW_SW_BAND_MAX + 1) == 0) {
+        printf("Error: Band %d accepted\n", DTW_SW_BAND_MAX + 1);
+        passed = 0;
+    }
+
+    const uint32_t bands[] = {1, 4, 16, 60, DTW_SW_BAND_MAX};
+    for (int q = 0; q < 20 && passed; q++) {
+        uint32_t core = q & 3;
+        uint32_t band = bands[q % 5];
+        int32_t start = rand() % (ref_len - 2 * DTW_SW_SQG_SIZE);
+        query[0] = q;
+        query[1] = 0;
+        for (int i = 0; i < DTW_SW_SQG_SIZE; i++) {
+            // Reads stretched by up to one in four samples, some with saturating values
+            int32_t v = ref[start + i + i * (q % 4) / 16] + rand() % 32 - 16;
+            query[i + 2] = (q >= 15) ? v * 200 : v;
+        }
+        dtw_sw_set_band(&sw, band);
+
+        search_result_t expected, result, pruned, streamed;
+        dtw_sw_set_isa(&sw, DTW_SW_ISA_SCALAR);
+        dtw_sw_process_query(&sw, core, query, DTW_SW_QUERY_WORDS, &expected);
+        dtw_sw_set_isa(&sw, dtw_sw_detect_isa());
+        dtw_sw_process_query(&sw, core, query, DTW_SW_QUERY_WORDS, &result);
+        dtw_sw_process_query_pruned(&sw, core, query, DTW_SW_QUERY_WORDS, DTW_SW_MAX_VALUE, &pruned);
+        stream.core = core;
+        dtw_sw_stream_reset(&stream, q);
+        dtw_sw_stream_push(&stream, query + 2, 100, &streamed);
+        dtw_sw_stream_push(&stream, query + 102, DTW_SW_SQG_SIZE - 100, &streamed);
+        if (result.position != expected.position || result.score != expected.score ||
+            pruned.position != expected.position || pruned.score != expected.score ||
+            streamed.position != expected.position || streamed.score != expected.score) {
+            printf("Error: Query %d band %d: %d/%d, pruned %d/%d, streamed %d/%d, expected %d/%d\n", q, band,
+                   result.position, result.score, pruned.position, pruned.score,
+                   streamed.position, streamed.score, expected.position, expected.score);
+            passed = 0;
+        }
+    }
+
+    for (int i = 0; i < DTW_SW_SQG_SIZE; i++) {
+        query[i + 2] = ref[1000 + i];
+    }
+    search_result_t result;
+    dtw_sw_set_band(&sw, 1);
+    dtw_sw_process_query(&sw, 1, query, DTW_SW_QUERY_WORDS, &result);
+    if (result.score != 0) {
+        printf("Error: Copy of the reference scored %d in a band of 1\n", result.score);
+        passed = 0;
+    }
+    dtw_sw_stream_release(&stream);
+    dtw_sw_release(&sw);
+
+    printf("[test_dtw_sw_band] %s\n", passed ? "passed" : "failed");
+}
+
+// Top-K hits: a segment repeated three times in the reference comes back as
+// three separate hits, the same from every kernel, best first
+void test_dtw_sw_hits() {
+    printf("==================================\n");
+    printf("Testing software DTW hit list\n");
+    printf("==================================\n");
+    dtw_sw_t sw;
+    if (dtw_sw_init(&sw)) {
+        printf("Error: Failed to initialize dtw_sw\n");
+        return;
+    }
+
+    int passed = 1;
+    const int ref_len = 6000;
+    const int copies[3] = {700, 2900, 4800};
+    static int32_t ref[6000];
+    int32_t query[DTW_SW_QUERY_WORDS];
+    srand(19);
+    for (int i = 0; i < ref_len; i++) {
+        ref[i] = rand() % 512;
+    }
+    for (int c = 1; c < 3; c++) {
+        for (int i = 0; i < DTW_SW_SQG_SIZE; i++) {
+            ref[copies[c] + i] = ref[copies[0] + i] + rand() % 9 - 4;
+        }
+    }
+    dtw_sw_load_reference(&sw, ref, ref_len);
+
+    query[0] = 7;
+    query[1] = 0;
+    for (int i = 0; i < DTW_SW_SQG_SIZE; i++) {
+        query[i + 2] = ref[copies[0] + i] + rand() % 9 - 4;
+    }
+    search_result_t result;
+    search_hits_t expected, hits;
+    dtw_sw_process_query(&sw, 1, query, DTW_SW_QUERY_WORDS, &result);
+    dtw_sw_set_isa(&sw, DTW_SW_ISA_SCALAR);
+    dtw_sw_process_query_hits(&sw, 1, query, DTW_SW_QUERY_WORDS, DTW_ACCEL_HITS_MAX, &expected);
+    dtw_sw_set_isa(&sw, dtw_sw_detect_isa());
+    dtw_sw_process_query_hits(&sw, 1, query, DTW_SW_QUERY_WORDS, DTW_ACCEL_HITS_MAX, &hits);
+
+    if (hits.qid != 7 || hits.hits[0].position != result.position || hits.hits[0].score != result.score) {
+        printf("Error: Best hit %d/%d, expected %d/%d\n", hits.hits[0].position, hits.hits[0].score, result.position, result.score);
+        passed = 0;
+    }
+    for (int i = 0; i < DTW_ACCEL_HITS_MAX; i++) {
+        if (hits.hits[i].position != expected.hits[i].position || hits.hits[i].score != expected.hits[i].score) {
+            printf("Error: Hit %d: %d/%d, expected %d/%d\n", i, hits.hits[i].position, hits.hits[i].score,
+                   expected.hits[i].position, expected.hits[i].score);
+            passed = 0;
+        }
+        if (i > 0 && hits.hits[i].score < hits.hits[i - 1].score) {
+            printf("Error: Hit %d scores better than hit %d\n", i, i - 1);
+            passed = 0;
+        }
+        for (int k = 0; k < i; k++) {
+            uint32_t a = hits.hits[i].position;
+            uint32_t b = hits.hits[k].position;
+            if (a != 0 && (a > b ? a - b : b - a) < DTW_SW_SQG_SIZE) {
+                printf("Error: Hits %d and %d overlap (%d, %d)\n", k, i, b, a);
+                passed = 0;
+            }
+        }
+    }
+    // The copies are the three best hits, position = last column + 1 (+ 1 on odd cores)
+    for (int c = 0; c < 3; c++) {
+        int found = 0;
+        for (int i = 0; i < 3; i++) {
+            int32_t end = copies[c] + DTW_SW_SQG_SIZE;
+            found |= ((int32_t) hits.hits[i].position >= end - 8 && (int32_t) hits.hits[i].position <= end + 8);
+        }
+        if (!found) {
+            printf("Error: Copy at %d not among the best hits\n", copies[c]);
+            passed = 0;
+        }
+    }
+
+    // A single hit is the plain result
+    dtw_sw_process_query_hits(&sw, 1, query, DTW_SW_QUERY_WORDS, 1, &hits);
+    if (hits.hits[0].position != result.position || hits.hits[0].score != result.score || hits.hits[1].position != 0 ||
+        dtw_sw_process_query_hits(&sw, 1, query, DTW_SW_QUERY_WORDS, DTW_ACCEL_HITS_MAX + 1, &hits) == 0) {
+        printf("Error: Single hit or hit count check\n");
+        passed = 0;
+    }
+    dtw_sw_release(&sw);
+
+    printf("[test_dtw_sw_hits] %s\n", passed ? "passed" : "failed");
+}
+
+// Two strands: every kernel agrees, reads find their strand and their position
+// counted from the strand's start, and no alignment runs across the junction
+void test_dtw_sw_strands() {
+    printf("==================================\n");
+    printf("Testing two strand software DTW\n");
+    printf("==================================\n");
+    dtw_sw_t sw;
+    dtw_sw_shard_t shard;
+    dtw_sw_stream_t stream;
+    if (dtw_sw_init(&sw)) {
+        printf("Error: Failed to initialize dtw_sw\n");
+        return;
+    }
+    if (dtw_sw_shard_init(&shard, &sw, 4)) {
+        printf("Error: Failed to initialize dtw_sw_shard\n");
+        dtw_sw_release(&sw);
+        return;
+    }
+    if (dtw_sw_stream_init(&stream, &sw, 0)) {
+        printf("Error: Failed to initialize dtw_sw_stream\n");
+        dtw_sw_shard_release(&shard);
+        dtw_sw_release(&sw);
+        return;
+    }
+
+    int passed = 1;
+    const int32_t size = 8000;
+    static int32_t fwd[8000];
+    static int32_t rev[8000];
+    static int32_t both[16000];
+    int32_t starts[12];
+    int32_t queries[12][DTW_SW_QUERY_WORDS];
+    const int32_t *batch[12];
+    uint32_t lens[12];
+    srand(20);
+    for (int32_t i = 0; i < size; i++) {
+        fwd[i] = rand() % 512;
+    }
+    for (int32_t i = 0; i < size; i++) {
+        rev[i] = 511 - fwd[size - 1 - i];
+        both[i] = fwd[i];
+        both[size + i] = rev[i];
+    }
+    if (dtw_sw_load_reference_strands(&sw, NULL, 0, rev, size) == 0) {
+        printf("Error: Second strand accepted without a first one\n");
+        passed = 0;
+    }
+    dtw_sw_load_reference_strands(&sw, fwd, size, rev, size);
+
+    // Reads from the forward (even q) and reverse (odd q) strand, the last four across the junction
+    for (int q = 0; q < 12; q++) {
+        starts[q] = (q < 8) ? rand() % (size - DTW_SW_SQG_SIZE) : size - 165 + 20 * (q - 8);
+        queries[q][0] = q;
+        queries[q][1] = 0;
+        for (int i = 0; i < DTW_SW_SQG_SIZE; i++) {
+            queries[q][i + 2] = ((q < 8 && (q & 1)) ? rev[starts[q] + i] : both[starts[q] + i]) + rand() % 9 - 4;
+        }
+        batch[q] = queries[q];
+        lens[q] = DTW_SW_QUERY_WORDS;
+    }
+
+    for (uint32_t core = 0; core < 2 && passed; core++) {
+        search_result_t out[12];
+        dtw_sw_process_queries(&sw, core, batch, lens, 12, out);
+        for (int q = 0; q < 12; q++) {
+            search_result_t expected, result, pruned, sharded, streamed;
+            search_hits_t expected_hits, hits;
+            dtw_sw_set_isa(&sw, DTW_SW_ISA_SCALAR);
+            dtw_sw_process_query(&sw, core, queries[q], DTW_SW_QUERY_WORDS, &expected);
+            dtw_sw_process_query_hits(&sw, core, queries[q], DTW_SW_QUERY_WORDS, 4, &expected_hits);
+            dtw_sw_set_isa(&sw, dtw_sw_detect_isa());
+            dtw_sw_process_query(&sw, core, queries[q], DTW_SW_QUERY_WORDS, &result);
+            dtw_sw_process_query_pruned(&sw, core, queries[q], DTW_SW_QUERY_WORDS, DTW_SW_MAX_VALUE, &pruned);
+            dtw_sw_process_query_hits(&sw, core, queries[q], DTW_SW_QUERY_WORDS, 4, &hits);
+            shard.warmup = (q & 2) ? 0 : DTW_SW_SHARD_WARMUP;
+            dtw_sw_shard_process_query(&shard, core, queries[q], DTW_SW_QUERY_WORDS, &sharded);
+            stream.core = core;
+            dtw_sw_stream_reset(&stream, q);
+            dtw_sw_stream_push(&stream, queries[q] + 2, 100, &streamed);
+            dtw_sw_stream_push(&stream, queries[q] + 102, DTW_SW_SQG_SIZE - 100, &streamed);
+            if (result.position != expected.position || result.score != expected.score ||
+                pruned.position != expected.position || pruned.score != expected.score ||
+                out[q].position != expected.position || out[q].score != expected.score ||
+                sharded.position != expected.position || sharded.score != expected.score ||
+                streamed.position != expected.position || streamed.score != expected.score ||
+                memcmp(&hits, &expected_hits, sizeof(search_hits_t))) {
+                printf("Error: Core %d query %d: %x/%d, pruned %x/%d, batch %x/%d, shard %x/%d, stream %x/%d, "
+                       "hits %x/%d, expected %x/%d\n", core, q, result.position, result.score, pruned.position, pruned.score,
+                       out[q].position, out[q].score, sharded.position, sharded.score, streamed.position, streamed.score,
+                       hits.hits[0].position, hits.hits[0].score, expected.position, expected.score);
+                passed = 0;
+            }
+            for (int i = 0; i < 4; i++) {
+                // Hits on either strand count from the strand's start
+                if (DTW_ACCEL_POSITION(hits.hits[i].position) > (uint32_t) size + 2) {
+                    printf("Error: Core %d query %d hit %d at %x\n", core, q, i, hits.hits[i].position);
+                    passed = 0;
+                }
+            }
+
+            // Position = last column + 1 (+ 1 on even cores), counted from the start of the strand
+            int32_t end = starts[q] + DTW_SW_SQG_SIZE;
+            int32_t pos = (int32_t) DTW_ACCEL_POSITION(expected.position);
+            if (q < 8 && (DTW_ACCEL_POSITION_STRAND(expected.position) != (uint32_t) (q & 1) || pos < end - 8 || pos > end + 8)) {
+                printf("Error: Core %d query %d from %d on strand %d found at %d on strand %d\n", core, q, starts[q], q & 1,
+                       pos, DTW_ACCEL_POSITION_STRAND(expected.position));
+                passed = 0;
+            }
+        }
+    }
+
+    // Loaded as one strand, the reads across the junction align better than they may with two
+    for (int q = 8; q < 12; q++) {
+        search_result_t split, joined;
+        dtw_sw_process_query(&sw, 1, queries[q], DTW_SW_QUERY_WORDS, &split);
+        dtw_sw_load_reference(&sw, both, 2 * size);
+        dtw_sw_process_query(&sw, 1, queries[q], DTW_SW_QUERY_WORDS, &joined);
+        dtw_sw_load_reference_strands(&sw, fwd, size, rev, size);
+        if (joined.score >= split.score || DTW_ACCEL_POSITION_STRAND(joined.position)) {
+            printf("Error: Query %d across the junction: %x/%d on two strands, %x/%d on one\n", q,
+                   split.position, split.score, joined.position, joined.score);
+            passed = 0;
+        }
+    }
+    dtw_sw_stream_release(&stream);
+    dtw_sw_shard_release(&shard);
+    dtw_sw_release(&sw);
+
+    printf("[test_dtw_sw_strands] %s\n", passed ? "passed" : "failed");
+}
+
+// Short queries (REG_QLEN) give the same result on every kernel as a stream
+// of the same samples, which computes their rows alone
+void test_dtw_sw_query_len() {
+    printf("==================================\n");
+    printf("Testing software DTW query length\n");
+    printf("==================================\n");
+    dtw_sw_t sw;
+    dtw_sw_shard_t shard;
+    dtw_sw_stream_t stream;
+    if (dtw_sw_init(&sw)) {
+        printf("Error: Failed to initialize dtw_sw\n");
+        return;
+    }
+    if (dtw_sw_shard_init(&shard, &sw, 4)) {
+        printf("Error: Failed to initialize dtw_sw_shard\n");
+        dtw_sw_release(&sw);
+        return;
+    }
+    if (dtw_sw_stream_init(&stream, &sw, 0)) {
+        printf("Error: Failed to initialize dtw_sw_stream\n");
+        dtw_sw_shard_release(&shard);
+        dtw_sw_release(&sw);
+        return;
+    }
+
+    int passed = 1;
+    const int32_t size = 8000;
+    static int32_t ref[8000];
+    const uint32_t qlens[3] = {100, 1, 173};
+    int32_t starts[10];
+    int32_t queries[10][DTW_SW_QUERY_WORDS];
+    const int32_t *batch[10];
+    uint32_t lens[10];
+    srand(21);
+    for (int32_t i = 0; i < size; i++) {
+        ref[i] = rand() % 512;
+    }
+    dtw_sw_load_reference(&sw, ref, size);
+    if (dtw_sw_set_query_len(&sw, 0) == 0 || dtw_sw_set_query_len(&sw, DTW_SW_SQG_SIZE + 1) == 0) {
+        printf("Error: Query length out of range accepted\n");
+        passed = 0;
+    }
+
+    for (int l = 0; l < 3 && passed; l++) {
+        uint32_t qlen = qlens[l];
+        dtw_sw_set_query_len(&sw, qlen);
+        for (int q = 0; q < 10; q++) {
+            starts[q] = rand() % (size - DTW_SW_SQG_SIZE);
+            queries[q][0] = q;
+            queries[q][1] = 0;
+            for (uint32_t i = 0; i < qlen; i++) {
+                queries[q][i + 2] = ref[starts[q] + i] + rand() % 9 - 4;
+            }
+            batch[q] = queries[q];
+            lens[q] = qlen + 2;
+        }
+        search_result_t full;
+        if (dtw_sw_process_query(&sw, 1, queries[0], DTW_SW_QUERY_WORDS, &full) == 0) {
+            printf("Error: Query of %d words accepted with %d samples per query\n", DTW_SW_QUERY_WORDS, qlen);
+            passed = 0;
+        }
+
+        for (uint32_t band = 0; band <= 20; band += 20) {
+            dtw_sw_set_band(&sw, band);
+            for (uint32_t core = 0; core < 2 && passed; core++) {
+                search_result_t out[10];
+                dtw_sw_process_queries(&sw, core, batch, lens, 10, out);
+                for (int q = 0; q < 10; q++) {
+                    search_result_t expected, result, pruned, sharded, streamed;
+                    search_hits_t expected_hits, hits;
+                    dtw_sw_set_isa(&sw, DTW_SW_ISA_SCALAR);
+                    dtw_sw_process_query(&sw, core, queries[q], qlen + 2, &expected);
+                    dtw_sw_process_query_hits(&sw, core, queries[q], qlen + 2, 3, &expected_hits);
+                    dtw_sw_set_isa(&sw, dtw_sw_detect_isa());
+                    dtw_sw_process_query(&sw, core, queries[q], qlen + 2, &result);
+                    dtw_sw_process_query_pruned(&sw, core, queries[q], qlen + 2, DTW_SW_MAX_VALUE, &pruned);
+                    dtw_sw_process_query_hits(&sw, core, queries[q], qlen + 2, 3, &hits);
+                    shard.warmup = (q & 1) ? 0 : DTW_SW_SHARD_WARMUP;
+                    dtw_sw_shard_process_query(&shard, core, queries[q], qlen + 2, &sharded);
+                    stream.core = core;
+                    dtw_sw_stream_reset(&stream, q);
+                    dtw_sw_stream_push(&stream, queries[q] + 2, qlen / 2, &streamed);
+                    dtw_sw_stream_push(&stream, queries[q] + 2 + qlen / 2, qlen - qlen / 2, &streamed);
+                    if (result.position != expected.position || result.score != expected.score ||
+                        pruned.position != expected.position || pruned.score != expected.score ||
+                        out[q].position != expected.position || out[q].score != expected.score ||
+                        sharded.position != expected.position || sharded.score != expected.score ||
+                        streamed.position != expected.position || streamed.score != expected.score ||
+                        memcmp(&hits, &expected_hits, sizeof(search_hits_t))) {
+                        printf("Error: %d samples, band %d, core %d query %d: %d/%d, pruned %d/%d, batch %d/%d, "
+                               "shard %d/%d, stream %d/%d, hits %d/%d, expected %d/%d\n", qlen, band, core, q,
+                               result.position, result.score, pruned.position, pruned.score, out[q].position, out[q].score,
+                               sharded.position, sharded.score, streamed.position, streamed.score,
+                               hits.hits[0].position, hits.hits[0].score, expected.position, expected.score);
+                        passed = 0;
+                    }
+
+                    // Position = last column + 1 (+ 1 on even cores)
+                    int32_t end = starts[q] + (int32_t) qlen;
+                    if (qlen >= 100 && band == 0 && (expected.position + 8 < (uint32_t) end || expected.position > (uint32_t) end + 8)) {
+                        printf("Error: %d samples, core %d query %d from %d found at %d\n", qlen, core, q, starts[q],
+                               expected.position);
+                        passed = 0;
+                    }
+                }
+            }
+        }
+        dtw_sw_set_band(&sw, 0);
+    }
+    dtw_sw_stream_release(&stream);
+    dtw_sw_shard_release(&shard);
+    dtw_sw_release(&sw);
+
+    printf("[test_dtw_sw_query_len] %s\n", passed ? "passed" : "failed");
+}
+
+// Early accept (REG_THRESH): every kernel stops at the first column of the full
+// last row, computed by a stream without a threshold, that is below the score
+void test_dtw_sw_thresh() {
+    printf("==================================\n");
+    printf("Testing software DTW early accept\n");
+    printf("==================================\n");
+    dtw_sw_t sw;
+    dtw_sw_shard_t shard;
+    dtw_sw_stream_t stream;
+    if (dtw_sw_init(&sw)) {
+        printf("Error: Failed to initialize dtw_sw\n");
+        return;
+    }
+    if (dtw_sw_shard_init(&shard, &sw, 4)) {
+        printf("Error: Failed to initialize dtw_sw_shard\n");
+        dtw_sw_release(&sw);
+        return;
+    }
+    if (dtw_sw_stream_init(&stream, &sw, 0)) {
+        printf("Error: Failed to initialize dtw_sw_stream\n");
+        dtw_sw_shard_release(&shard);
+        dtw_sw_release(&sw);
+        return;
+    }
+
+    int passed = 1;
+    const int32_t size = 8000;
+    static int32_t ref[8000];
+    int32_t starts[10];
+    int32_t queries[10][DTW_SW_QUERY_WORDS];
+    const int32_t *batch[10];
+    uint32_t lens[10];
+    srand(23);
+    for (int32_t i = 0; i < size; i++) {
+        ref[i] = rand() % 512;
+    }
+    // The second half repeats the first, so an exact copy scores 0 twice
+    memcpy(ref + size / 2, ref, size / 2 * sizeof(int32_t));
+    dtw_sw_load_reference(&sw, ref, size);
+    for (int q = 0; q < 10; q++) {
+        starts[q] = rand() % (size / 2 - DTW_SW_SQG_SIZE);
+        queries[q][0] = q;
+        queries[q][1] = 0;
+        for (int i = 0; i < DTW_SW_SQG_SIZE; i++) {
+            queries[q][i + 2] = ref[starts[q] + i] + ((q < 5) ? rand() % 9 - 4 : 0);
+        }
+        batch[q] = queries[q];
+        lens[q] = DTW_SW_QUERY_WORDS;
+    }
+    if (dtw_sw_set_thresh(&sw, DTW_SW_MAX_VALUE + 1) == 0) {
+        printf("Error: Early accept score out of range accepted\n");
+        passed = 0;
+    }
+
+    for (uint32_t band = 0; band <= 20 && passed; band += 20) {
+        dtw_sw_set_band(&sw, band);
+        for (uint32_t core = 0; core < 2 && passed; core++) {
+            for (int q = 0; q < 10; q++) {
+                // Full last row, then a threshold somewhere between its minimum and a typical value
+                dtw_sw_set_thresh(&sw, 0);
+                search_result_t full;
+                stream.core = core;
+                dtw_sw_stream_reset(&stream, q);
+                dtw_sw_stream_push(&stream, queries[q] + 2, DTW_SW_SQG_SIZE, &full);
+                uint32_t thresh = (q < 5) ? full.score + 1 + (uint32_t) rand() % (full.score + 1) : 1;
+                search_result_t expected = {(uint32_t) q, 0, DTW_SW_MAX_VALUE};
+                for (uint32_t j = 0; j < sw.ref_len + 2; j++) {
+                    if (stream.row[j] < expected.score) {
+                        expected.score = stream.row[j];
+                        expected.position = (j <= sw.ref_len) ? dtw_sw_position(&sw, core, j + 1) : expected.position;
+                    }
+                    if (j <= sw.ref_len && stream.row[j] < thresh) {
+                        break;
+                    }
+                }
+
+                search_result_t result, scalar, pruned, tight, sharded, streamed, out[10];
+                search_hits_t expected_hits, hits;
+                dtw_sw_set_thresh(&sw, thresh);
+                dtw_sw_set_isa(&sw, DTW_SW_ISA_SCALAR);
+                dtw_sw_process_query(&sw, core, queries[q], DTW_SW_QUERY_WORDS, &scalar);
+                dtw_sw_process_query_hits(&sw, core, queries[q], DTW_SW_QUERY_WORDS, 3, &expected_hits);
+                dtw_sw_set_isa(&sw, dtw_sw_detect_isa());
+                dtw_sw_process_query(&sw, core, queries[q], DTW_SW_QUERY_WORDS, &result);
+                dtw_sw_process_query_hits(&sw, core, queries[q], DTW_SW_QUERY_WORDS, 3, &hits);
+                dtw_sw_process_query_pruned(&sw, core, queries[q], DTW_SW_QUERY_WORDS, DTW_SW_MAX_VALUE, &pruned);
+                dtw_sw_process_query_pruned(&sw, core, queries[q], DTW_SW_QUERY_WORDS, (uint16_t) (full.score + 1), &tight);
+                dtw_sw_process_queries(&sw, core, batch, lens, 10, out);
+                shard.warmup = (q & 1) ? 0 : DTW_SW_SHARD_WARMUP;
+                dtw_sw_shard_process_query(&shard, core, queries[q], DTW_SW_QUERY_WORDS, &sharded);
+                dtw_sw_stream_reset(&stream, q);
+                dtw_sw_stream_push(&stream, queries[q] + 2, DTW_SW_SQG_SIZE, &streamed);
+
+                // The pruned call reports no hit for an accepted score at or above max_score
+                int tight_ok = (expected.score <= full.score) ? tight.position == expected.position && tight.score == expected.score
+                                                               : tight.position == 0 && tight.score == DTW_SW_MAX_VALUE;
+                if (scalar.position != expected.position || scalar.score != expected.score ||
+                    result.position != expected.position || result.score != expected.score ||
+                    pruned.position != expected.position || pruned.score != expected.score || !tight_ok ||
+                    out[q].position != expected.position || out[q].score != expected.score ||
+                    sharded.position != expected.position || sharded.score != expected.score ||
+                    streamed.position != expected.position || streamed.score != expected.score ||
+                    memcmp(&hits, &expected_hits, sizeof(search_hits_t))) {
+                    printf("Error: Band %d core %d query %d below %d: scalar %d/%d, %d/%d, pruned %d/%d, tight %d/%d, "
+                           "batch %d/%d, shard %d/%d, stream %d/%d, hits %d/%d, expected %d/%d\n", band, core, q, thresh,
+                           scalar.position, scalar.score, result.position, result.score, pruned.position, pruned.score,
+                           tight.position, tight.score, out[q].position, out[q].score, sharded.position, sharded.score,
+                           streamed.position, streamed.score, hits.hits[0].position, hits.hits[0].score,
+                           expected.position, expected.score);
+                    passed = 0;
+                }
+
+                // Exact copies stop at their first occurrence, not the one in the second half
+                int32_t end = starts[q] + DTW_SW_SQG_SIZE;
+                if (q >= 5 && band == 0 && (result.score != 0 || result.position + 8 < (uint32_t) end || result.position > (uint32_t) end + 8)) {
+                    printf("Error: Core %d query %d from %d accepted at %d/%d\n", core, q, starts[q], result.position, result.score);
+                    passed = 0;
+                }
+            }
+        }
+    }
+    dtw_sw_stream_release(&stream);
+    dtw_sw_shard_release(&shard);
+    dtw_sw_release(&sw);
+
+    printf("[test_dtw_sw_thresh] %s\n", passed ? "passed" : "failed");
+}
+
+// A smaller reference memory (REG_REF_SIZE) wraps the columns past the end of a
+// reference that fills it to the start of the memory, where the default one reads
+// the words a longer reference left behind
+void test_dtw_sw_ref_size() {
+    printf("==================================\n");
+    printf("Testing software DTW reference size\n");
+    printf("==================================\n");
+    dtw_sw_t sw, sw_small;
+    if (dtw_sw_init(&sw)) {
+        printf("Error: Failed to initialize dtw_sw\n");
+        return;
+    }
+    if (dtw_sw_init(&sw_small)) {
+        printf("Error: Failed to initialize dtw_sw\n");
+        dtw_sw_release(&sw);
+        return;
+    }
+
+    int passed = 1;
+    const uint32_t ref_size = 4096;
+    static int32_t ref[8000];
+    srand(29);
+    for (int32_t i = 0; i < 8000; i++) {
+        ref[i] = 1 + rand() % 512;
+    }
+    if (dtw_sw_set_ref_size(&sw_small, 0) == 0 || dtw_sw_set_ref_size(&sw_small, 3000) == 0 ||
+        dtw_sw_set_ref_size(&sw_small, DTW_SW_REF_MEM_SIZE * 2) == 0) {
+        printf("Error: Reference memory size out of range accepted\n");
+        passed = 0;
+    }
+    dtw_sw_set_ref_size(&sw_small, ref_size);
+    if (dtw_sw_load_reference(&sw_small, ref, ref_size + 1) == 0) {
+        printf("Error: Reference longer than the memory loaded\n");
+        passed = 0;
+    }
+
+    // The longer reference leaves its samples past ref_size in the default memory
+    dtw_sw_load_reference(&sw, ref, 8000);
+    dtw_sw_load_reference(&sw, ref, ref_size);
+    dtw_sw_load_reference(&sw_small, ref, ref_size);
+    if (dtw_sw_set_ref_size(&sw_small, ref_size) == 0) {
+        printf("Error: Reference memory size changed under a loaded reference\n");
+        passed = 0;
+    }
+    for (uint32_t core = 0; core < 2; core++) {
+        // Word ref_size, port a reads it one column later
+        uint32_t j = ref_size + ((core & 1) ? 0 : 1);
+        if (dtw_sw_column(&sw_small, core, j) != 0 || dtw_sw_column(&sw, core, j) != (uint16_t) ref[ref_size]) {
+            printf("Error: Core %d column %d reads %d/%d\n", core, j, dtw_sw_column(&sw_small, core, j), dtw_sw_column(&sw, core, j));
+            passed = 0;
+        }
+    }
+
+    // Both models agree on queries inside the reference
+    int32_t query[DTW_SW_QUERY_WORDS];
+    query[0] = 1;
+    query[1] = 0;
+    for (int i = 0; i < DTW_SW_SQG_SIZE; i++) {
+        query[i + 2] = ref[1000 + i];
+    }
+    for (uint32_t core = 0; core < 2; core++) {
+        search_result_t expected, result;
+        dtw_sw_process_query(&sw, core, query, DTW_SW_QUERY_WORDS, &expected);
+        dtw_sw_process_query(&sw_small, core, query, DTW_SW_QUERY_WORDS, &result);
+        if (result.position != expected.position || result.score != expected.score) {
+            printf("Error: Core %d: %d/%d, expected %d/%d\n", core, result.position, result.score, expected.position, expected.score);
+            passed = 0;
+        }
+    }
+    dtw_sw_release(&sw_small);
+    dtw_sw_release(&sw);
+
+    printf("[test_dtw_sw_ref_size] %s\n", passed ? "passed" : "failed");
+}
+
+// CPU only scheduler: every read comes back once, with its tag and the result
+// of the software model
+void test_haru_sched_cpu() {
+    printf("==================================\n");
+    printf("Testing scheduler (CPU workers)\n");
+    printf("==================================\n");
+    dtw_sw_t sw;
+    haru_sched_t sched;
+    if (dtw_sw_init(&sw)) {
+        printf("Error: Failed to initialize dtw_sw\n");
+        return;
+    }
+    if (haru_sched_init(&sched, NULL, &sw, 3)) {
+        printf("Error: Failed to initialize haru_sched\n");
+        dtw_sw_release(&sw);
+        return;
+    }
+
+    int passed = 1;
+    const int n = 40;
+    int32_t ref[3000];
+    int32_t queries[40][DTW_SW_QUERY_WORDS];
+    int seen[40] = {0};
+    srand(15);
+    for (int i = 0; i < 3000; i++) {
+        ref[i] = rand() % 256;
+    }
+    dtw_sw_load_reference(&sw, ref, 3000);
+    for (int q = 0; q < n; q++) {
+        int32_t start = rand() % (3000 - DTW_SW_SQG_SIZE);
+        queries[q][0] = q;
+        queries[q][1] = 0;
+        for (int i = 0; i < DTW_SW_SQG_SIZE; i++) {
+            queries[q][i + 2] = ref[start + i];
+        }
+        if (haru_sched_submit(&sched, queries[q], DTW_SW_QUERY_WORDS, 1000 + q)) {
+            printf("Error: Failed to submit read %d\n", q);
+            passed = 0;
+        }
+    }
+
+    int received = 0;
+    for (int tries = 0; tries < 10000 && received < n && passed; tries++) {
+        haru_completion_t completions[8];
+        int got = haru_sched_poll(&sched, completions, 8);
+        for (int i = 0; i < got; i++) {
+            int q = (int) completions[i].tag - 1000;
+            search_result_t expected;
+            if (q < 0 || q >= n || seen[q]) {
+                printf("Error: Unexpected tag %lu\n", (unsigned long) completions[i].tag);
+                passed = 0;
+                continue;
+            }
+            seen[q] = 1;
+            dtw_sw_process_query(&sw, HARU_SCHED_SW_CORE, queries[q], DTW_SW_QUERY_WORDS, &expected);
+            if (completions[i].core != HARU_SCHED_CPU_CORE || completions[i].result.position != expected.position ||
+                completions[i].result.score != expected.score) {
+                printf("Error: Read %d: %d/%d, expected %d/%d\n", q,
+                       completions[i].result.position, completions[i].result.score, expected.position, expected.score);
+                passed = 0;
+            }
+        }
+        received += got;
+        if (got == 0) {
+            usleep(1000);
+        }
+    }
+    passed = passed && received == n && sched.cpu_reads == (uint64_t) n;
+    haru_sched_release(&sched);
+    dtw_sw_release(&sw);
+
+    printf("[test_haru_sched_cpu] %s\n", passed ? "passed" : "failed");
+}
@@ -0,0 +1,171 @@
+/* MIT License
+
+Copyright (c) 2022 Po Jui Shih
+Copyright (c) 2022 Hassaan Saadat
+Copyright (c) 2022 Sri Parameswaran
+Copyright (c) 2022 Hasindu Gamaarachchi
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "uio_irq.h"
+#include "misc.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+/*
+ * Init and release functions
+ */
+void uio_irq_init_poll(uio_irq_t *irq) {
+    irq->fd = -1;
+    irq->is_eventfd = 0;
+    irq->mode = UIO_IRQ_MODE_POLL;
+    irq->spin = 0;
+}
+
+int32_t uio_irq_init(uio_irq_t *irq, const char *dev_path, uint8_t mode) {
+    uio_irq_init_poll(irq);
+    if (mode == UIO_IRQ_MODE_POLL) {
+        return 0;
+    }
+
+    irq->fd = open(dev_path, O_RDWR | O_CLOEXEC);
+    if (irq->fd < 0) {
+        HARU_ERROR("Failed to open %s.", dev_path);
+        return -1;
+    }
+    irq->mode = mode;
+    irq->spin = (mode == UIO_IRQ_MODE_HYBRID) ? UIO_IRQ_HYBRID_SPIN : 0;
+    return 0;
+}
+
+int32_t uio_irq_init_eventfd(uio_irq_t *irq, uint8_t mode) {
+    uio_irq_init_poll(irq);
+    irq->fd = eventfd(0, EFD_CLOEXEC);
+    if (irq->fd < 0) {
+        HARU_ERROR("%s", "Failed to create eventfd.");
+        return -1;
+    }
+    irq->is_eventfd = 1;
+    irq->mode = mode;
+    irq->spin = (mode == UIO_IRQ_MODE_HYBRID) ? UIO_IRQ_HYBRID_SPIN : 0;
+    return 0;
+}
+
+void uio_irq_release(uio_irq_t *irq) {
+    if (irq->fd >= 0) {
+        close(irq->fd);
+    }
+    uio_irq_init_poll(irq);
+}
+
+/*
+ * Interrupt functions
+ */
+
+// Unmasks the interrupt line. UIO masks it again every time it fires.
+int32_t uio_irq_enable(uio_irq_t *irq) {
+    if (irq->fd < 0 || irq->is_eventfd) {
+        return 0;
+    }
+    uint32_t unmask = 1;
+    if (write(irq->fd, &unmask, sizeof(unmask)) != sizeof(unmask)) {
+        HARU_ERROR("%s", "Failed to unmask interrupt.");
+        return -1;
+    }
+    return 0;
+}
+
+// Blocks until the interrupt fires. Returns 1 on interrupt, 0 on timeout, -1 on error.
+int32_t uio_irq_wait(uio_irq_t *irq, int timeout_ms) {
+    struct pollfd pfd;
+    pfd.fd = irq->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int ret = poll(&pfd, 1, timeout_ms);
+    if (ret < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    if (ret == 0) {
+        return 0;
+    }
+
+    // UIO returns a 32-bit interrupt count, eventfd a 64-bit counter
+    if (irq->is_eventfd) {
+        uint64_t count;
+        if (read(irq->fd, &count, sizeof(count)) != sizeof(count)) {
+            return -1;
+        }
+    } else {
+        uint32_t count;
+        if (read(irq->fd, &count, sizeof(count)) != sizeof(count)) {
+            return -1;
+        }
+    }
+    return 1;
+}
+
+// Raises the eventfd stand-in, as the interrupt line would.
+int32_t uio_irq_signal(uio_irq_t *irq) {
+    if (irq->fd < 0 || !irq->is_eventfd) {
+        return -1;
+    }
+    uint64_t one = 1;
+    return write(irq->fd, &one, sizeof(one)) == sizeof(one) ? 0 : -1;
+}
+
+/*
+ * Waits until done(arg) reports completion. Depending on the mode, this spins on
+ * done, blocks on the interrupt, or spins for a while before blocking. done is
+ * always rechecked after unmasking the interrupt so an interrupt that fired
+ * before the unmask cannot be missed.
+ */
+int32_t uio_irq_wait_done(uio_irq_t *irq, uio_irq_done_fn done, void *arg) {
+    int ret;
+
+    if (irq->mode == UIO_IRQ_MODE_POLL || irq->fd < 0) {
+        while ((ret = done(arg)) == 0);
+        return ret < 0 ? -1 : 0;
+    }
+
+    for (uint32_t i = 0; i < irq->spin; i++) {
+        ret = done(arg);
+        if (ret) {
+            return ret < 0 ? -1 : 0;
+        }
+    }
+
+    while (1) {
+        if (uio_irq_enable(irq)) {
+            return -1;
+        }
+        ret = done(arg);
+        if (ret) {
+            return ret < 0 ? -1 : 0;
+        }
+        if (uio_irq_wait(irq, UIO_IRQ_TIMEOUT_MS) < 0) {
+            HARU_ERROR("%s", "Failed to wait for interrupt.");
+            return -1;
+        }
+    }
+}
@@ -26,7 +26,7 @@ SOFTWARE. */
 `timescale 1ps / 1ps
 
 `define MAJOR_VERSION       1
-`define MINOR_VERSION       0
+`define MINOR_VERSION       9
 `define REVISION            0
 
 `define MAJOR_RANGE         31:28
@@ -53,7 +53,10 @@ module dtw_accel #(
     parameter INVERT_AXI_RESET      = 1,
     parameter INVERT_AXIS_RESET     = 1,
 
-    parameter NUM_ACCEL             = 2
+    parameter NUM_ACCEL             = 2,    // DTW cores, one reference memory replica per two unless COHORT (REG_REF_SIZE)
+    parameter HITS_MAX              = 8,    // Hits kept per query (REG_HITS)
+    parameter SQG_SIZE              = 250,  // PEs per core, longest query (REG_QLEN)
+    parameter COHORT                = 0     // 1: cores start queries together off one reference memory (REG_COHORT)
 )(
     input  wire                             S_AXI_clk,
     input  wire                             S_AXI_rst,
@@ -156,12 +159,23 @@ localparam  REG_CYCLE_CNT    = 8;
 localparam  REG_CORE_REF_ADDR= 9;
 localparam  REG_NQUERY       = 10;
 localparam  REG_CURR_QID     = 11;
+localparam  REG_NUM_ACCEL    = 12;
+localparam  REG_BAND         = 13;
+localparam  REG_HITS         = 14;
+localparam  REG_STRAND       = 15;
+localparam  REG_QLEN         = 16;
+localparam  REG_THRESH       = 17;
+localparam  REG_REF_SIZE     = 18;
+localparam  REG_COHORT       = 19;
 
 localparam  integer ADDR_LSB = (DATA_WIDTH / 32) + 1;
-localparam  integer ADDR_BITS = 3;
+localparam  integer ADDR_BITS = 4;
 
 localparam  MAX_ADDR = REG_KEY;
 
+// Reference memory read ports, a cohort shares both ports of a single memory
+localparam  REF_PORTS = (COHORT != 0) ? 2 : NUM_ACCEL;
+
 
 /* ===============================
  * registers/wires
@@ -185,6 +199,12 @@ reg   [DATA_WIDTH - 1 : 0]      r_reg_out_data;
 reg   [DATA_WIDTH - 1 : 0]      r_control;
 wire  [DATA_WIDTH - 1 : 0]      w_status;
 reg   [DATA_WIDTH - 1 : 0]      r_ref_len;
+reg   [DATA_WIDTH - 1 : 0]      r_band;
+reg   [DATA_WIDTH - 1 : 0]      r_hits;
+reg   [DATA_WIDTH - 1 : 0]      r_strand;
+reg   [DATA_WIDTH - 1 : 0]      r_qlen;
+reg   [DATA_WIDTH - 1 : 0]      r_thresh;
+reg   [DATA_WIDTH - 1 : 0]      r_cohort;
 wire  [DATA_WIDTH - 1 : 0]      w_version;
 wire  [DATA_WIDTH - 1 : 0]      w_key;
 reg   [DATA_WIDTH - 1 : 0]      r_dbg_ref_addr;
@@ -204,7 +224,11 @@ wire [NUM_ACCEL-1:0]            w_dtw_core_ref_busy;
 
 // Src FIFO
 wire [NUM_ACCEL-1:0]            w_src_fifo_clear;
-wire  [FIFO_DATA_WIDTH - 1:0]   w_src_fifo_w_data [NUM_ACCEL-1:0];
+wire [NUM_ACCEL-1:0]            w_core_src_fifo_clear;
+wire [NUM_ACCEL-1:0]            w_core_src_fifo_r_stb;
+wire                            w_ref_src_fifo_clear;
+wire                            w_ref_src_fifo_r_stb;
+wire  [FIFO_DATA_WIDTH - 1:0]   w_src_fifo_w_data;
 wire [NUM_ACCEL-1:0]            w_src_fifo_w_stb;
 wire [NUM_ACCEL-1:0]            w_src_fifo_full;
 wire [NUM_ACCEL-1:0]            w_src_fifo_not_full;
@@ -216,19 +240,34 @@ wire [NUM_ACCEL-1:0]            w_src_fifo_not_empty;
 
 // Sink FIFO
 wire  [FIFO_DATA_WIDTH - 1:0]   w_sink_fifo_w_data [NUM_ACCEL-1:0];
+wire [NUM_ACCEL-1:0]            w_sink_fifo_w_last;
 wire [NUM_ACCEL-1:0]            w_sink_fifo_w_stb;
 wire [NUM_ACCEL-1:0]            w_sink_fifo_full;
 wire [NUM_ACCEL-1:0]            w_sink_fifo_not_full;
 wire [NUM_ACCEL-1:0]            w_sink_fifo_r_last;
 
-wire  [FIFO_DATA_WIDTH - 1:0]   w_sink_fifo_r_data [NUM_ACCEL-1:0];
+wire  [NUM_ACCEL*FIFO_DATA_WIDTH - 1:0] w_sink_fifo_r_data;
 wire  [NUM_ACCEL-1:0]           w_sink_fifo_r_stb;
 wire  [NUM_ACCEL-1:0]           w_sink_fifo_empty;
 wire  [NUM_ACCEL-1:0]           w_sink_fifo_not_empty;
 
-// dtw core ref mem 
-reg [DTW_DATA_WIDTH - 1:0]      w_ref_r_data [NUM_ACCEL-1:0];
-reg [REFMEM_PTR_WIDTH - 1:0]    w_ref_r_addr [NUM_ACCEL-1:0];
+// dtw core ref mem, core i at [i*DTW_DATA_WIDTH +: DTW_DATA_WIDTH] and [i*REFMEM_PTR_WIDTH +: REFMEM_PTR_WIDTH]
+wire [NUM_ACCEL*DTW_DATA_WIDTH - 1:0]   w_ref_r_data;
+wire [NUM_ACCEL*REFMEM_PTR_WIDTH - 1:0] w_ref_r_addr;
+wire [REF_PORTS*DTW_DATA_WIDTH - 1:0]   w_ref_port_data;
+wire [REF_PORTS*REFMEM_PTR_WIDTH - 1:0] w_ref_port_addr;
+
+// Cohort. Once every core has sent its result, the cores holding a full query
+// start it together, when all of them have one or r_cohort cycles after the
+// first did. They read the reference in lockstep, so r_cohort_addr, which
+// follows the cores' own read pointers, drives both ports of the memory.
+wire [NUM_ACCEL-1:0]            w_cohort_wait;
+wire [NUM_ACCEL-1:0]            w_cohort_ready;
+wire [NUM_ACCEL-1:0]            w_cohort_run;
+wire                            w_cohort_gather;
+wire                            w_cohort_go;
+reg   [DATA_WIDTH - 1 : 0]      r_cohort_timer;
+reg   [REFMEM_PTR_WIDTH - 1:0]  r_cohort_addr;
 
 // dtw core debug
 wire  [2:0]                     w_dtw_core_state;
@@ -242,6 +281,14 @@ wire  [31:0]                    w_dtw_core_curr_qid;
 initial begin
     r_control <= 0;
     r_ref_len <= 4000;
+    r_band <= 0;
+    r_hits <= 1;
+    r_strand <= 0;
+    r_qlen <= SQG_SIZE;
+    r_thresh <= 0;
+    r_cohort <= NUM_ACCEL * (SQG_SIZE + 2);
+    r_cohort_timer <= 0;
+    r_cohort_addr <= 0;
 end
 
 /* ===============================
@@ -309,10 +356,10 @@ axi_lite_slave #(
 // );
 
 mm2s_packet_filter #(
-    .AXIS_DATA_WIDTH(32),
-    .FIFO_DATA_WIDTH(32),
-    .AXIS_DEST_WIDTH(4),
-    .NUM_FIFOS(2)
+    .AXIS_DATA_WIDTH(AXIS_DATA_WIDTH),
+    .FIFO_DATA_WIDTH(FIFO_DATA_WIDTH),
+    .AXIS_DEST_WIDTH(AXIS_DEST_WIDTH),
+    .NUM_FIFOS(NUM_ACCEL)
 ) mm2s_pf (
     .SRC_AXIS_tdata     (SRC_AXIS_tdata),
     .SRC_AXIS_tdest     (SRC_AXIS_tdest),
@@ -320,7 +367,7 @@ mm2s_packet_filter #(
     .SRC_AXIS_tready    (SRC_AXIS_tready),
 
     .fifo_wren          (w_src_fifo_w_stb),
-    .fifo_full          (w_src_fifo_not_full),
+    .fifo_full          (w_src_fifo_full),
     .fifo_data          (w_src_fifo_w_data)
 );
 
@@ -334,7 +381,7 @@ generate
             .rst                (w_axis_rst | w_src_fifo_clear[i]),
 
             .i_fifo_w_stb       (w_src_fifo_w_stb[i]),
-            .i_fifo_w_data      (w_src_fifo_w_data[i]),
+            .i_fifo_w_data      (w_src_fifo_w_data),
             .o_fifo_full        (w_src_fifo_full[i]),
             .o_fifo_not_full    (w_src_fifo_not_full[i]),
 
@@ -349,49 +396,86 @@ generate
             .WIDTH              (DTW_DATA_WIDTH),
             .AXIS_WIDTH         (AXIS_DATA_WIDTH),
             .REF_INIT           (0),
-            .REFMEM_PTR_WIDTH   (REFMEM_PTR_WIDTH)
+            .REFMEM_PTR_WIDTH   (REFMEM_PTR_WIDTH),
+            .SQG_SIZE           (SQG_SIZE),
+            .HITS_MAX           (HITS_MAX),
+            .REF_LAG            ((i % 2 == 0) ? 1 : 0)  // port a has an extra address register
         ) dc (
             .clk                (S_AXI_clk),
             .rst                (w_dtw_core_rst),
             .rs                 (w_dtw_core_rs),
 
             .ref_len            (r_ref_len),
+            .band               (r_band[7:0]),
+            .hits               (r_hits[7:0]),
+            .strand             (r_strand),
+            .qlen               (r_qlen[7:0]),
+            .thresh             (r_thresh[DTW_DATA_WIDTH-1:0]),
             .op_mode            (w_dtw_core_mode),
             .busy               (w_dtw_core_busy[i]),
 
-            .src_fifo_clear     (w_src_fifo_clear[i]),
-            .src_fifo_rden      (w_src_fifo_r_stb[i]),
+            .cohort             (COHORT != 0),
+            .cohort_go          (w_cohort_go),
+            .cohort_wait        (w_cohort_wait[i]),
+            .cohort_ready       (w_cohort_ready[i]),
+            .cohort_run         (w_cohort_run[i]),
+
+            .src_fifo_clear     (w_core_src_fifo_clear[i]),
+            .src_fifo_rden      (w_core_src_fifo_r_stb[i]),
             .src_fifo_empty     (w_src_fifo_empty[i]),
             .src_fifo_data      (w_src_fifo_r_data[i]),
 
             .sink_fifo_wren     (w_sink_fifo_w_stb[i]),
             .sink_fifo_full     (w_sink_fifo_full[i]),
             .sink_fifo_data     (w_sink_fifo_w_data[i]),
-            .sink_fifo_last     (w_sink_fifo_r_last[i]),
+            .sink_fifo_last     (w_sink_fifo_w_last[i]),
 
             // Ref mem signals
             .ref_load_done      (w_dtw_core_load_done),
-            .dataout_ref        (w_ref_r_data[i]),
-            .addr_ref           (w_ref_r_addr[i])
+            .dataout_ref        (w_ref_r_data[i*DTW_DATA_WIDTH +: DTW_DATA_WIDTH]),
+            .addr_ref           (w_ref_r_addr[i*REFMEM_PTR_WIDTH +: REFMEM_PTR_WIDTH])
         );
 
+        // Sink FIFO carries tlast alongside the data
         fifo #(
             .DEPTH              (FIFO_DEPTH),
-            .WIDTH              (FIFO_DATA_WIDTH)
+            .WIDTH              (FIFO_DATA_WIDTH + 1)
         ) sink_fifo (
             .clk                (SRC_AXIS_clk),
             .rst                (w_axis_rst),
 
             .i_fifo_w_stb       (w_sink_fifo_w_stb[i]),
-            .i_fifo_w_data      (w_sink_fifo_w_data[i]),
+            .i_fifo_w_data      ({w_sink_fifo_w_last[i], w_sink_fifo_w_data[i]}),
             .o_fifo_full        (w_sink_fifo_full[i]),
             .o_fifo_not_full    (w_sink_fifo_not_full[i]),
 
             .i_fifo_r_stb       (w_sink_fifo_r_stb[i]),
-            .o_fifo_r_data      (w_sink_fifo_r_data[i]),
+            .o_fifo_r_data      ({w_sink_fifo_r_last[i], w_sink_fifo_r_data[i*FIFO_DATA_WIDTH +: FIFO_DATA_WIDTH]}),
             .o_fifo_empty       (w_sink_fifo_empty[i]),
             .o_fifo_not_empty   (w_sink_fifo_not_empty[i])
         );
+
+        // Src FIFO 0 also feeds the reference loader, which owns it in reference load mode
+        if (i == 0) begin
+            assign w_src_fifo_clear[i] = (w_dtw_core_mode == 1'b1) ? w_ref_src_fifo_clear : w_core_src_fifo_clear[i];
+            assign w_src_fifo_r_stb[i] = (w_dtw_core_mode == 1'b1) ? w_ref_src_fifo_r_stb : w_core_src_fifo_r_stb[i];
+        end else begin
+            assign w_src_fifo_clear[i] = w_core_src_fifo_clear[i];
+            assign w_src_fifo_r_stb[i] = w_core_src_fifo_r_stb[i];
+        end
+
+        // Even cores take port a (REF_LAG 1), odd cores port b
+        if (COHORT != 0) begin
+            assign w_ref_r_data[i*DTW_DATA_WIDTH +: DTW_DATA_WIDTH] = w_ref_port_data[(i % 2)*DTW_DATA_WIDTH +: DTW_DATA_WIDTH];
+        end else begin
+            assign w_ref_r_data[i*DTW_DATA_WIDTH +: DTW_DATA_WIDTH] = w_ref_port_data[i*DTW_DATA_WIDTH +: DTW_DATA_WIDTH];
+        end
+    end
+
+    if (COHORT != 0) begin
+        assign w_ref_port_addr = {2{r_cohort_addr}};
+    end else begin
+        assign w_ref_port_addr = w_ref_r_addr;
     end
 endgenerate
 
@@ -399,7 +483,8 @@ dtw_core_ref #(
     .DATA_WIDTH         (DTW_DATA_WIDTH),
     .ADDR_WIDTH         (AXIS_DATA_WIDTH),
     .REF_INIT           (0),
-    .REFMEM_PTR_WIDTH   (REFMEM_PTR_WIDTH)
+    .REFMEM_PTR_WIDTH   (REFMEM_PTR_WIDTH),
+    .NUM_PORTS          (REF_PORTS)
 ) dc_ref (
 
     // Main Module signals
@@ -412,16 +497,15 @@ dtw_core_ref #(
     .ref_load_done_out  (w_dtw_core_load_done),
 
     
-    .src_fifo_clear_out (w_src_fifo_clear[0]),     // Src FIFO Clear signal
-    .src_fifo_rden_out  (w_src_fifo_r_stb[0]),      // Src FIFO Read enable
+    .src_fifo_clear_out (w_ref_src_fifo_clear),     // Src FIFO Clear signal
+    .src_fifo_rden_out  (w_ref_src_fifo_r_stb),      // Src FIFO Read enable
     .src_fifo_empty_in  (w_src_fifo_empty[0]),     // Src FIFO Empty
     .src_fifo_data_in   (w_src_fifo_r_data[0]),      // Src FIFO Data
 
-    //TODO: Parametise this better
-    .ref_addr_0_in        (w_ref_r_addr[0]),
-    .ref_data_0_out       (w_ref_r_data[0]),
-    .ref_addr_1_in        (w_ref_r_addr[1]),
-    .ref_data_1_out       (w_ref_r_data[1]),
+    // One read port per core, even cores on port a of a replica (REF_LAG 1),
+    // or the two ports of the cohort's memory
+    .ref_addr_in        (w_ref_port_addr),
+    .ref_data_out       (w_ref_port_data),
 
     .dbg_state          (dbg_dtw_core_ref_state),
     .dbg_addr_ref       (dbg_dtw_core_ref_addr),
@@ -445,14 +529,14 @@ dtw_core_ref #(
 // );
 
 s2mm_packet_filter #(
-    .AXIS_DATA_WIDTH        (32),
-    .FIFO_DATA_WIDTH        (32),
-    .AXIS_KEEP_WIDTH        (AXIS_DATA_WIDTH / 8),
-    .AXIS_DEST_WIDTH        (4),
-    .NUM_CHANNELS           (2)
+    .AXIS_DATA_WIDTH        (AXIS_DATA_WIDTH),
+    .FIFO_DATA_WIDTH        (FIFO_DATA_WIDTH),
+    .AXIS_KEEP_WIDTH        (AXIS_KEEP_WIDTH),
+    .AXIS_DEST_WIDTH        (AXIS_DEST_WIDTH),
+    .NUM_CHANNELS           (NUM_ACCEL)
 ) s2mm_pf (
     .clk_in(SRC_AXIS_clk),
-    .rst_in(SRC_AXIS_rst),
+    .rst_in(w_axis_rst),
 
     .SINK_AXIS_tready_in    (SINK_AXIS_tready),
     .SINK_AXIS_tdata_out    (SINK_AXIS_tdata),
@@ -495,8 +579,9 @@ assign w_status[7]                      = w_dtw_core_ref_busy;
 // assign w_status[31:24]                  = w_dtw_core_addrR_ref[7:0];
 assign w_status[31:9]                   = 0;
 assign SINK_AXIS_tid [AXIS_ID_WIDTH - 1:0]                      = {AXIS_ID_WIDTH{1'b0}};
-assign SINK_AXIS_tdest [AXIS_DEST_WIDTH - 1:0]                  = {{(AXIS_DEST_WIDTH-1){1'b0}}, 1'b1};
-assign SINK_AXIS_tkeep [AXIS_KEEP_WIDTH - 1:0]                  = {AXIS_KEEP_WIDTH{1'b1}};
+
+assign w_cohort_gather                  = (&w_cohort_wait) && (|w_cohort_ready);
+assign w_cohort_go                      = w_cohort_gather && ((&w_cohort_ready) || r_cohort_timer >= r_cohort);
 
 /* ===============================
  * synchronous logic
@@ -513,6 +598,12 @@ always @ (posedge S_AXI_clk) begin
         // Reset registers
         r_control       <=  0;
         r_ref_len       <=  0;
+        r_band          <=  0;
+        r_hits          <=  1;
+        r_strand        <=  0;
+        r_qlen          <=  SQG_SIZE;
+        r_thresh        <=  0;
+        r_cohort        <=  NUM_ACCEL * (SQG_SIZE + 2);
     end else begin
         if (w_reg_in_rdy) begin
             // M_AXI to here
@@ -545,6 +636,48 @@ always @ (posedge S_AXI_clk) begin
             end
             REG_CURR_QID: begin
             end
+            REG_NUM_ACCEL: begin
+            end
+            REG_BAND: begin
+                r_band <= {24'h0, w_reg_in_data[7:0]};
+            end
+            REG_HITS: begin
+                // 1 to HITS_MAX hits per result
+                if (w_reg_in_data == 0) begin
+                    r_hits <= 1;
+                end else if (w_reg_in_data > HITS_MAX) begin
+                    r_hits <= HITS_MAX;
+                end else begin
+                    r_hits <= w_reg_in_data;
+                end
+            end
+            REG_STRAND: begin
+                r_strand <= w_reg_in_data;
+            end
+            REG_QLEN: begin
+                // 1 to SQG_SIZE samples per query
+                if (w_reg_in_data == 0) begin
+                    r_qlen <= 1;
+                end else if (w_reg_in_data > SQG_SIZE) begin
+                    r_qlen <= SQG_SIZE;
+                end else begin
+                    r_qlen <= w_reg_in_data;
+                end
+            end
+            REG_THRESH: begin
+                // Early accept score, 0 sweeps the whole reference
+                r_thresh <= {16'h0, w_reg_in_data[DTW_DATA_WIDTH-1:0]};
+            end
+            REG_REF_SIZE: begin
+            end
+            REG_COHORT: begin
+                // Cycles the first full query waits for the others, at least 1
+                if (w_reg_in_data == 0) begin
+                    r_cohort <= 1;
+                end else begin
+                    r_cohort <= w_reg_in_data;
+                end
+            end
             default: begin // unknown address
                 $display ("Unknown address: 0x%h", w_reg_address);
                 r_reg_invalid_addr <= 1;
@@ -590,6 +723,31 @@ always @ (posedge S_AXI_clk) begin
             REG_CURR_QID: begin
                 r_reg_out_data <= w_dtw_core_curr_qid;
             end
+            REG_NUM_ACCEL: begin
+                r_reg_out_data <= NUM_ACCEL;
+            end
+            REG_BAND: begin
+                r_reg_out_data <= r_band;
+            end
+            REG_HITS: begin
+                r_reg_out_data <= r_hits;
+            end
+            REG_STRAND: begin
+                r_reg_out_data <= r_strand;
+            end
+            REG_QLEN: begin
+                r_reg_out_data <= r_qlen;
+            end
+            REG_THRESH: begin
+                r_reg_out_data <= r_thresh;
+            end
+            REG_REF_SIZE: begin
+                r_reg_out_data <= 1 << REFMEM_PTR_WIDTH;
+            end
+            REG_COHORT: begin
+                // 0: independent cores
+                r_reg_out_data <= (COHORT != 0) ? r_cohort : 0;
+            end
             default: begin // Unknown address
                 r_reg_out_data      <= 32'h00;
                 r_reg_invalid_addr  <= 1;
@@ -600,4 +758,20 @@ always @ (posedge S_AXI_clk) begin
     end
 end
 
+// Cohort gather window and shared reference read pointer
+always @ (posedge S_AXI_clk) begin
+    if (w_dtw_core_rst || !w_cohort_gather || w_cohort_go) begin
+        r_cohort_timer  <=  0;
+    end else begin
+        r_cohort_timer  <=  r_cohort_timer + 1;
+    end
+
+    // Address 0 until the cohort runs, then one sample per cycle like each core's addr_ref
+    if (|w_cohort_run) begin
+        r_cohort_addr   <=  r_cohort_addr + 1;
+    end else begin
+        r_cohort_addr   <=  0;
+    end
+end
+
 endmodule
\ No newline at end of file
@@ -344,16 +344,28 @@ dtw_core #(
     .WIDTH              (DTW_DATA_WIDTH),
     .AXIS_WIDTH         (AXIS_DATA_WIDTH),
     .REF_INIT           (0),
-    .REFMEM_PTR_WIDTH   (REFMEM_PTR_WIDTH)
+    .REFMEM_PTR_WIDTH   (REFMEM_PTR_WIDTH),
+    .HITS_MAX           (1)
 ) dc_0 (
     .clk                (S_AXI_clk),
     .rst                (w_dtw_core_rst),
     .rs                 (w_dtw_core_rs),
 
     .ref_len            (r_ref_len),
+    .band               (8'd0),             // unconstrained, no REG_BAND in this design
+    .hits               (8'd1),             // qid, position, score, no REG_HITS in this design
+    .strand             (32'd0),            // one strand, no REG_STRAND in this design
+    .qlen               (8'd0),             // SQG_SIZE samples, no REG_QLEN in this design
+    .thresh             (16'd0),            // full sweep, no REG_THRESH in this design
     .op_mode            (w_dtw_core_mode),
     .busy               (w_dtw_core_busy),
 
+    .cohort             (1'b0),             // independent, no COHORT in this design
+    .cohort_go          (1'b0),
+    .cohort_wait        (),
+    .cohort_ready       (),
+    .cohort_run         (),
+
     .src_fifo_clear     (w_src_fifo_clear),
     .src_fifo_rden      (w_src_fifo_r_stb),
     .src_fifo_empty     (w_src_fifo_empty),
@@ -36,7 +36,9 @@ module dtw_core #(
     parameter AXIS_WIDTH    = 32,   // AXI data width
     parameter SQG_SIZE      = 250,  // Squiggle size
     parameter REF_INIT      = 0,
-    parameter REFMEM_PTR_WIDTH = 20
+    parameter REFMEM_PTR_WIDTH = 20,
+    parameter HITS_MAX      = 8,    // Hits kept per query
+    parameter REF_LAG       = 0     // Reference read latency past one cycle (1 on port a)
 )(
     // Main DTW signals
     input   wire                    clk,
@@ -44,9 +46,21 @@ module dtw_core #(
     input   wire                    rs,
 
     input   wire [AXIS_WIDTH-1 : 0] ref_len,
+    input   wire [7:0]              band,               // Sakoe-Chiba band half width, 0: unconstrained
+    input   wire [7:0]              hits,               // Hits per result, 0/1: qid, position, score
+    input   wire [7:0]              qlen,               // Samples per query, 0: SQG_SIZE
+    input   wire [WIDTH-1 : 0]      thresh,             // Stop at the first score under it, 0: full sweep
+    input   wire [AXIS_WIDTH-1 : 0] strand,             // First word of the second strand, 0: one strand
     input   wire                    op_mode,            // Reference mode: 0, query mode: 1
     output  reg                     busy,               // Idle: 0, busy: 1
 
+    // Cohort signals, queries start together on cohort_go
+    input   wire                    cohort,             // Independent: 0, cohort: 1
+    input   wire                    cohort_go,          // Start the cores with a full shadow buffer
+    output  wire                    cohort_wait,        // Result sent, waiting for cohort_go
+    output  wire                    cohort_ready,       // Waiting with a full shadow buffer
+    output  wire                    cohort_run,         // Reading the reference
+
     // Src FIFO signals
     output  wire                    src_fifo_clear,     // Src FIFO Clear signal
     output  reg                     src_fifo_rden,      // Src FIFO Read enable
@@ -87,7 +101,10 @@ localparam [2:0] // n states
     REF_LOAD = 1,
     DTW_Q_INIT = 2,
     DTW_Q_RUN = 3,
-    DTW_Q_DONE = 4;
+    DTW_Q_DONE = 4,
+    DTW_Q_SWAP = 5,
+    DTW_Q_WAIT = 6;
+
 
 /* ===============================
  * registers/wires
@@ -101,12 +118,50 @@ wire                dp_done;            // dp core done
 reg  [31:0]         curr_qid;           // Current query id
 wire [WIDTH-1:0]    curr_minval;        // Current minimum value
 wire [31:0]         curr_position;      // Current best match position
+wire [HITS_MAX*WIDTH-1:0] hit_score;    // Best hits by score
+wire [HITS_MAX*32-1:0]    hit_pos;
+
+// Query length, the samples go to the last q_len PEs
+wire [7:0]          q_len = (qlen == 0 || qlen > SQG_SIZE) ? SQG_SIZE : qlen;
+wire [8:0]          query_words = q_len + 2;    // qid, pad word, samples
+
+// Result packet: qid, then {position, score} of each of the n_hits best hits
+wire [7:0]          n_hits = (hits > HITS_MAX) ? HITS_MAX : hits;
+wire                top_k = (n_hits > 1);
+wire [5:0]          n_words = top_k ? 2 * n_hits + 1 : 3;
+
+// Shadow squiggle buffer. While a query runs and its result drains, the next
+// query is read from the src FIFO: qid, pad word, then its samples go to the
+// datapath's shadow buffer. A full shadow buffer is swapped in as soon as the
+// result is sent, without going back to IDLE and streaming the query in.
+// Words of a streamed query that underran are skipped first, so the next
+// query still starts at its qid.
+reg  [8:0]          curr_words;         // words of the current query read so far
+reg  [8:0]          shadow_cnt;         // words of the next query read so far
+reg  [31:0]         shadow_qid;
+reg                 shadow_rd;          // src_fifo_rden was set by the shadow loader
+reg                 preloaded;          // current query was swapped in
+reg                 dp_swap;
+wire                fifo_pop    = src_fifo_rden && !src_fifo_empty;
+wire                curr_pop    = fifo_pop && (!shadow_rd || curr_words < query_words);
+wire                shadow_pop  = fifo_pop && shadow_rd && curr_words >= query_words;
+wire [8:0]          shadow_next = shadow_cnt + shadow_pop;
+wire                shadow_full = (shadow_cnt == query_words);
+wire                shadow_want = (shadow_next < query_words);
+wire                result_sent = !sink_fifo_full && stall_counter >= n_words;
+wire                shadow_idle = (shadow_cnt == 0) && !shadow_pop;
+
+// Cohort mode. Every query goes through the shadow buffer and waits in
+// DTW_Q_WAIT; the cores that hold one when cohort_go comes swap it in on the
+// same cycle and read the reference in lockstep, so one read pointer serves all.
+wire                cohort_leave = !rs || op_mode != MODE_NORMAL;
 
 // FSM state
 reg [2:0] r_state;
 
 // Others
-reg [1:0] stall_counter;
+reg [5:0] stall_counter;
+wire [4:0] hit_idx = (stall_counter - 1) >> 1;
 reg [31:0] r_dbg_nquery;
 
 /* ===============================
@@ -115,17 +170,29 @@ reg [31:0] r_dbg_nquery;
 // DTW datapath
 dtw_core_datapath #(
     .width      (WIDTH),
-    .SQG_SIZE   (SQG_SIZE)
+    .SQG_SIZE   (SQG_SIZE),
+    .HITS_MAX   (HITS_MAX),
+    .REF_LAG    (REF_LAG)
 ) inst_dtw_core_datapath (
     .clk            (clk),
     .rst            (dp_rst),
     .running        (dp_running),
     .Input_squiggle (src_fifo_data[15:0]),
     .Rword          (dataout_ref),
+    .swap           (dp_swap),
+    .shadow_wren    (shadow_pop && shadow_cnt >= 2),
+    .shadow_addr    (shadow_cnt[7:0] - 8'd1 + (SQG_SIZE - q_len)),
+    .shadow_data    (src_fifo_data[15:0]),
     .ref_len        (ref_len),
+    .band           (band),
+    .strand         (strand),
+    .qlen           (q_len),
+    .thresh         (thresh),
     .minval         (curr_minval),
     .position       (curr_position),
     .done           (dp_done),
+    .hit_score      (hit_score),
+    .hit_pos        (hit_pos),
 
     // debug
     .dbg_cycle_counter (dbg_cycle_counter)
@@ -135,6 +202,9 @@ dtw_core_datapath #(
  * asynchronous logic
  * =============================== */
 assign src_fifo_clear = r_src_fifo_clear;
+assign cohort_wait = (r_state == DTW_Q_WAIT);
+assign cohort_ready = (r_state == DTW_Q_WAIT) && shadow_full;
+assign cohort_run = (r_state == DTW_Q_RUN);
 assign dbg_state = r_state;
 assign dbg_addr_ref = addr_ref;
 assign dbg_nquery = r_dbg_nquery;
@@ -152,7 +222,7 @@ always @(posedge clk) begin
         IDLE: begin
             if (rs) begin
                 if (op_mode == MODE_NORMAL && ref_load_done == 1) begin
-                    r_state <= DTW_Q_INIT;
+                    r_state <= cohort ? DTW_Q_WAIT : DTW_Q_INIT;
                 end else begin
                     r_state <= IDLE;
                 end
@@ -161,7 +231,7 @@ always @(posedge clk) begin
             end
         end
         DTW_Q_INIT: begin
-            if (!src_fifo_empty) begin
+            if (preloaded || !src_fifo_empty) begin
                 r_state <= DTW_Q_RUN;
             end else begin
                 r_state <= DTW_Q_INIT;
@@ -175,12 +245,31 @@ always @(posedge clk) begin
             end
         end
         DTW_Q_DONE: begin
-            if (sink_fifo_full || stall_counter < 2'h3) begin
+            if (!result_sent) begin
+                r_state <= DTW_Q_DONE;
+            end else if (cohort) begin
+                r_state <= DTW_Q_WAIT;
+            end else if (shadow_full) begin
+                r_state <= DTW_Q_SWAP;
+            end else if (!shadow_idle) begin
+                // Next query partly read, wait for the rest
                 r_state <= DTW_Q_DONE;
             end else begin
                 r_state <= IDLE;
             end
         end
+        DTW_Q_SWAP: begin
+            r_state <= DTW_Q_INIT;
+        end
+        DTW_Q_WAIT: begin
+            if (cohort_leave) begin
+                r_state <= IDLE;
+            end else if (cohort_go && shadow_full) begin
+                r_state <= DTW_Q_SWAP;
+            end else begin
+                r_state <= DTW_Q_WAIT;
+            end
+        end
         endcase
     end
 end
@@ -199,20 +288,32 @@ always @(posedge clk) begin
         r_src_fifo_clear    <= 1;
         sink_fifo_last      <= 0;
         curr_qid            <= 0;
+        shadow_rd           <= 0;
+        preloaded           <= 0;
+        dp_swap             <= 0;
     end
     DTW_Q_INIT: begin
         busy                <= 1;
-        src_fifo_rden       <= 1;
         sink_fifo_wren      <= 0;
         dp_rst              <= 0;
+        dp_swap             <= 0;
         stall_counter       <= 0;
         r_src_fifo_clear    <= 0;
 
-        if (!src_fifo_empty) begin
-            curr_qid        <= src_fifo_data;
+        if (preloaded) begin
+            // Samples already in place, the FIFO belongs to the shadow loader
+            src_fifo_rden   <= shadow_want;
+            shadow_rd       <= shadow_want;
             dp_running      <= 1;
         end else begin
-            dp_running      <= 0;
+            src_fifo_rden   <= 1;
+            shadow_rd       <= 0;
+            if (!src_fifo_empty) begin
+                curr_qid    <= src_fifo_data;
+                dp_running  <= 1;
+            end else begin
+                dp_running  <= 0;
+            end
         end
     end
     DTW_Q_RUN: begin
@@ -222,8 +323,9 @@ always @(posedge clk) begin
         stall_counter           <= 0;
         r_src_fifo_clear        <= 0;
 
-        if (addr_ref < SQG_SIZE) begin
+        if (addr_ref < q_len && !preloaded) begin
             // Query loading
+            shadow_rd           <= 0;
             if (!src_fifo_empty) begin
                 addr_ref       <= addr_ref + 1;
                 src_fifo_rden   <= 1;
@@ -233,43 +335,108 @@ always @(posedge clk) begin
                 dp_running      <= 0;
             end
         end else begin
-            // Query loaded
+            // Query loaded, read the next one into the shadow buffer
             addr_ref           <= addr_ref + 1;
-            src_fifo_rden       <= 0;
+            src_fifo_rden       <= shadow_want;
+            shadow_rd           <= shadow_want;
             dp_running          <= 1;
         end
     end
     DTW_Q_DONE: begin
         busy            <= 1;
-        src_fifo_rden   <= 0;
         dp_rst          <= 0;
         dp_running      <= 0;
 
-        // Serialize output
-        if (!sink_fifo_full) begin
+        // Keep reading the next query, unless the core goes idle with none started
+        src_fifo_rden   <= shadow_want && (cohort || !(result_sent && shadow_idle));
+        shadow_rd       <= shadow_want && (cohort || !(result_sent && shadow_idle));
+
+        // Serialize output, once
+        if (!sink_fifo_full && stall_counter <= n_words) begin
             stall_counter <= stall_counter + 1;
 
             if (stall_counter == 0) begin
                 sink_fifo_last  <= 0;
                 sink_fifo_wren  <= 1;
                 sink_fifo_data  <= curr_qid;
-            end else if (stall_counter == 1) begin
+            end else if (top_k && stall_counter < n_words) begin
+                // Top-K: position at odd words, score at even words, tlast on the last score
+                sink_fifo_last  <= (stall_counter == n_words - 1);
+                sink_fifo_wren  <= 1;
+                sink_fifo_data  <= stall_counter[0] ? hit_pos[hit_idx*32 +: 32] : {16'b0, hit_score[hit_idx*WIDTH +: WIDTH]};
+            end else if (!top_k && stall_counter == 1) begin
                 sink_fifo_last  <= 0;
                 sink_fifo_wren  <= 1;
                 sink_fifo_data  <= curr_position;
-            end else if (stall_counter == 2) begin
-                sink_fifo_last  <= 0;
+            end else if (!top_k && stall_counter == 2) begin
+                // Last word of the result packet, tlast travels with it through the sink FIFO
+                sink_fifo_last  <= 1;
                 sink_fifo_wren  <= 1;
                 sink_fifo_data  <= {16'b0, curr_minval};
             end else begin
-                sink_fifo_last  <= 1;
+                sink_fifo_last  <= 0;
                 sink_fifo_wren  <= 0;
                 sink_fifo_data  <= 0;
                 r_dbg_nquery    <= r_dbg_nquery + 1;
             end
-        end 
+        end else if (stall_counter > n_words) begin
+            sink_fifo_last  <= 0;
+            sink_fifo_wren  <= 0;
+        end
+    end
+    DTW_Q_SWAP: begin
+        // Reset the datapath with the shadow buffer as its query
+        busy                <= 1;
+        src_fifo_rden       <= 0;
+        shadow_rd           <= 0;
+        sink_fifo_wren      <= 0;
+        sink_fifo_last      <= 0;
+        addr_ref            <= 0;
+        dp_rst              <= 1;
+        dp_swap             <= 1;
+        dp_running          <= 0;
+        stall_counter       <= 0;
+        r_src_fifo_clear    <= 0;
+        curr_qid            <= shadow_qid;
+        preloaded           <= 1;
+    end
+    DTW_Q_WAIT: begin
+        // Read the next query into the shadow buffer until the cohort starts
+        busy                <= !shadow_idle;
+        src_fifo_rden       <= shadow_want && !cohort_leave;
+        shadow_rd           <= shadow_want && !cohort_leave;
+        sink_fifo_wren      <= 0;
+        sink_fifo_last      <= 0;
+        addr_ref            <= 0;
+        dp_rst              <= 0;
+        dp_swap             <= 0;
+        dp_running          <= 0;
+        r_src_fifo_clear    <= 0;
     end
     endcase
 end
 
+// Shadow loader: count the words of both queries, the samples go to the datapath
+always @(posedge clk) begin
+    if (rst || r_state == IDLE) begin
+        curr_words <= 0;
+    end else if (r_state == DTW_Q_SWAP || r_state == DTW_Q_WAIT) begin
+        // Every word read from here on is the next query's
+        curr_words <= query_words;
+    end else if (curr_pop) begin
+        curr_words <= curr_words + 1;
+    end
+end
+
+always @(posedge clk) begin
+    if (rst || r_state == IDLE || r_state == DTW_Q_SWAP) begin
+        shadow_cnt <= 0;
+    end else if (shadow_pop) begin
+        shadow_cnt <= shadow_cnt + 1;
+        if (shadow_cnt == 0) begin
+            shadow_qid <= src_fifo_data;
+        end
+    end
+end
+
 endmodule
\ No newline at end of file
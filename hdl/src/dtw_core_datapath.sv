@@ -27,7 +27,11 @@ SOFTWARE. */
 
 module dtw_core_datapath #(
     parameter width     = 16,
-    parameter SQG_SIZE  = 250
+    parameter SQG_SIZE  = 250,
+    parameter OFF_WIDTH = 10,
+    parameter BAND_WIDTH = 8,
+    parameter HITS_MAX  = 8,
+    parameter REF_LAG   = 0     // Reference read latency past one cycle (1 on port a)
 )(
     input   wire                clk,
     input   wire                rst,
@@ -35,11 +39,23 @@ module dtw_core_datapath #(
 
     input   wire [width-1:0]    Input_squiggle, // Squiggle sample
     input   wire [width-1:0]    Rword,          // Reference sample
+    input   wire                swap,           // With rst: start from the shadow buffer
+    input   wire                shadow_wren,    // Shadow buffer write, next query's samples
+    input   wire [7:0]          shadow_addr,    // 1 to SQG_SIZE
+    input   wire [width-1:0]    shadow_data,
     input   wire [31:0]         ref_len,        // Reference length
+    input   wire [BAND_WIDTH-1:0] band,         // Sakoe-Chiba band half width, 0: unconstrained
+    input   wire [31:0]         strand,         // First word of the second strand, 0: one strand
+    input   wire [7:0]          qlen,           // Query length, 1 to SQG_SIZE: PEs SQG_SIZE - qlen + 1 on
+    input   wire [width-1:0]    thresh,         // Early accept below this score, 0: off
     output  wire [width-1:0]    minval,         // Minimum value
     output  wire [31:0]         position,       // Position of minimum value
     output  wire                done,           // Query search done
 
+    // Best non-overlapping hits by score, hit h at [h*width +: width] and [h*32 +: 32]
+    output  wire [HITS_MAX*width-1:0] hit_score,
+    output  wire [HITS_MAX*32-1:0]    hit_pos,
+
     // debug
     output  wire [31:0]         dbg_cycle_counter
 );
@@ -53,36 +69,76 @@ reg     [31:0]          cycle_counter;
 reg     [7:0]           squiggle_buffaddress;
 
 reg     [width-1:0]     Squiggle_Buffer [1:SQG_SIZE];
+reg     [width-1:0]     Shadow_Buffer   [1:SQG_SIZE];   // next query, no reset
 reg     [width-1:0]     Rword_buff;
 
+// Second strand: its first column travels down the PEs with its reference sample,
+// and each PE starts it like column 0, from W = NW = MAX
+reg     [31:0]          col_in;             // column of the next reference sample
+reg                     Rfirst_buff;
+reg                     p_Rfirst    [1:SQG_SIZE];
+wire    [31:0]          strand_col = strand + REF_LAG;
+
+// Short queries: the first PE of the query sees N = NW = 0 like PE 1, the PEs
+// above it run on but no path starts in them
+reg     [1:SQG_SIZE]    p_top;              // one hot, first PE of the query
+
 wire    [width-1:0]     DTW_curr    [1:SQG_SIZE];
 wire    [width-1:0]     p_Rword     [1:SQG_SIZE];
 
 reg     [width-1:0]     DTW_prev    [1:SQG_SIZE];
 reg     [width-1:0]     DTW_pprev   [1:SQG_SIZE];
+
+// Warp offsets of the cells in DTW_curr, DTW_prev and DTW_pprev
+wire signed [OFF_WIDTH-1:0] Off_curr  [1:SQG_SIZE];
+reg  signed [OFF_WIDTH-1:0] Off_prev  [1:SQG_SIZE];
+reg  signed [OFF_WIDTH-1:0] Off_pprev [1:SQG_SIZE];
 reg     [0:SQG_SIZE+1]  running_d;
 
 reg     [width-1:0]     Minval;
 reg     [31:0]          Minpos;
 reg     [width-1:0]     DTW_lastrow;
+reg                     lastrow_valid;      // DTW_lastrow holds a new column
+
+// Early accept: the first last row value under thresh ends the search, the
+// minimum and the hit list keep what they hold then
+reg                     Accept;
+wire                    accept_now = lastrow_valid && cycle_counter <= ref_len + 1 && DTW_lastrow < thresh;
+
+// Top-K hits. The candidate follows the last row minimum until qlen columns
+// pass without a better value, then it is inserted into the hit list.
+reg     [width-1:0]     Cand_score;
+reg     [31:0]          Cand_pos;
+reg     [width-1:0]     Hit_score   [0:HITS_MAX-1];
+reg     [31:0]          Hit_pos     [0:HITS_MAX-1];
+wire    [width-1:0]     Ins_score   [0:HITS_MAX-1];     // hit list with the candidate inserted
+wire    [31:0]          Ins_pos     [0:HITS_MAX-1];
+wire    [HITS_MAX-1:0]  hit_le;                         // hit h scores at most the candidate
 
 /* ===============================
  * submodules
  * =============================== */
-// First PE
+// First PE, N = NW = 0 is the alignment start: offset 0 after the step down
 dtw_core_pe #(
-    .width(width)
+    .width(width),
+    .OFF_WIDTH(OFF_WIDTH),
+    .BAND_WIDTH(BAND_WIDTH)
 ) inst_dtw_core_pe_001 (
     .clk  (clk),
     .rst  (rst),
     .running (running),
     .x    (Squiggle_Buffer[001]),
     .y    (Rword_buff),
-    .W    (DTW_prev[001]),
+    .W    (Rfirst_buff ? {(width){1'b1}} : DTW_prev[001]),
     .N    (16'd0),
     .NW   (16'd0),
     .DTWc (DTW_curr[001]),
-    .yp   (p_Rword[001])
+    .yp   (p_Rword[001]),
+    .band   (band),
+    .N_off  (1),
+    .W_off  (Rfirst_buff ? 0 : Off_prev[001]),
+    .NW_off (0),
+    .off    (Off_curr[001])
 );
 
 // Other PEs
@@ -90,18 +146,25 @@ genvar m;
 generate
 for (m = 2; m <= SQG_SIZE; m = m + 1) begin
 	dtw_core_pe #(
-        .width(width)
+        .width(width),
+        .OFF_WIDTH(OFF_WIDTH),
+        .BAND_WIDTH(BAND_WIDTH)
     ) inst_dtw_core_pe_n (
         .clk    (clk),
         .rst    (rst),
         .running (running),
         .x      (Squiggle_Buffer[m]),
         .y      (p_Rword[m-1]),
-        .W      (DTW_prev[m]),
-        .N      (DTW_prev[m-1]),
-        .NW     (DTW_pprev[m-1]),
+        .W      (p_Rfirst[m-1] ? {(width){1'b1}} : DTW_prev[m]),
+        .N      (p_top[m] ? 0 : DTW_prev[m-1]),
+        .NW     (p_top[m] ? 0 : p_Rfirst[m-1] ? {(width){1'b1}} : DTW_pprev[m-1]),
         .DTWc   (DTW_curr[m]),
-        .yp     (p_Rword[m])
+        .yp     (p_Rword[m]),
+        .band   (band),
+        .N_off  (p_top[m] ? 1 : Off_prev[m-1]),
+        .W_off  (p_Rfirst[m-1] ? 0 : Off_prev[m]),
+        .NW_off (p_top[m] || p_Rfirst[m-1] ? 0 : Off_pprev[m-1]),
+        .off    (Off_curr[m])
     );
 end
 endgenerate
@@ -109,11 +172,34 @@ endgenerate
 /* ===============================
  * asynchronous logic
  * =============================== */
+// Positions on the second strand count from its first word, with bit 31 set
+function [31:0] strand_pos(input [31:0] pos);
+    strand_pos = (strand != 0 && pos > strand_col) ? {1'b1, pos[30:0] - strand[30:0]} : pos;
+endfunction
+
 assign minval     = Minval;
-assign position   = Minpos;
-assign done       = (cycle_counter >= ref_len);
+assign position   = strand_pos(Minpos);
+assign done       = (cycle_counter >= ref_len) || Accept;
 assign dbg_cycle_counter = cycle_counter;
 
+// The list is sorted by score, so the candidate goes after the last hit that
+// scores at most as much: equal scores keep the earlier position first
+genvar h;
+generate
+for (h = 0; h < HITS_MAX; h = h + 1) begin
+    assign hit_le[h] = (Hit_score[h] <= Cand_score);
+    if (h == 0) begin
+        assign Ins_score[h] = hit_le[h] ? Hit_score[h] : Cand_score;
+        assign Ins_pos[h]   = hit_le[h] ? Hit_pos[h]   : Cand_pos;
+    end else begin
+        assign Ins_score[h] = hit_le[h] ? Hit_score[h] : hit_le[h-1] ? Cand_score : Hit_score[h-1];
+        assign Ins_pos[h]   = hit_le[h] ? Hit_pos[h]   : hit_le[h-1] ? Cand_pos   : Hit_pos[h-1];
+    end
+    assign hit_score[h*width +: width] = Ins_score[h];
+    assign hit_pos[h*32 +: 32]         = strand_pos(Ins_pos[h]);
+end
+endgenerate
+
 /* ===============================
  * synchronous logic
  * =============================== */
@@ -137,24 +223,28 @@ always @(posedge clk) begin
         for(k = 1; k <= SQG_SIZE; k = k + 1) begin
             DTW_prev [k] <= -1;
             DTW_pprev[k] <= -1;
+            Off_prev [k] <= 0;
+            Off_pprev[k] <= 0;
         end
     end else if (running) begin
         for(k = 1; k <= SQG_SIZE; k = k + 1) begin
             if(running_d[k]) begin
                 DTW_prev[k] <= DTW_curr[k];
+                Off_prev[k] <= Off_curr[k];
             end
             if(running_d[k+1]) begin
                 DTW_pprev[k] <= DTW_prev[k];
+                Off_pprev[k] <= Off_prev[k];
             end
         end
     end
 end
 
-// Load squiggle sample value
+// Load squiggle sample value, all at once from the shadow buffer on a swap
 always @(posedge clk) begin
     if (rst) begin
         for(k = 1; k <= SQG_SIZE; k = k + 1) begin
-            Squiggle_Buffer[k] <= 0;
+            Squiggle_Buffer[k] <= swap ? Shadow_Buffer[k] : 0;
         end
     end else if (running) begin
         if (running_d[0]) begin
@@ -163,10 +253,17 @@ always @(posedge clk) begin
     end
 end
 
-// Squiggle buffer address handling
+// Shadow buffer, written while the current query runs
+always @(posedge clk) begin
+    if (shadow_wren) begin
+        Shadow_Buffer[shadow_addr] <= shadow_data;
+    end
+end
+
+// Squiggle buffer address handling, a swapped in query is already loaded
 always @(posedge clk) begin
     if (rst) begin
-        squiggle_buffaddress <= 1;
+        squiggle_buffaddress <= swap ? SQG_SIZE + 1 : SQG_SIZE + 1 - qlen;
     end else if (running) begin
         if(running_d[0] && (squiggle_buffaddress <= SQG_SIZE)) begin
             squiggle_buffaddress <= squiggle_buffaddress + 1;
@@ -178,9 +275,36 @@ end
 always @(posedge clk) begin
     if (rst) begin
         Rword_buff <= 0;
+        Rfirst_buff <= 0;
+        col_in <= 0;
     end else if (running) begin
         if(running_d[0]) begin
             Rword_buff <= Rword;
+            Rfirst_buff <= (strand != 0) && (col_in == strand_col);
+            col_in <= col_in + 1;
+        end
+    end
+end
+
+// First PE of the query, fixed for the query
+always @(posedge clk) begin
+    if (rst) begin
+        for (k = 1; k <= SQG_SIZE; k = k + 1) begin
+            p_top[k] <= (k == SQG_SIZE + 1 - qlen);
+        end
+    end
+end
+
+// Second strand flag, one PE per cycle like yp
+always @(posedge clk) begin
+    if (rst) begin
+        for (k = 1; k <= SQG_SIZE; k = k + 1) begin
+            p_Rfirst[k] <= 0;
+        end
+    end else if (running) begin
+        p_Rfirst[1] <= Rfirst_buff;
+        for (k = 2; k <= SQG_SIZE; k = k + 1) begin
+            p_Rfirst[k] <= p_Rfirst[k-1];
         end
     end
 end
@@ -212,10 +336,51 @@ always @(posedge clk) begin
     if (rst) begin
         Minval <= -1;
         Minpos <= 0;
-    end else if (DTW_lastrow < Minval) begin
+    end else if (!Accept && DTW_lastrow < Minval) begin
         Minval <= DTW_lastrow;
         Minpos <= cycle_counter;
     end
 end
 
+always @(posedge clk) begin
+    if (rst) begin
+        lastrow_valid <= 0;
+    end else begin
+        lastrow_valid <= running && running_d[SQG_SIZE];
+    end
+end
+
+always @(posedge clk) begin
+    if (rst) begin
+        Accept <= 0;
+    end else if (accept_now) begin
+        Accept <= 1;
+    end
+end
+
+// Hit list update, over the columns that have a position (up to ref_len)
+always @(posedge clk) begin
+    if (rst) begin
+        Cand_score <= -1;
+        Cand_pos <= 0;
+        for (k = 0; k < HITS_MAX; k = k + 1) begin
+            Hit_score[k] <= -1;
+            Hit_pos[k] <= 0;
+        end
+    end else if (lastrow_valid && cycle_counter <= ref_len + 1 && !Accept) begin
+        if (cycle_counter - Cand_pos >= qlen) begin
+            // No longer overlaps the candidate: close it and start a new one
+            for (k = 0; k < HITS_MAX; k = k + 1) begin
+                Hit_score[k] <= Ins_score[k];
+                Hit_pos[k] <= Ins_pos[k];
+            end
+            Cand_score <= DTW_lastrow;
+            Cand_pos <= cycle_counter;
+        end else if (DTW_lastrow < Cand_score) begin
+            Cand_score <= DTW_lastrow;
+            Cand_pos <= cycle_counter;
+        end
+    end
+end
+
 endmodule
\ No newline at end of file
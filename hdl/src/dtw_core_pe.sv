@@ -26,7 +26,9 @@ SOFTWARE. */
 `timescale 1ns / 1ps 
 
 module dtw_core_pe #(
-    parameter width = 16  // data width
+    parameter width = 16,       // data width
+    parameter OFF_WIDTH = 10,   // warp offset width
+    parameter BAND_WIDTH = 8    // band register width
 )(
     input   wire                clk,
     input   wire                rst,
@@ -38,13 +40,21 @@ module dtw_core_pe #(
     input   wire [width-1:0]    W,          // west dependancy
     input   wire [width-1:0]    NW,         // northwest dependancy
     output  wire [width-1:0]    DTWc,       // DTW cost
-    output  reg  [width-1:0]    yp          // previous y sample
+    output  reg  [width-1:0]    yp,         // previous y sample
+
+    // Sakoe-Chiba band around the diagonal of the alignment start
+    input   wire [BAND_WIDTH-1:0]       band,   // band half width, 0: unconstrained
+    input   wire signed [OFF_WIDTH-1:0] N_off,  // warp offsets of the dependancies
+    input   wire signed [OFF_WIDTH-1:0] W_off,
+    input   wire signed [OFF_WIDTH-1:0] NW_off,
+    output  wire signed [OFF_WIDTH-1:0] off     // warp offset of this cell
 );
 
 /* ===============================
  * local parameters
  * =============================== */
 localparam MAX_BUF_VALUE = {(width){1'b1}};
+localparam signed [OFF_WIDTH:0] OFF_MAX = (1 << (OFF_WIDTH - 1)) - 1;
 
 /* ===============================
  * registes/wires
@@ -57,12 +67,23 @@ wire [width-1:0] cost = diff[width - 1] ? -diff : diff;
 wire [width-1:0] min2 = (N > W) ? W : N;
 wire [width-1:0] min3 = (min2 > NW)? NW : min2;
 
+// Warp offset (column - start column - row) of the path through the chosen dependancy:
+// a step down takes one off, a step right adds one, a diagonal step keeps it
+wire signed [OFF_WIDTH:0] off2 = (N > W) ? W_off + 1 : N_off - 1;
+wire signed [OFF_WIDTH:0] off3 = (min2 > NW) ? NW_off : off2;
+wire signed [OFF_WIDTH:0] off_sat = (off3 > OFF_MAX) ? OFF_MAX : (off3 < -OFF_MAX) ? -OFF_MAX : off3;
+wire        [OFF_WIDTH:0] off_abs = (off_sat < 0) ? -off_sat : off_sat;
+wire out_of_band = (band != 0) && (off_abs > band);
+
 /* ===============================
  * asynchronous logic
  * =============================== */
+assign off = off_sat[OFF_WIDTH-1:0];
+
 // Ensure buffer saturates when the cost accumulation has a value greater than 16 bits.
+// Cells outside the band are MAX, so no path goes through them.
 wire [width-1:0] cost_buf_space = MAX_BUF_VALUE - min3;
-assign DTWc = (cost < cost_buf_space) ? (cost + min3) : MAX_BUF_VALUE;
+assign DTWc = out_of_band ? MAX_BUF_VALUE : (cost < cost_buf_space) ? (cost + min3) : MAX_BUF_VALUE;
 
 /* ===============================
  * synchronous logic
@@ -14,7 +14,8 @@ module dtw_core_ref #(
     parameter DATA_WIDTH                            = 16,   // Data width
     parameter ADDR_WIDTH                            = 32,   // AXI data width
     parameter REF_INIT                              = 0,
-    parameter REFMEM_PTR_WIDTH                      = 20
+    parameter REFMEM_PTR_WIDTH                      = 20,
+    parameter NUM_PORTS                             = 2     // Reader ports, one per DTW core
 ) (
     // Main Module signals
     input   wire                                    clk_in,
@@ -31,11 +32,10 @@ module dtw_core_ref #(
     input   wire                                    src_fifo_empty_in,     // Src FIFO Empty
     input   wire [DATA_WIDTH-1:0]                   src_fifo_data_in,      // Src FIFO Data
 
-    // Ref mem signals
-    input   wire [REFMEM_PTR_WIDTH-1: 0]            ref_addr_0_in,
-    input   wire [REFMEM_PTR_WIDTH-1: 0]            ref_addr_1_in,
-    output  reg  [DATA_WIDTH-1:0]                   ref_data_0_out,
-    output  reg  [DATA_WIDTH-1:0]                   ref_data_1_out,
+    // Ref mem signals, port p at [p*REFMEM_PTR_WIDTH +: REFMEM_PTR_WIDTH] and [p*DATA_WIDTH +: DATA_WIDTH].
+    // Even ports read through port a of a replica and see the data one cycle later.
+    input   wire [NUM_PORTS*REFMEM_PTR_WIDTH-1: 0]  ref_addr_in,
+    output  wire [NUM_PORTS*DATA_WIDTH-1:0]         ref_data_out,
 
     // Debug signals
     output  wire [1:0]                              dbg_state,
@@ -56,13 +56,17 @@ localparam [1:0] // n states
     REF_LOAD = 1,
     DTW_READ = 2;
 
+// One dual port replica per two readers, all written by the loader
+localparam NUM_BANKS = (NUM_PORTS + 1) / 2;
+
 /* ===============================
  * registers/wires
  * =============================== */
 reg                                         ref_load_done;
 reg                                         r_src_fifo_clear;
 reg                                         wren_ref_node_0;           // Write enable for refmem
-reg [REFMEM_PTR_WIDTH-1:0]                  ref_addr_node_0;
+reg [REFMEM_PTR_WIDTH-1:0]                  ref_addr_node [0:NUM_BANKS-1];  // port a of every replica, the write address
+integer k;
 
 // FSM state
 reg [1:0] r_state;
@@ -71,30 +75,46 @@ reg [1:0] r_state;
 /* ===============================
  * submodules
  * =============================== */
-// Reference memory
-dtw_core_ref_mem #(
-    .width      (DATA_WIDTH),
-    .initalize  (REF_INIT),
-    .ptrWid     (REFMEM_PTR_WIDTH)
-) inst_dtw_core_ref_mem (
-    .clk            (clk_in),
-
-    .wen_a          (wren_ref_node_0),
-    .addr_a         (ref_addr_node_0[REFMEM_PTR_WIDTH-1:0]),
-    .din_a          (src_fifo_data_in),
-    .dout_a         (ref_data_0_out),
-
-    .wen_b          (1'b0),
-    .addr_b         (ref_addr_1_in[REFMEM_PTR_WIDTH-1:0]),
-    .din_b          ('d0),
-    .dout_b         (ref_data_1_out)
-);
+// Reference memory, replicated per pair of readers. Every replica is written with the
+// same word at the same address, so the readers of all pairs see the same contents.
+genvar b;
+generate
+for (b = 0; b < NUM_BANKS; b = b + 1) begin : bank
+    wire [REFMEM_PTR_WIDTH-1:0] addr_b;     // odd reader, none past the last port
+    wire [DATA_WIDTH-1:0]       data_b;
+
+    dtw_core_ref_mem #(
+        .width      (DATA_WIDTH),
+        .initalize  (REF_INIT),
+        .ptrWid     (REFMEM_PTR_WIDTH)
+    ) inst_dtw_core_ref_mem (
+        .clk            (clk_in),
+
+        .wen_a          (wren_ref_node_0),
+        .addr_a         (ref_addr_node[b]),
+        .din_a          (src_fifo_data_in),
+        .dout_a         (ref_data_out[2*b*DATA_WIDTH +: DATA_WIDTH]),
+
+        .wen_b          (1'b0),
+        .addr_b         (addr_b),
+        .din_b          ('d0),
+        .dout_b         (data_b)
+    );
+
+    if (2*b+1 < NUM_PORTS) begin
+        assign addr_b = ref_addr_in[(2*b+1)*REFMEM_PTR_WIDTH +: REFMEM_PTR_WIDTH];
+        assign ref_data_out[(2*b+1)*DATA_WIDTH +: DATA_WIDTH] = data_b;
+    end else begin
+        assign addr_b = 'd0;
+    end
+end
+endgenerate
 
 /* ===============================
  * asynchronous logic
  * =============================== */
 assign dbg_state = r_state;
-assign dbg_addr_ref = ref_addr_node_0;
+assign dbg_addr_ref = ref_addr_node[0];
 assign dbg_wren_ref = wren_ref_node_0;
 
 assign ref_load_done_out = ref_load_done;
@@ -124,7 +144,7 @@ always @(posedge clk_in) begin
         end
 
         REF_LOAD: begin
-            if (ref_addr_node_0[REFMEM_PTR_WIDTH-1:0] < ref_len_in[REFMEM_PTR_WIDTH-1:0]) begin
+            if (ref_addr_node[0][REFMEM_PTR_WIDTH-1:0] < ref_len_in[REFMEM_PTR_WIDTH-1:0]) begin
                 r_state <= REF_LOAD;
             end else begin
                 r_state <= IDLE;
@@ -149,10 +169,12 @@ always @(posedge clk_in) begin
         wren_ref_node_0 <= 1'b0;
         r_src_fifo_clear <= 1'b1;
 
-        if (op_mode_in == MODE_DTW_READ) begin
-            ref_addr_node_0 <= ref_addr_0_in;
-        end else begin
-            ref_addr_node_0 <= 'd0;
+        for (k = 0; k < NUM_BANKS; k = k + 1) begin
+            if (op_mode_in == MODE_DTW_READ) begin
+                ref_addr_node[k] <= ref_addr_in[2*k*REFMEM_PTR_WIDTH +: REFMEM_PTR_WIDTH];
+            end else begin
+                ref_addr_node[k] <= 'd0;
+            end
         end
     end
 
@@ -161,15 +183,20 @@ always @(posedge clk_in) begin
         src_fifo_rden_out <= 1'b1;
         r_src_fifo_clear <= 1'b0;
 
+        // All replicas follow the write address of the first one
         if (!src_fifo_empty_in && src_fifo_rden_out) begin
-            ref_addr_node_0 <= ref_addr_node_0 + 1'b1;
+            for (k = 0; k < NUM_BANKS; k = k + 1) begin
+                ref_addr_node[k] <= ref_addr_node[0] + 1'b1;
+            end
             wren_ref_node_0 <= 1'b1;
         end else begin
             wren_ref_node_0 <= 1'b0;
-            ref_addr_node_0 <= ref_addr_node_0;
+            for (k = 0; k < NUM_BANKS; k = k + 1) begin
+                ref_addr_node[k] <= ref_addr_node[0];
+            end
         end
 
-        if (!(src_fifo_empty_in) && (ref_addr_node_0[REFMEM_PTR_WIDTH-1:0] == (ref_len_in[REFMEM_PTR_WIDTH-1:0] - 1'b1))) begin
+        if (!(src_fifo_empty_in) && (ref_addr_node[0][REFMEM_PTR_WIDTH-1:0] == (ref_len_in[REFMEM_PTR_WIDTH-1:0] - 1'b1))) begin
             ref_load_done <= 1'b1;
         end else begin
             ref_load_done <= 1'b0;
@@ -182,10 +209,12 @@ always @(posedge clk_in) begin
         wren_ref_node_0 <= 1'b0;
         r_src_fifo_clear <= 1'b0;
 
-        if (op_mode_in == MODE_LOAD_REF) begin
-            ref_addr_node_0 <= 'd0;
-        end else begin
-            ref_addr_node_0 <= ref_addr_0_in;
+        for (k = 0; k < NUM_BANKS; k = k + 1) begin
+            if (op_mode_in == MODE_LOAD_REF) begin
+                ref_addr_node[k] <= 'd0;
+            end else begin
+                ref_addr_node[k] <= ref_addr_in[2*k*REFMEM_PTR_WIDTH +: REFMEM_PTR_WIDTH];
+            end
         end
     end
     endcase
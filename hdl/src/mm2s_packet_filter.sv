@@ -14,7 +14,7 @@ module mm2s_packet_filter #(
     // FIFO peripherals
     output  wire [NUM_FIFOS-1:0]                    fifo_wren,     // Sink FIFO Write enable
     input   wire [NUM_FIFOS-1:0]                   fifo_full,     // Sink FIFO Full
-    output  wire [FIFO_DATA_WIDTH-1:0]              fifo_data     // Sink FIFO Data
+    output  wire [FIFO_DATA_WIDTH-1:0]              fifo_data     // Sink FIFO Data, shared by all FIFOs
 );
 
 /* ===============================
@@ -32,8 +32,10 @@ generate
     for (i = 0; i < NUM_FIFOS; i = i + 1) begin
         assign fifo_wren[i] = ((SRC_AXIS_tdest == i) && (SRC_AXIS_tvalid) && (!fifo_full[i])) ? 1'b1 : 1'b0;
         assign fifo_not_ready[i] = ((SRC_AXIS_tdest == i) && (SRC_AXIS_tvalid) && (fifo_full[i])) ? 1'b1 : 1'b0;
-        assign fifo_data[i] = SRC_AXIS_tdata[FIFO_DATA_WIDTH-1:0];
     end
 endgenerate
 
+// Only the FIFO selected by tdest is write enabled, so every FIFO can share the data bus
+assign fifo_data = SRC_AXIS_tdata[FIFO_DATA_WIDTH-1:0];
+
 endmodule
\ No newline at end of file
@@ -19,7 +19,7 @@ module s2mm_packet_filter #(
     output wire                             SINK_AXIS_tvalid_out,
 
     // FIFO Peripherals
-    input  wire [FIFO_DATA_WIDTH - 1: 0]    fifo_data_in,
+    input  wire [NUM_CHANNELS*FIFO_DATA_WIDTH-1:0] fifo_data_in,   // Channel i at [i*FIFO_DATA_WIDTH +: FIFO_DATA_WIDTH]
     input  wire [NUM_CHANNELS-1:0]          fifo_not_empty_in,
     input  wire [NUM_CHANNELS-1:0]          fifo_last_in,
     output wire [NUM_CHANNELS-1:0]          fifo_r_stb_out
@@ -27,98 +27,69 @@ module s2mm_packet_filter #(
 /* ===============================
  * local parameters
  * =============================== */
+localparam SEL_WIDTH = (NUM_CHANNELS > 1) ? $clog2(NUM_CHANNELS) : 1;
 
 /* ===============================
  * registers / wires
  * =============================== */
-reg  [NUM_CHANNELS-1:0]                     channel_en;
-reg  [NUM_CHANNELS-1:0]                     channel_shift_reg;
-reg  [AXIS_DATA_WIDTH-1:0]                  tdata_buf;
-reg  [AXIS_DEST_WIDTH-1:0]                  tdest_buf;
-reg                                         tlast_buf;
+// A channel owns the stream from its first beat until tlast so that the
+// results of one core are never interleaved with the results of another.
+reg  [SEL_WIDTH-1:0]                        r_sel;
+reg                                         r_locked;
+reg  [SEL_WIDTH-1:0]                        w_next_sel;
+reg                                         w_next_found;
+wire                                        w_handshake;
 
 /* ===============================
  * asynchronous logic
  * =============================== */
 assign SINK_AXIS_tuser_out = 'd0;
 assign SINK_AXIS_tkeep_out = {AXIS_KEEP_WIDTH{1'b1}};
-assign fifo_r_stb_out[NUM_CHANNELS-1:0] = channel_en[NUM_CHANNELS-1:0];
-assign SINK_AXIS_tvalid_out = ^channel_en;
+assign SINK_AXIS_tvalid_out = r_locked & fifo_not_empty_in[r_sel];
+assign SINK_AXIS_tdata_out = fifo_data_in[r_sel*FIFO_DATA_WIDTH +: FIFO_DATA_WIDTH];
+assign SINK_AXIS_tdest_out = r_sel;
+assign SINK_AXIS_tlast_out = fifo_last_in[r_sel];
+assign w_handshake = SINK_AXIS_tvalid_out & SINK_AXIS_tready_in;
 
-// data out
-always @(*) begin
-    tdata_buf = {AXIS_DATA_WIDTH{1'b0}};
-    for (integer i = 0; i < NUM_CHANNELS; i = i + 1) begin
-        tdata_buf[AXIS_DATA_WIDTH-1:0] = (channel_en[i]) ? fifo_data_in[i] : tdata_buf[AXIS_DATA_WIDTH-1:0];
-    end
-end
-assign SINK_AXIS_tdata_out = tdata_buf;
-
-// tdest
-always @(*) begin
-    tdest_buf = {AXIS_DEST_WIDTH{1'b0}};
-    for (integer i = 0; i < NUM_CHANNELS; i = i + 1) begin
-        tdest_buf[AXIS_DEST_WIDTH-1:0] = (channel_en[i]) ? i[AXIS_DEST_WIDTH-1:0] : tdest_buf;
+genvar i;
+generate
+    for (i = 0; i < NUM_CHANNELS; i = i + 1) begin
+        assign fifo_r_stb_out[i] = w_handshake && (r_sel == i);
     end
-end
-assign SINK_AXIS_tdest_out = tdest_buf;
+endgenerate
 
-// tlast
+// Round robin: next non-empty channel after the one that was last served
 always @(*) begin
-    tlast_buf = 1'b0;
-    for (integer i = 0; i < NUM_CHANNELS; i = i + 1) begin
-        tlast_buf = tlast_buf | (channel_en[i] & fifo_last_in[i]);
+    w_next_sel = r_sel;
+    w_next_found = 1'b0;
+    for (integer k = 1; k <= NUM_CHANNELS; k = k + 1) begin
+        if (!w_next_found && fifo_not_empty_in[(r_sel + k) % NUM_CHANNELS]) begin
+            w_next_sel = (r_sel + k) % NUM_CHANNELS;
+            w_next_found = 1'b1;
+        end
     end
 end
-assign SINK_AXIS_tlast_out = tlast_buf;
 
 /* ===============================
  * synchronous logic
  * =============================== */
-// Channel Enable
 always @(posedge clk_in) begin
     if (rst_in) begin
-        channel_en[NUM_CHANNELS-1:0] <= {NUM_CHANNELS{1'b0}};
+        r_sel       <= NUM_CHANNELS - 1;
+        r_locked    <= 1'b0;
     end
     else begin
-        if (!SINK_AXIS_tready_in) begin
-            // Don't send anything when the DMA is not ready
-            channel_en[NUM_CHANNELS-1:0] <= {NUM_CHANNELS{1'b0}};
-        end
-        else if (^fifo_not_empty_in[NUM_CHANNELS-1:0]) begin
-            // Only one fifo is ready for transfer
-            channel_en[NUM_CHANNELS-1:0] <= fifo_not_empty_in[NUM_CHANNELS-1:0];
-        end
-        else if (|fifo_not_empty_in[NUM_CHANNELS-1:0]) begin
-            // Multiple fifos are ready for transfer
-            // Rotate between fifos until only one fifo is left
-            channel_en[NUM_CHANNELS-1:0] <= channel_shift_reg[NUM_CHANNELS-1:0];
-        end
-        else begin
-            // No fifos ready, disable all channels
-            channel_en[NUM_CHANNELS-1:0] <= {NUM_CHANNELS{1'b0}};
-        end
-    end
-end
-
-// Channel shift register
-always @(posedge clk_in) begin
-    if (rst_in) begin
-        channel_shift_reg[NUM_CHANNELS-1:0] <= {{(NUM_CHANNELS-1){1'b0}}, 1'b1};
-    end
-    else begin
-        if (SINK_AXIS_tready_in && |fifo_not_empty_in[NUM_CHANNELS-1:0]) begin
-            if (channel_shift_reg[NUM_CHANNELS-1:0] == {1'b1, {(NUM_CHANNELS-1){1'b0}}}) begin
-                channel_shift_reg[NUM_CHANNELS-1:0] <= {{(NUM_CHANNELS-1){1'b0}}, 1'b1};
-            end
-            else begin
-                channel_shift_reg[NUM_CHANNELS-1:0] <= {{(NUM_CHANNELS-1){1'b0}}, 1'b1};
+        if (!r_locked) begin
+            if (w_next_found) begin
+                r_sel       <= w_next_sel;
+                r_locked    <= 1'b1;
             end
         end
-        else begin
-            channel_shift_reg <= channel_shift_reg;
+        else if (w_handshake && SINK_AXIS_tlast_out) begin
+            // Packet done, give the other channels a turn
+            r_locked    <= 1'b0;
         end
     end
 end
 
-endmodule
\ No newline at end of file
+endmodule
@@ -32,7 +32,10 @@ module tb_dtw_accel #(
     parameter ADDR_WIDTH          = 32,
     parameter DATA_WIDTH          = 32,
     parameter AXIS_DATA_WIDTH     = 32,
-    parameter STROBE_WIDTH        = (DATA_WIDTH / 8)
+    parameter AXIS_DEST_WIDTH     = 4,
+    parameter STROBE_WIDTH        = (DATA_WIDTH / 8),
+    parameter NUM_ACCEL           = 2,
+    parameter COHORT              = 0
 )(
     input                               clk,
     input                               rst,
@@ -75,14 +78,16 @@ module tb_dtw_accel #(
     output                              axis_in_tready,
     input                               axis_in_tlast,
     input       [AXIS_DATA_WIDTH - 1:0] axis_in_tdata,
+    input       [AXIS_DEST_WIDTH - 1:0] axis_in_tdest,      // core the frame goes to
 
     `ifdef AXIS_OUT_TUSER_EN
-    input                               axis_out_tuser,
+    output                              axis_out_tuser,
     `endif
-    input                               axis_out_tvalid,
-    output                              axis_out_tready,
-    input                               axis_out_tlast,
-    input       [AXIS_DATA_WIDTH - 1:0] axis_out_tdata
+    output                              axis_out_tvalid,
+    input                               axis_out_tready,
+    output                              axis_out_tlast,
+    output      [AXIS_DATA_WIDTH - 1:0] axis_out_tdata,
+    output      [AXIS_DEST_WIDTH - 1:0] axis_out_tdest      // core the result comes from
 );
 
 /* ===============================
@@ -103,8 +108,11 @@ dtw_accel #(
     .ADDR_WIDTH       (ADDR_WIDTH),
     .DATA_WIDTH       (DATA_WIDTH),
     .AXIS_DATA_WIDTH  (AXIS_DATA_WIDTH),
+    .AXIS_DEST_WIDTH  (AXIS_DEST_WIDTH),
     .INVERT_AXI_RESET (0),
-    .INVERT_AXIS_RESET(0)
+    .INVERT_AXIS_RESET(0),
+    .NUM_ACCEL        (NUM_ACCEL),
+    .COHORT           (COHORT)
 ) dut (
     .S_AXI_clk        (clk),
     .S_AXI_rst        (r_rst),
@@ -143,6 +151,7 @@ dtw_accel #(
     .SRC_AXIS_tready (axis_in_tready),
     .SRC_AXIS_tlast  (axis_in_tlast),
     .SRC_AXIS_tdata  (axis_in_tdata),
+    .SRC_AXIS_tdest  (axis_in_tdest),
 
     // Output AXI Stream
     .SINK_AXIS_clk   (axis_clk),
@@ -150,12 +159,13 @@ dtw_accel #(
 `ifdef AXIS_IN_TUSER_EN
     .SINK_AXIS_tuser (axis_out_tuser),
 `else
-    .SINK_AXIS_tuser (1'b0),
+    .SINK_AXIS_tuser (),
 `endif
     .SINK_AXIS_tvalid(axis_out_tvalid),
     .SINK_AXIS_tready(axis_out_tready),
     .SINK_AXIS_tlast (axis_out_tlast),
-    .SINK_AXIS_tdata (axis_out_tdata)
+    .SINK_AXIS_tdata (axis_out_tdata),
+    .SINK_AXIS_tdest (axis_out_tdest)
 );
 
 endmodule
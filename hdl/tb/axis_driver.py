@@ -70,9 +70,10 @@ class AXISSource:
             print ("Cycle List needs to be a list")
         self.source.set_pause_generator(itertools.cycle(cycle_list))
 
-    async def send_raw_data(self, data_list):
+    async def send_raw_data(self, data_list, tdest = 0):
+        # tdest picks the core, the reference loader reads core 0's FIFO
         for data in data_list:
-            d = AxiStreamFrame(data, tid = self.cur_id, tdest = self.cur_id)
+            d = AxiStreamFrame(data, tid = self.cur_id, tdest = tdest)
             await self.source.send(d)
             self.cur_id += 1
 
@@ -43,6 +43,14 @@ REG_STATUS  = 1 << 2;
 REG_REF_LEN = 2 << 2;
 REG_VERSION = 3 << 2;
 REG_KEY     = 4 << 2;
+REG_NUM_ACCEL = 12 << 2;
+REG_BAND    = 13 << 2;
+REG_HITS    = 14 << 2;
+REG_STRAND  = 15 << 2;
+REG_QLEN    = 16 << 2;
+REG_THRESH  = 17 << 2;
+REG_REF_SIZE = 18 << 2;
+REG_COHORT  = 19 << 2;
 
 # CR bits
 CR_RESET    = 0;
@@ -129,6 +137,106 @@ class DtwAccelDriver (Driver):
         data = await self.read_register(REG_KEY)
         return data
 
+    ## Number of DTW cores
+    async def get_num_accel(self):
+        """
+        Get the number of DTW cores synthesized
+        """
+        data = await self.read_register(REG_NUM_ACCEL)
+        return data
+
+    ## Band
+    async def set_band(self, data):
+        """
+        Set the Sakoe-Chiba band half width (0: unconstrained)
+        """
+        await self.write_register(REG_BAND, data)
+
+    async def get_band(self):
+        """
+        Get the band register
+        """
+        data = await self.read_register(REG_BAND)
+        return data
+
+    ## Hits per result
+    async def set_hits(self, data):
+        """
+        Set the number of hits per result packet (1: qid, position, score)
+        """
+        await self.write_register(REG_HITS, data)
+
+    async def get_hits(self):
+        """
+        Get the hits register
+        """
+        data = await self.read_register(REG_HITS)
+        return data
+
+    ## Strands
+    async def set_strand(self, data):
+        """
+        Set the first reference word of the second strand (0: one strand)
+        """
+        await self.write_register(REG_STRAND, data)
+
+    async def get_strand(self):
+        """
+        Get the strand register
+        """
+        data = await self.read_register(REG_STRAND)
+        return data
+
+    ## Query length
+    async def set_qlen(self, data):
+        """
+        Set the number of samples per query (1 to SQG_SIZE)
+        """
+        await self.write_register(REG_QLEN, data)
+
+    async def get_qlen(self):
+        """
+        Get the query length register
+        """
+        data = await self.read_register(REG_QLEN)
+        return data
+
+    ## Early accept
+    async def set_thresh(self, data):
+        """
+        Set the early accept score (0: sweep the whole reference)
+        """
+        await self.write_register(REG_THRESH, data)
+
+    async def get_thresh(self):
+        """
+        Get the early accept register
+        """
+        data = await self.read_register(REG_THRESH)
+        return data
+
+    ## Reference memory
+    async def get_ref_size(self):
+        """
+        Get the number of words of the reference memory
+        """
+        data = await self.read_register(REG_REF_SIZE)
+        return data
+
+    ## Cohort
+    async def set_cohort(self, data):
+        """
+        Set the cycles a cohort waits for its queries after the first one is in
+        """
+        await self.write_register(REG_COHORT, data)
+
+    async def get_cohort(self):
+        """
+        Get the cohort register (0: independent cores)
+        """
+        data = await self.read_register(REG_COHORT)
+        return data
+
     ## others
 
     # Set a bit within a register
@@ -61,6 +61,20 @@ def reset_dut(dut):
     dut.axis_rst.value = 0
     yield Timer(CLK_PERIOD * AXIS_CLK_PERIOD * 2)
 
+@cocotb.coroutine
+def monitor_cohort_run(dut, starts):
+    # Append the cycles on which each core starts reading the reference
+    cycle = 0
+    last = 0
+    while True:
+        yield RisingEdge(dut.clk)
+        run = dut.dut.w_cohort_run.value.integer
+        for i in range(len(starts)):
+            if (run >> i) & 1 and not (last >> i) & 1:
+                starts[i].append(cycle)
+        last = run
+        cycle += 1
+
 ###############################################################################
 ## Test read version
 ###############################################################################
@@ -590,5 +604,731 @@ def test_load_small_query(dut):
     assert len(rdata) == 1
     assert len(rdata[0]) == 3
     assert rdata[0][0] == 1
-    assert rdata[0][1] == 450
-    assert rdata[0][2] == 0
\ No newline at end of file
+    assert rdata[0][1] == 451
+    assert rdata[0][2] == 0
+
+###############################################################################
+## Test get number of cores
+###############################################################################
+@cocotb.test(skip = False)
+def test_get_num_accel(dut):
+    """
+    Description:
+        Get the number of DTW cores from the NUM_ACCEL register
+
+    Test ID: 7
+
+    Expected Results:
+        NUM_ACCEL register == NUM_ACCEL parameter of the design
+    """
+    ## Init
+    dut._log.setLevel(logging.WARNING)
+    dut.test_id.value = 7
+    setup_dut(dut)
+    tester = DtwAccelDriver(dut, "aximl", dut.clk, dut.rst, debug = False)
+    yield reset_dut(dut)
+
+    ## Body
+    num_accel = yield tester.get_num_accel()
+    assert num_accel == dut.dut.NUM_ACCEL.value
+
+    ## cleanup
+    yield Timer(CLK_PERIOD * 20)
+    dut._log.debug("Done")
+
+###############################################################################
+## Test setting and reading the band
+###############################################################################
+@cocotb.test(skip = False)
+def test_band(dut):
+    """
+    Description:
+        Set the band register and read it back
+
+    Test ID: 8
+
+    Expected Results:
+        The register keeps the 8 bit half width, 0 after reset
+    """
+    ## Init
+    dut._log.setLevel(logging.WARNING)
+    dut.test_id.value = 8
+    setup_dut(dut)
+    tester = DtwAccelDriver(dut, "aximl", dut.clk, dut.rst, debug = False)
+    yield reset_dut(dut)
+
+    ## Body
+    band = yield tester.get_band()
+    assert band == 0
+    yield tester.set_band(25)
+    assert dut.dut.r_band.value == 25
+    band = yield tester.get_band()
+    assert band == 25
+    yield tester.set_band(0x1ff)
+    band = yield tester.get_band()
+    assert band == 0xff
+
+    ## cleanup
+    yield Timer(CLK_PERIOD * 20)
+    dut._log.debug("Done")
+
+###############################################################################
+## Test setting and reading the hits per result
+###############################################################################
+@cocotb.test(skip = False)
+def test_hits(dut):
+    """
+    Description:
+        Set the hits register and read it back
+
+    Test ID: 9
+
+    Expected Results:
+        The register is 1 after reset and keeps 1 to HITS_MAX hits
+    """
+    ## Init
+    dut._log.setLevel(logging.WARNING)
+    dut.test_id.value = 9
+    setup_dut(dut)
+    tester = DtwAccelDriver(dut, "aximl", dut.clk, dut.rst, debug = False)
+    yield reset_dut(dut)
+
+    ## Body
+    hits = yield tester.get_hits()
+    assert hits == 1
+    yield tester.set_hits(4)
+    assert dut.dut.r_hits.value == 4
+    hits = yield tester.get_hits()
+    assert hits == 4
+    yield tester.set_hits(0)
+    hits = yield tester.get_hits()
+    assert hits == 1
+    yield tester.set_hits(0x100)
+    hits = yield tester.get_hits()
+    assert hits == dut.dut.HITS_MAX.value
+
+    ## cleanup
+    yield Timer(CLK_PERIOD * 20)
+    dut._log.debug("Done")
+
+###############################################################################
+## Test setting and reading the strand boundary
+###############################################################################
+@cocotb.test(skip = False)
+def test_strand(dut):
+    """
+    Description:
+        Set the strand register and read it back
+
+    Test ID: 10
+
+    Expected Results:
+        The register is 0 after reset and keeps the first word of the second strand
+    """
+    ## Init
+    dut._log.setLevel(logging.WARNING)
+    dut.test_id.value = 10
+    setup_dut(dut)
+    tester = DtwAccelDriver(dut, "aximl", dut.clk, dut.rst, debug = False)
+    yield reset_dut(dut)
+
+    ## Body
+    strand = yield tester.get_strand()
+    assert strand == 0
+    yield tester.set_strand(2000)
+    assert dut.dut.r_strand.value == 2000
+    strand = yield tester.get_strand()
+    assert strand == 2000
+
+    ## cleanup
+    yield Timer(CLK_PERIOD * 20)
+    dut._log.debug("Done")
+
+###############################################################################
+## Test back to back queries
+###############################################################################
+@cocotb.test(skip = False)
+def test_load_query_back_to_back(dut):
+    """
+    Description:
+        Send two queries in one go, the second one is loaded into the
+        shadow buffer while the first one runs
+
+    Test ID: 11
+
+    Expected Results:
+        Both results come back in order, each with its own qid and match
+    """
+    ## Init
+    dut._log.setLevel(logging.WARNING)
+    dut.test_id.value = 11
+    setup_dut(dut)
+    tester = DtwAccelDriver(dut, "aximl", dut.clk, dut.rst, debug = False)
+    axis_source = AXISSource(dut, "axis_in", dut.axis_clk, dut.axis_rst)
+    axis_sink = AXISSink(dut, "axis_out", dut.axis_clk, dut.axis_rst)
+    yield reset_dut(dut)
+    yield tester.core_reset()
+    yield axis_source.reset()
+    yield axis_sink.reset()
+    yield Timer(CLK_PERIOD * 10)
+
+    ## Load the reference
+    yield tester.set_opmode(1) # load ref mode
+
+    ref = [[]]
+    query = [[], []]
+    for i in range(4000):
+        ref[0].append(i%1000)
+
+    query[0].append(1)
+    query[0].append(0)
+    query[1].append(2)
+    query[1].append(0)
+    for i in range(250):
+        query[0].append(ref[0][i+200])
+        query[1].append(ref[0][i+300])
+
+    yield tester.set_ref_len(len(ref[0]))
+    yield tester.set_rs(1)
+    yield axis_source.send_raw_data(ref)
+    yield Timer(CLK_PERIOD * (5+len(ref[0]))) # This takes time!
+    assert dut.dut.w_dtw_core_busy.value == 0
+
+    ## Both queries in one frame, so they go to the same core
+    yield tester.set_opmode(0) # load query mode
+    cocotb.fork(axis_sink.receive())
+    cocotb.fork(axis_sink.receive())
+    yield axis_source.send_raw_data([query[0] + query[1]])
+    yield Timer(CLK_PERIOD * 2 * (262 + len(ref[0]))) # This takes time!
+
+    rdata = axis_sink.read_data()
+    assert len(rdata) == 2
+    assert rdata[0] == [1, 451, 0]
+    assert rdata[1] == [2, 551, 0]
+
+###############################################################################
+## Test setting and reading the query length
+###############################################################################
+@cocotb.test(skip = False)
+def test_qlen(dut):
+    """
+    Description:
+        Set the query length register and read it back
+
+    Test ID: 12
+
+    Expected Results:
+        The register is SQG_SIZE after reset and keeps 1 to SQG_SIZE samples
+    """
+    ## Init
+    dut._log.setLevel(logging.WARNING)
+    dut.test_id.value = 12
+    setup_dut(dut)
+    tester = DtwAccelDriver(dut, "aximl", dut.clk, dut.rst, debug = False)
+    yield reset_dut(dut)
+
+    ## Body
+    qlen = yield tester.get_qlen()
+    assert qlen == dut.dut.SQG_SIZE.value
+    yield tester.set_qlen(100)
+    assert dut.dut.r_qlen.value == 100
+    qlen = yield tester.get_qlen()
+    assert qlen == 100
+    yield tester.set_qlen(0)
+    qlen = yield tester.get_qlen()
+    assert qlen == 1
+    yield tester.set_qlen(0x1ff)
+    qlen = yield tester.get_qlen()
+    assert qlen == dut.dut.SQG_SIZE.value
+
+    ## cleanup
+    yield Timer(CLK_PERIOD * 20)
+    dut._log.debug("Done")
+
+###############################################################################
+## Test a query shorter than the PE chain
+###############################################################################
+@cocotb.test(skip = False)
+def test_load_short_query(dut):
+    """
+    Description:
+        Run a 100 sample query on a core with SQG_SIZE PEs
+
+    Test ID: 13
+
+    Expected Results:
+        The core reads qid, pad word and 100 samples and finds the exact match
+    """
+    ## Init
+    dut._log.setLevel(logging.WARNING)
+    dut.test_id.value = 13
+    setup_dut(dut)
+    tester = DtwAccelDriver(dut, "aximl", dut.clk, dut.rst, debug = False)
+    axis_source = AXISSource(dut, "axis_in", dut.axis_clk, dut.axis_rst)
+    axis_sink = AXISSink(dut, "axis_out", dut.axis_clk, dut.axis_rst)
+    yield reset_dut(dut)
+    yield tester.core_reset()
+    yield axis_source.reset()
+    yield axis_sink.reset()
+    yield Timer(CLK_PERIOD * 10)
+
+    ## Load the reference
+    yield tester.set_opmode(1) # load ref mode
+
+    ref = [[]]
+    query = [[]]
+    for i in range(4000):
+        ref[0].append(i%1000)
+
+    query[0].append(1)
+    query[0].append(0)
+    for i in range(100):
+        query[0].append(ref[0][i+200])
+
+    yield tester.set_ref_len(len(ref[0]))
+    yield tester.set_qlen(100)
+    yield tester.set_rs(1)
+    yield axis_source.send_raw_data(ref)
+    yield Timer(CLK_PERIOD * (5+len(ref[0]))) # This takes time!
+    assert dut.dut.w_dtw_core_busy.value == 0
+
+    ## Query
+    yield tester.set_opmode(0) # load query mode
+    cocotb.fork(axis_sink.receive())
+    yield axis_source.send_raw_data(query)
+    yield Timer(CLK_PERIOD * (262 + len(ref[0]))) # This takes time!
+
+    rdata = axis_sink.read_data()
+    assert len(rdata) == 1
+    assert rdata[0] == [1, 301, 0]
+
+###############################################################################
+## Test setting and reading the early accept score
+###############################################################################
+@cocotb.test(skip = False)
+def test_thresh(dut):
+    """
+    Description:
+        Set the early accept register and read it back
+
+    Test ID: 14
+
+    Expected Results:
+        The register is 0 after reset and keeps the low 16 bits of the score
+    """
+    ## Init
+    dut._log.setLevel(logging.WARNING)
+    dut.test_id.value = 14
+    setup_dut(dut)
+    tester = DtwAccelDriver(dut, "aximl", dut.clk, dut.rst, debug = False)
+    yield reset_dut(dut)
+
+    ## Body
+    thresh = yield tester.get_thresh()
+    assert thresh == 0
+    yield tester.set_thresh(1000)
+    assert dut.dut.r_thresh.value == 1000
+    thresh = yield tester.get_thresh()
+    assert thresh == 1000
+    yield tester.set_thresh(0x12345)
+    thresh = yield tester.get_thresh()
+    assert thresh == 0x2345
+
+    ## cleanup
+    yield Timer(CLK_PERIOD * 20)
+    dut._log.debug("Done")
+
+###############################################################################
+## Test a query accepted before the end of the reference
+###############################################################################
+@cocotb.test(skip = False)
+def test_early_accept(dut):
+    """
+    Description:
+        Run a query that matches early in the reference with an early
+        accept score of 1
+
+    Test ID: 15
+
+    Expected Results:
+        The core sends the first match and goes idle long before the sweep
+        of the whole reference would have finished
+    """
+    ## Init
+    dut._log.setLevel(logging.WARNING)
+    dut.test_id.value = 15
+    setup_dut(dut)
+    tester = DtwAccelDriver(dut, "aximl", dut.clk, dut.rst, debug = False)
+    axis_source = AXISSource(dut, "axis_in", dut.axis_clk, dut.axis_rst)
+    axis_sink = AXISSink(dut, "axis_out", dut.axis_clk, dut.axis_rst)
+    yield reset_dut(dut)
+    yield tester.core_reset()
+    yield axis_source.reset()
+    yield axis_sink.reset()
+    yield Timer(CLK_PERIOD * 10)
+
+    ## Load the reference
+    yield tester.set_opmode(1) # load ref mode
+
+    ref = [[]]
+    query = [[]]
+    for i in range(4000):
+        ref[0].append(i%1000)
+
+    query[0].append(1)
+    query[0].append(0)
+    for i in range(250):
+        query[0].append(ref[0][i+200])
+
+    yield tester.set_ref_len(len(ref[0]))
+    yield tester.set_thresh(1)
+    yield tester.set_rs(1)
+    yield axis_source.send_raw_data(ref)
+    yield Timer(CLK_PERIOD * (5+len(ref[0]))) # This takes time!
+    assert dut.dut.w_dtw_core_busy.value == 0
+
+    ## Query, the same samples come back every 1000 words
+    yield tester.set_opmode(0) # load query mode
+    cocotb.fork(axis_sink.receive())
+    yield axis_source.send_raw_data(query)
+    yield Timer(CLK_PERIOD * (262 + 600))
+    assert dut.dut.w_dtw_core_busy.value == 0
+
+    rdata = axis_sink.read_data()
+    assert len(rdata) == 1
+    assert rdata[0] == [1, 451, 0]
+
+###############################################################################
+## Test reading the reference memory size
+###############################################################################
+@cocotb.test(skip = False)
+def test_ref_size(dut):
+    """
+    Description:
+        Read the reference size register
+
+    Test ID: 16
+
+    Expected Results:
+        REG_REF_SIZE == 2^REFMEM_PTR_WIDTH of the design
+    """
+    ## Init
+    dut._log.setLevel(logging.WARNING)
+    dut.test_id.value = 16
+    setup_dut(dut)
+    tester = DtwAccelDriver(dut, "aximl", dut.clk, dut.rst, debug = False)
+    yield reset_dut(dut)
+
+    ## Body
+    ref_size = yield tester.get_ref_size()
+    assert ref_size == 1 << dut.dut.REFMEM_PTR_WIDTH.value
+
+    ## cleanup
+    yield Timer(CLK_PERIOD * 20)
+    dut._log.debug("Done")
+
+###############################################################################
+## Test the cohort register of a design without the cohort mode
+###############################################################################
+@cocotb.test(skip = False)
+def test_cohort(dut):
+    """
+    Description:
+        Write the cohort register of the default (COHORT = 0) design
+
+    Test ID: 17
+
+    Expected Results:
+        REG_COHORT reads 0 and the cores never wait for a cohort
+    """
+    ## Init
+    dut._log.setLevel(logging.WARNING)
+    dut.test_id.value = 17
+    setup_dut(dut)
+    tester = DtwAccelDriver(dut, "aximl", dut.clk, dut.rst, debug = False)
+    yield reset_dut(dut)
+
+    ## Body
+    if dut.dut.COHORT.value != 0:
+        dut._log.info("Cohort build, see test_query_cohort")
+        return
+    cohort = yield tester.get_cohort()
+    assert cohort == 0
+    yield tester.set_cohort(100)
+    cohort = yield tester.get_cohort()
+    assert cohort == 0
+    assert dut.dut.w_cohort_go.value == 0
+
+    ## cleanup
+    yield Timer(CLK_PERIOD * 20)
+    dut._log.debug("Done")
+
+###############################################################################
+## Test a query reporting several hits
+###############################################################################
+@cocotb.test(skip = False)
+def test_query_hits(dut):
+    """
+    Description:
+        Run a query that matches every 1000 words of the reference with
+        four hits per result
+
+    Test ID: 18
+
+    Expected Results:
+        One packet with the qid and the four exact matches in order, as
+        dtw_sw_process_query_hits gives for core 0 (port a, one column
+        behind port b)
+    """
+    ## Init
+    dut._log.setLevel(logging.WARNING)
+    dut.test_id.value = 18
+    setup_dut(dut)
+    tester = DtwAccelDriver(dut, "aximl", dut.clk, dut.rst, debug = False)
+    axis_source = AXISSource(dut, "axis_in", dut.axis_clk, dut.axis_rst)
+    axis_sink = AXISSink(dut, "axis_out", dut.axis_clk, dut.axis_rst)
+    yield reset_dut(dut)
+    yield tester.core_reset()
+    yield axis_source.reset()
+    yield axis_sink.reset()
+    yield Timer(CLK_PERIOD * 10)
+
+    ## Load the reference
+    yield tester.set_opmode(1) # load ref mode
+
+    ref = [[]]
+    query = [[]]
+    for i in range(4000):
+        ref[0].append(i%1000)
+
+    query[0].append(1)
+    query[0].append(0)
+    for i in range(250):
+        query[0].append(ref[0][i+200])
+
+    yield tester.set_ref_len(len(ref[0]))
+    yield tester.set_hits(4)
+    yield tester.set_rs(1)
+    yield axis_source.send_raw_data(ref)
+    yield Timer(CLK_PERIOD * (5+len(ref[0]))) # This takes time!
+    assert dut.dut.w_dtw_core_busy.value == 0
+
+    ## Query on core 0
+    yield tester.set_opmode(0) # load query mode
+    cocotb.fork(axis_sink.receive())
+    yield axis_source.send_raw_data(query, tdest = 0)
+    yield Timer(CLK_PERIOD * (262 + len(ref[0]))) # This takes time!
+
+    rdata = axis_sink.read_data()
+    assert len(rdata) == 1
+    assert rdata[0] == [1, 451, 0, 1451, 0, 2451, 0, 3451, 0]
+
+###############################################################################
+## Test a warped query with and without a band
+###############################################################################
+@cocotb.test(skip = False)
+def test_query_band(dut):
+    """
+    Description:
+        Run a query stretched by 6/5 against the reference, first without a
+        band, then with a band of 5 cells around the diagonal
+
+    Test ID: 19
+
+    Expected Results:
+        The same packets dtw_sw_process_query gives for core 0: the warp is
+        free without a band and costs the samples left outside it with one
+    """
+    ## Init
+    dut._log.setLevel(logging.WARNING)
+    dut.test_id.value = 19
+    setup_dut(dut)
+    tester = DtwAccelDriver(dut, "aximl", dut.clk, dut.rst, debug = False)
+    axis_source = AXISSource(dut, "axis_in", dut.axis_clk, dut.axis_rst)
+    axis_sink = AXISSink(dut, "axis_out", dut.axis_clk, dut.axis_rst)
+    yield reset_dut(dut)
+    yield tester.core_reset()
+    yield axis_source.reset()
+    yield axis_sink.reset()
+    yield Timer(CLK_PERIOD * 10)
+
+    ## Load the reference
+    yield tester.set_opmode(1) # load ref mode
+
+    ref = [[]]
+    query = [[]]
+    for i in range(4000):
+        ref[0].append(i%1000)
+
+    query[0].append(1)
+    query[0].append(0)
+    for i in range(250):
+        query[0].append(ref[0][200+(i*6)//5])
+
+    yield tester.set_ref_len(len(ref[0]))
+    yield tester.set_rs(1)
+    yield axis_source.send_raw_data(ref)
+    yield Timer(CLK_PERIOD * (5+len(ref[0]))) # This takes time!
+    assert dut.dut.w_dtw_core_busy.value == 0
+
+    ## Unconstrained warping
+    yield tester.set_opmode(0) # load query mode
+    cocotb.fork(axis_sink.receive())
+    yield axis_source.send_raw_data(query, tdest = 0)
+    yield Timer(CLK_PERIOD * (262 + len(ref[0]))) # This takes time!
+    assert dut.dut.w_dtw_core_busy.value == 0
+
+    ## Band of 5
+    yield tester.set_band(5)
+    cocotb.fork(axis_sink.receive())
+    yield axis_source.send_raw_data(query, tdest = 0)
+    yield Timer(CLK_PERIOD * (262 + len(ref[0]))) # This takes time!
+
+    rdata = axis_sink.read_data()
+    assert len(rdata) == 2
+    assert rdata[0] == [1, 500, 49]
+    assert rdata[1] == [1, 477, 2540]
+
+###############################################################################
+## Test a query matching the second strand
+###############################################################################
+@cocotb.test(skip = False)
+def test_query_strand(dut):
+    """
+    Description:
+        Load a two strand reference and run a query taken from the second
+        strand
+
+    Test ID: 20
+
+    Expected Results:
+        The packet dtw_sw_process_query gives for core 0: bit 31 of the
+        position marks the second strand, the rest counts from its start
+    """
+    ## Init
+    dut._log.setLevel(logging.WARNING)
+    dut.test_id.value = 20
+    setup_dut(dut)
+    tester = DtwAccelDriver(dut, "aximl", dut.clk, dut.rst, debug = False)
+    axis_source = AXISSource(dut, "axis_in", dut.axis_clk, dut.axis_rst)
+    axis_sink = AXISSink(dut, "axis_out", dut.axis_clk, dut.axis_rst)
+    yield reset_dut(dut)
+    yield tester.core_reset()
+    yield axis_source.reset()
+    yield axis_sink.reset()
+    yield Timer(CLK_PERIOD * 10)
+
+    ## Load the reference, the second strand starts at 2000
+    yield tester.set_opmode(1) # load ref mode
+
+    ref = [[]]
+    query = [[]]
+    for i in range(2000):
+        ref[0].append(i%1000)
+    for i in range(2000):
+        ref[0].append((i*7)%1000)
+
+    query[0].append(1)
+    query[0].append(0)
+    for i in range(250):
+        query[0].append(ref[0][2000+300+i])
+
+    yield tester.set_ref_len(len(ref[0]))
+    yield tester.set_strand(2000)
+    yield tester.set_rs(1)
+    yield axis_source.send_raw_data(ref)
+    yield Timer(CLK_PERIOD * (5+len(ref[0]))) # This takes time!
+    assert dut.dut.w_dtw_core_busy.value == 0
+
+    ## Query on core 0
+    yield tester.set_opmode(0) # load query mode
+    cocotb.fork(axis_sink.receive())
+    yield axis_source.send_raw_data(query, tdest = 0)
+    yield Timer(CLK_PERIOD * (262 + len(ref[0]))) # This takes time!
+
+    rdata = axis_sink.read_data()
+    assert len(rdata) == 1
+    assert rdata[0] == [1, 0x80000000 | 551, 0]
+
+###############################################################################
+## Test queries started together by the cohort mode
+###############################################################################
+@cocotb.test(skip = False)
+def test_query_cohort(dut):
+    """
+    Description:
+        Send a query to each of two cores of a cohort build (make COHORT=1),
+        then again with an early accept score only core 0's query reaches
+
+    Test ID: 21
+
+    Expected Results:
+        Both cores start reading the reference on the same cycle and send
+        the packets of independent mode; core 0 finishes early the second
+        time while core 1 sweeps the whole reference
+    """
+    ## Init
+    dut._log.setLevel(logging.WARNING)
+    dut.test_id.value = 21
+    setup_dut(dut)
+    if dut.dut.COHORT.value == 0:
+        dut._log.info("Independent build, run make COHORT=1")
+        return
+    tester = DtwAccelDriver(dut, "aximl", dut.clk, dut.rst, debug = False)
+    axis_source = AXISSource(dut, "axis_in", dut.axis_clk, dut.axis_rst)
+    axis_sink = AXISSink(dut, "axis_out", dut.axis_clk, dut.axis_rst)
+    yield reset_dut(dut)
+    yield tester.core_reset()
+    yield axis_source.reset()
+    yield axis_sink.reset()
+    yield Timer(CLK_PERIOD * 10)
+    starts = [[], []]
+    cocotb.fork(monitor_cohort_run(dut, starts))
+
+    ## Load the reference
+    yield tester.set_opmode(1) # load ref mode
+
+    ref = [[]]
+    for i in range(4000):
+        ref[0].append(i%1000)
+
+    exact = [[1, 0], [2, 0], [3, 0]]
+    warped = [[4, 0]]
+    for i in range(250):
+        for q in exact:
+            q.append(ref[0][i+200])
+        warped[0].append(ref[0][200+(i*6)//5])
+
+    yield tester.set_ref_len(len(ref[0]))
+    yield tester.set_rs(1)
+    yield axis_source.send_raw_data(ref)
+    yield Timer(CLK_PERIOD * (5+len(ref[0]))) # This takes time!
+    assert dut.dut.w_dtw_core_busy.value == 0
+
+    ## The same query on both cores
+    yield tester.set_opmode(0) # load query mode
+    cocotb.fork(axis_sink.receive())
+    cocotb.fork(axis_sink.receive())
+    yield axis_source.send_raw_data([exact[0]], tdest = 0)
+    yield axis_source.send_raw_data([exact[1]], tdest = 1)
+    yield Timer(CLK_PERIOD * (2*262 + len(ref[0]))) # This takes time!
+
+    assert len(starts[0]) == 1
+    assert starts[0] == starts[1]
+    rdata = sorted(axis_sink.read_data())
+    assert rdata == [[1, 451, 0], [2, 450, 0]]
+
+    ## Core 0 accepts its match, core 1 never gets under the score
+    yield tester.set_thresh(1)
+    cocotb.fork(axis_sink.receive())
+    cocotb.fork(axis_sink.receive())
+    yield axis_source.send_raw_data([exact[2]], tdest = 0)
+    yield axis_source.send_raw_data(warped, tdest = 1)
+    yield Timer(CLK_PERIOD * (2*262 + 600))
+    assert len(starts[0]) == 2
+    assert starts[0] == starts[1]
+    assert dut.dut.w_cohort_run.value == 0b10
+
+    yield Timer(CLK_PERIOD * len(ref[0])) # This takes time!
+    rdata = sorted(axis_sink.read_data())
+    assert rdata == [[1, 451, 0], [2, 450, 0], [3, 451, 0], [4, 499, 49]]